@@ -0,0 +1,63 @@
+//
+//  AiButton.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "AiButton.h"
+
+AiButton::AiButton(HidBackend& backend, AiButtonStats& stats, std::function<void(Event)> onEvent)
+    : backend(backend), stats(stats), onEvent(std::move(onEvent)) {
+}
+
+AiButton::~AiButton() {
+    if (timer)
+        backend.cancelTimer(timer);
+}
+
+void AiButton::keyDown() {
+    if (state == IDLE) {
+        state = PRESSED;
+        pressNs = backend.now();
+        deadlineNs = pressNs + AI_BUTTON_LONG_PRESS_NS;
+        timer = backend.scheduleTimer(deadlineNs, [this] { longPressDue(); });
+        stats.presses++;
+        onEvent(PRESS);
+    } else if (state == LONG_PRESSED && awaitingAudio) {
+        awaitingAudio = false;
+        uint64_t t = backend.now();
+        stats.audioLag.record(t > deadlineNs ? t - deadlineNs : 0);
+    }
+}
+
+void AiButton::longPressDue() {
+    timer = 0;
+    if (state != PRESSED)
+        return;
+    uint64_t t = backend.now();
+    stats.timerLate.record(t > deadlineNs ? t - deadlineNs : 0);
+    state = LONG_PRESSED;
+    awaitingAudio = true;
+    stats.longPresses++;
+    onEvent(LONG_PRESS);
+}
+
+void AiButton::keyUp() {
+    if (state == IDLE)
+        return;
+    if (timer) {
+        backend.cancelTimer(timer);
+        timer = 0;
+    }
+    uint64_t held = backend.now() - pressNs;
+    stats.hold.record(held);
+    state = IDLE;
+    if (held >= AI_BUTTON_SESSION_NS) {
+        stats.sessionEnds++;
+        onEvent(SESSION_END);
+    } else {
+        stats.clicks++;
+        onEvent(CLICK);
+    }
+}
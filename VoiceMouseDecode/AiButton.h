@@ -0,0 +1,74 @@
+//
+//  AiButton.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include "HidBackend.h"
+#include "LatencyStats.h"
+
+// Hold time after which a press becomes a long press and the voice session starts
+#define AI_BUTTON_LONG_PRESS_NS 500000000ull
+// A release this long after the press ends the voice session; earlier ones are clicks
+#define AI_BUTTON_SESSION_NS 1000000000ull
+
+// Timing of one device's AI key since it connected (GET_STATS)
+struct AiButtonStats {
+    std::atomic<uint64_t> presses{0};
+    std::atomic<uint64_t> longPresses{0};
+    std::atomic<uint64_t> clicks{0};
+    std::atomic<uint64_t> sessionEnds{0};
+    LatencyHistogram timerLate;     // long-press deadline -> timer fired
+    LatencyHistogram audioLag;      // long-press deadline -> next audio report, the delay
+                                    // long presses had when audio drove the check
+    LatencyHistogram hold;          // press -> release
+};
+
+/*
+ * The AI key of one device. The mouse has no key-down report of its own:
+ * the press is the first audio report with data[0] == 0x01, the release a
+ * consumer report of 0. The long press is a timer on the backend clock, so
+ * it fires AI_BUTTON_LONG_PRESS_NS after the press even when audio is late
+ * or stalls. Events are delivered from the backend's callback context.
+ */
+class AiButton {
+public:
+    enum Event {
+        PRESS,
+        LONG_PRESS,     // held for AI_BUTTON_LONG_PRESS_NS
+        CLICK,          // released before AI_BUTTON_SESSION_NS
+        SESSION_END,    // released after
+    };
+
+    AiButton(HidBackend& backend, AiButtonStats& stats, std::function<void(Event)> onEvent);
+    ~AiButton();
+    AiButton(const AiButton&) = delete;
+    AiButton& operator=(const AiButton&) = delete;
+
+    // Audio report with the key down; the first one of a press emits PRESS
+    void keyDown();
+    // Key-up report; ignored unless pressed
+    void keyUp();
+
+    bool pressed() const { return state != IDLE; }
+    bool longPressed() const { return state == LONG_PRESSED; }
+
+private:
+    enum State { IDLE, PRESSED, LONG_PRESSED };
+
+    void longPressDue();
+
+    HidBackend& backend;
+    AiButtonStats& stats;
+    std::function<void(Event)> onEvent;
+    State state = IDLE;
+    uint64_t pressNs = 0;
+    uint64_t deadlineNs = 0;
+    HidTimerId timer = 0;
+    bool awaitingAudio = false;     // no audio report since the long press yet
+};
@@ -0,0 +1,466 @@
+//
+//  AudioArchive.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "AudioArchive.h"
+#include "sbc.h"
+#include "lc3dec.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ====== 小端编码 ======
+static void putLE(uint8_t* p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t getLE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+#define SESSION_PAYLOAD_SIZE 12     // before the device ID
+#define MAX_BLOCK_SAMPLES    512    // one decoded frame: SBC 16 blocks x 8 subbands x 2 channels, LC3 480
+
+struct Chunk {
+    AudioArchiveChunkType type;
+    unsigned lost;
+    uint32_t sessionId;
+    uint64_t timestampNs;
+    const uint8_t* payload;
+    size_t length;
+};
+
+// Returns false if no whole chunk starts at offset
+static bool readChunk(const uint8_t* data, size_t size, uint64_t offset, Chunk* chunk) {
+    if (offset + AUDIO_ARCHIVE_CHUNK_SIZE > size)
+        return false;
+    const uint8_t* p = data + offset;
+    chunk->type = (AudioArchiveChunkType)p[0];
+    chunk->lost = p[1];
+    chunk->length = (size_t)getLE(p + 2, 2);
+    chunk->sessionId = (uint32_t)getLE(p + 4, 4);
+    chunk->timestampNs = getLE(p + 8, 8);
+    chunk->payload = p + AUDIO_ARCHIVE_CHUNK_SIZE;
+    return offset + AUDIO_ARCHIVE_CHUNK_SIZE + chunk->length <= size;
+}
+
+// ====== 写入 ======
+AudioArchiveWriter::~AudioArchiveWriter() {
+    close();
+}
+
+bool AudioArchiveWriter::open(const std::string& path, uint32_t interval) {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "❌ Can't open audio archive to write: " << path << std::endl;
+        return false;
+    }
+    indexInterval = std::max<uint32_t>(interval, 1);
+    uint8_t header[AUDIO_ARCHIVE_HEADER_SIZE] = {0};
+    memcpy(header, AUDIO_ARCHIVE_MAGIC, 8);
+    putLE(header + 8, AUDIO_ARCHIVE_VERSION, 4);
+    putLE(header + 12, indexInterval, 4);
+    file.write((const char*)header, sizeof(header));
+    offset = sizeof(header);
+    return true;
+}
+
+void AudioArchiveWriter::writeChunk(AudioArchiveChunkType type, unsigned lost, uint32_t sessionId,
+                                    uint64_t timestampNs, const uint8_t* data, size_t length) {
+    uint8_t header[AUDIO_ARCHIVE_CHUNK_SIZE];
+    length = std::min<size_t>(length, 0xFFFF);
+    header[0] = type;
+    header[1] = (uint8_t)std::min(lost, 255u);
+    putLE(header + 2, length, 2);
+    putLE(header + 4, sessionId, 4);
+    putLE(header + 8, timestampNs, 8);
+    file.write((const char*)header, sizeof(header));
+    if (length)
+        file.write((const char*)data, length);
+    offset += sizeof(header) + length;
+}
+
+uint32_t AudioArchiveWriter::beginSession(const AudioArchiveSession& info, uint64_t timestampNs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file.is_open())
+        return 0;
+    uint32_t id = nextSessionId++;
+    AudioArchiveSession& session = sessions[id];
+    session = info;
+    session.id = id;
+    session.startNs = timestampNs;
+    session.endNs = timestampNs;
+    session.frames = 0;
+    session.offset = offset;
+
+    std::vector<uint8_t> payload(SESSION_PAYLOAD_SIZE);
+    payload[0] = session.codec;
+    payload[1] = (uint8_t)session.channels;
+    putLE(&payload[2], session.frameSamples, 2);
+    putLE(&payload[4], (uint32_t)session.sampleRate, 4);
+    putLE(&payload[8], (uint32_t)session.frameUs, 4);
+    payload.insert(payload.end(), session.deviceId.begin(), session.deviceId.end());
+    writeChunk(AUDIO_ARCHIVE_SESSION, 0, id, timestampNs, payload.data(), payload.size());
+    openSessions.insert(id);
+    return id;
+}
+
+void AudioArchiveWriter::writeFrame(uint32_t sessionId, uint64_t timestampNs, const uint8_t* data, size_t length,
+                                    unsigned lost) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!openSessions.count(sessionId))
+        return;
+    AudioArchiveSession& session = sessions[sessionId];
+    // Frames of a report are back-dated from its arrival and may overlap the
+    // previous report's; keep them in order so a time maps to one file position
+    timestampNs = std::max(timestampNs, session.endNs);
+    if (session.frames % indexInterval == 0)
+        index.push_back({timestampNs, offset, sessionId, (uint32_t)session.frames});
+    writeChunk(AUDIO_ARCHIVE_FRAME, lost, sessionId, timestampNs, data, length);
+    session.frames++;
+    session.endNs = std::max(session.endNs, timestampNs);
+}
+
+void AudioArchiveWriter::endSession(uint32_t sessionId, uint64_t timestampNs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!openSessions.erase(sessionId))
+        return;
+    AudioArchiveSession& session = sessions[sessionId];
+    session.endNs = std::max(session.endNs, timestampNs);
+    writeChunk(AUDIO_ARCHIVE_END, 0, sessionId, session.endNs, nullptr, 0);
+    // A finished session is on disk even if the footer never gets written
+    file.flush();
+}
+
+void AudioArchiveWriter::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file.is_open())
+        return;
+    for (uint32_t id : openSessions) {
+        writeChunk(AUDIO_ARCHIVE_END, 0, id, sessions[id].endNs, nullptr, 0);
+    }
+    openSessions.clear();
+
+    uint64_t footerOffset = offset;
+    uint8_t entry[AUDIO_ARCHIVE_ENTRY_SIZE];
+    for (auto& it : sessions) {
+        putLE(entry, it.second.offset, 8);
+        putLE(entry + 8, it.second.endNs, 8);
+        putLE(entry + 16, it.second.frames, 8);
+        file.write((const char*)entry, sizeof(entry));
+    }
+    for (auto& point : index) {
+        putLE(entry, point.timestampNs, 8);
+        putLE(entry + 8, point.offset, 8);
+        putLE(entry + 16, point.sessionId, 4);
+        putLE(entry + 20, point.frame, 4);
+        file.write((const char*)entry, sizeof(entry));
+    }
+    putLE(entry, footerOffset, 8);
+    putLE(entry + 8, sessions.size(), 4);
+    putLE(entry + 12, index.size(), 4);
+    memcpy(entry + 16, AUDIO_ARCHIVE_TRAILER_MAGIC, 8);
+    file.write((const char*)entry, sizeof(entry));
+    file.close();
+
+    sessions.clear();
+    index.clear();
+}
+
+// ====== 读取 ======
+AudioArchiveReader::~AudioArchiveReader() {
+    if (data) munmap((void*)data, size);
+    if (fd >= 0) ::close(fd);
+}
+
+bool AudioArchiveReader::open(const std::string& path) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        std::cerr << "❌ Can't open audio archive: " << path << std::endl;
+        return false;
+    }
+    size = (size_t)st.st_size;
+    if (size < AUDIO_ARCHIVE_HEADER_SIZE) {
+        std::cerr << "❌ Not an audio archive: " << path << std::endl;
+        return false;
+    }
+    void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        std::cerr << "❌ Can't map audio archive: " << path << std::endl;
+        return false;
+    }
+    data = (const uint8_t*)p;
+    // Seeks jump around; don't read ahead pages nobody asked for
+    madvise(p, size, MADV_RANDOM);
+
+    if (memcmp(data, AUDIO_ARCHIVE_MAGIC, 8) != 0) {
+        std::cerr << "❌ Not an audio archive: " << path << std::endl;
+        return false;
+    }
+    uint32_t version = (uint32_t)getLE(data + 8, 4);
+    if (version != AUDIO_ARCHIVE_VERSION) {
+        std::cerr << "❌ Unsupported audio archive version " << version << std::endl;
+        return false;
+    }
+    indexInterval = std::max<uint32_t>((uint32_t)getLE(data + 12, 4), 1);
+
+    hadFooter = readFooter();
+    if (!hadFooter) {
+        std::cout << "⚠️ " << path << " has no index (not closed cleanly), scanning it" << std::endl;
+        if (!scan())
+            return false;
+    }
+    std::sort(sessionList.begin(), sessionList.end(), [](const AudioArchiveSession& a, const AudioArchiveSession& b) {
+        return a.startNs < b.startNs;
+    });
+    for (size_t i = 0; i < sessionList.size(); ++i) {
+        sessionById[sessionList[i].id] = i;
+    }
+    return true;
+}
+
+bool AudioArchiveReader::parseSession(uint64_t offset, AudioArchiveSession* session) const {
+    Chunk chunk;
+    if (!readChunk(data, size, offset, &chunk) || chunk.type != AUDIO_ARCHIVE_SESSION ||
+        chunk.length < SESSION_PAYLOAD_SIZE)
+        return false;
+    session->id = chunk.sessionId;
+    session->codec = chunk.payload[0];
+    session->channels = chunk.payload[1];
+    session->frameSamples = (size_t)getLE(chunk.payload + 2, 2);
+    session->sampleRate = (int)getLE(chunk.payload + 4, 4);
+    session->frameUs = (int)getLE(chunk.payload + 8, 4);
+    session->deviceId.assign((const char*)chunk.payload + SESSION_PAYLOAD_SIZE, chunk.length - SESSION_PAYLOAD_SIZE);
+    session->startNs = chunk.timestampNs;
+    session->endNs = chunk.timestampNs;
+    session->frames = 0;
+    session->offset = offset;
+    return true;
+}
+
+bool AudioArchiveReader::readFooter() {
+    if (size < AUDIO_ARCHIVE_HEADER_SIZE + AUDIO_ARCHIVE_ENTRY_SIZE)
+        return false;
+    const uint8_t* trailer = data + size - AUDIO_ARCHIVE_ENTRY_SIZE;
+    if (memcmp(trailer + 16, AUDIO_ARCHIVE_TRAILER_MAGIC, 8) != 0)
+        return false;
+    uint64_t footerOffset = getLE(trailer, 8);
+    uint64_t sessionCount = getLE(trailer + 8, 4);
+    uint64_t entryCount = getLE(trailer + 12, 4);
+    if (footerOffset < AUDIO_ARCHIVE_HEADER_SIZE ||
+        footerOffset + (sessionCount + entryCount + 1) * AUDIO_ARCHIVE_ENTRY_SIZE != size)
+        return false;
+
+    const uint8_t* p = data + footerOffset;
+    for (uint64_t i = 0; i < sessionCount; ++i, p += AUDIO_ARCHIVE_ENTRY_SIZE) {
+        AudioArchiveSession session;
+        if (!parseSession(getLE(p, 8), &session))
+            return false;
+        session.endNs = getLE(p + 8, 8);
+        session.frames = getLE(p + 16, 8);
+        sessionList.push_back(session);
+    }
+    for (uint64_t i = 0; i < entryCount; ++i, p += AUDIO_ARCHIVE_ENTRY_SIZE) {
+        AudioArchiveIndexEntry entry;
+        entry.timestampNs = getLE(p, 8);
+        entry.offset = getLE(p + 8, 8);
+        entry.sessionId = (uint32_t)getLE(p + 16, 4);
+        entry.frame = (uint32_t)getLE(p + 20, 4);
+        if (entry.offset + AUDIO_ARCHIVE_CHUNK_SIZE > footerOffset)
+            return false;
+        indexBySession[entry.sessionId].push_back(entry);
+    }
+    return true;
+}
+
+// No footer: rebuild sessions and index from the chunks, up to the last whole one
+bool AudioArchiveReader::scan() {
+    sessionList.clear();
+    indexBySession.clear();
+    std::map<uint32_t, AudioArchiveSession> found;
+    uint64_t offset = AUDIO_ARCHIVE_HEADER_SIZE;
+    Chunk chunk;
+    while (readChunk(data, size, offset, &chunk)) {
+        if (chunk.type == AUDIO_ARCHIVE_SESSION) {
+            AudioArchiveSession session;
+            if (parseSession(offset, &session))
+                found[session.id] = session;
+        } else if (found.count(chunk.sessionId)) {
+            AudioArchiveSession& session = found[chunk.sessionId];
+            if (chunk.type == AUDIO_ARCHIVE_FRAME) {
+                if (session.frames % indexInterval == 0)
+                    indexBySession[session.id].push_back({chunk.timestampNs, offset, session.id, (uint32_t)session.frames});
+                session.frames++;
+            }
+            session.endNs = std::max(session.endNs, chunk.timestampNs);
+        }
+        offset += AUDIO_ARCHIVE_CHUNK_SIZE + chunk.length;
+    }
+    for (auto& it : found) {
+        sessionList.push_back(it.second);
+    }
+    return true;
+}
+
+const AudioArchiveSession* AudioArchiveReader::session(uint32_t sessionId) const {
+    auto it = sessionById.find(sessionId);
+    return it == sessionById.end() ? nullptr : &sessionList[it->second];
+}
+
+std::vector<const AudioArchiveSession*> AudioArchiveReader::sessionsInRange(const std::string& deviceId,
+                                                                          uint64_t fromNs, uint64_t toNs) const {
+    std::vector<const AudioArchiveSession*> found;
+    for (auto& session : sessionList) {
+        if (!deviceId.empty() && session.deviceId != deviceId)
+            continue;
+        if (session.frames > 0 && session.startNs < toNs && session.endNs >= fromNs)
+            found.push_back(&session);
+    }
+    return found;
+}
+
+size_t AudioArchiveReader::seekEntry(const std::vector<AudioArchiveIndexEntry>& entries,
+                                     const AudioArchiveSession& session, uint64_t timestampNs) const {
+    if (entries.empty() || timestampNs <= entries[0].timestampNs)
+        return 0;
+    // Entries are indexInterval frames apart: straight to the one the time
+    // falls in, then step over whatever lost frames shifted
+    uint64_t spanNs = session.frameNs() * indexInterval;
+    size_t k = spanNs ? (size_t)std::min<uint64_t>((timestampNs - entries[0].timestampNs) / spanNs, entries.size() - 1) : 0;
+    while (k + 1 < entries.size() && entries[k + 1].timestampNs < timestampNs)
+        k++;
+    while (k > 0 && entries[k].timestampNs >= timestampNs)
+        k--;
+    return k;
+}
+
+AudioArchiveFrameIterator AudioArchiveReader::frames(uint32_t sessionId, uint64_t fromNs, uint64_t toNs) const {
+    AudioArchiveFrameIterator it;
+    it.reader = this;
+    it.sessionId = sessionId;
+    it.offset = size;
+    it.fromNs = fromNs;
+    it.toNs = toNs;
+
+    const AudioArchiveSession* found = session(sessionId);
+    auto entries = indexBySession.find(sessionId);
+    if (!found || entries == indexBySession.end() || entries->second.empty())
+        return it;
+    const AudioArchiveIndexEntry& entry = entries->second[seekEntry(entries->second, *found, fromNs)];
+    it.offset = entry.offset;
+    it.frame = entry.frame;
+    return it;
+}
+
+bool AudioArchiveFrameIterator::next(AudioArchiveFrame& out) {
+    if (!reader)
+        return false;
+    Chunk chunk;
+    while (readChunk(reader->data, reader->size, offset, &chunk)) {
+        offset += AUDIO_ARCHIVE_CHUNK_SIZE + chunk.length;
+        if (chunk.sessionId != sessionId || chunk.type == AUDIO_ARCHIVE_SESSION)
+            continue;
+        if (chunk.type == AUDIO_ARCHIVE_END || chunk.timestampNs >= toNs)
+            break;
+        uint64_t index = frame++;
+        if (chunk.timestampNs < fromNs)
+            continue;
+        out.sessionId = sessionId;
+        out.timestampNs = chunk.timestampNs;
+        out.frame = index;
+        out.lost = chunk.lost;
+        out.data = chunk.payload;
+        out.length = chunk.length;
+        return true;
+    }
+    offset = reader->size;
+    return false;
+}
+
+// ====== 解码 ======
+bool AudioArchiveReader::decode(uint32_t sessionId, uint64_t fromNs, uint64_t toNs, std::vector<int16_t>& pcm,
+                                size_t warmupFrames, uint64_t* firstFrame) const {
+    const AudioArchiveSession* found = session(sessionId);
+    if (!found)
+        return false;
+    const size_t blockSamples = found->frameSamples * found->channels;
+    if (blockSamples == 0 || blockSamples > MAX_BLOCK_SAMPLES) {
+        std::cerr << "❌ Archive session " << sessionId << " has a bad frame size" << std::endl;
+        return false;
+    }
+
+    sbc_t sbc;
+    lc3dec_t lc3;
+    int ret = -1;
+    switch (found->codec) {
+        case AUDIO_ARCHIVE_MSBC: ret = sbc_init_msbc(&sbc, 0); break;
+        case AUDIO_ARCHIVE_SBC:  ret = sbc_init(&sbc, 0); break;
+        case AUDIO_ARCHIVE_LC3:  ret = lc3dec_init(&lc3, found->sampleRate, found->frameUs); break;
+    }
+    if (ret != 0) {
+        std::cerr << "❌ Can't decode archive session " << sessionId << " (codec " << (int)found->codec
+                  << "), error code: " << ret << std::endl;
+        return false;
+    }
+
+    // Start far enough before fromNs for the decoder to settle: the index
+    // entry a warm-up's worth of frames earlier
+    AudioArchiveFrameIterator it = frames(sessionId, 0, toNs);
+    auto entries = indexBySession.find(sessionId);
+    if (entries != indexBySession.end() && !entries->second.empty()) {
+        size_t k = seekEntry(entries->second, *found, fromNs);
+        uint64_t warmupNs = found->frameNs() * warmupFrames;
+        while (k > 0 && entries->second[k].timestampNs + warmupNs > fromNs)
+            k--;
+        it.offset = entries->second[k].offset;
+        it.frame = entries->second[k].frame;
+    }
+
+    int16_t block[MAX_BLOCK_SAMPLES];
+    bool started = false;
+    AudioArchiveFrame frame;
+    while (it.next(frame)) {
+        size_t written = 0;
+        ssize_t result = -1;
+        if (found->codec == AUDIO_ARCHIVE_LC3) {
+            result = lc3dec_decode(&lc3, frame.data, frame.length, block, sizeof(block), &written);
+            if (result <= 0)
+                lc3dec_conceal(&lc3, block, sizeof(block), &written);
+        } else {
+            result = sbc_decode(&sbc, frame.data, frame.length, block, sizeof(block), &written);
+        }
+        if (frame.timestampNs < fromNs)
+            continue;   // warm-up
+
+        if (!started && firstFrame)
+            *firstFrame = frame.frame;
+        started = true;
+        pcm.insert(pcm.end(), frame.lost * blockSamples, 0);
+        if (result <= 0 && found->codec != AUDIO_ARCHIVE_LC3)
+            written = 0;
+        size_t samples = std::min(written / sizeof(int16_t), blockSamples);
+        pcm.insert(pcm.end(), block, block + samples);
+        pcm.insert(pcm.end(), blockSamples - samples, 0);    // a bad frame is silence
+    }
+
+    if (found->codec == AUDIO_ARCHIVE_LC3)
+        lc3dec_finish(&lc3);
+    else
+        sbc_finish(&sbc);
+    return true;
+}
@@ -0,0 +1,193 @@
+//
+//  AudioArchive.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+/*
+ * Audio archive: the encoded frames of every voice session, as they arrived,
+ * with a sparse seek index so a reader can jump to "device X at 14:03:20"
+ * without walking the file. Sessions of several devices interleave frame by
+ * frame. All integers little endian; timestamps are wall clock ns since the
+ * epoch.
+ *
+ *   header:  "VMAUDARC" | uint32 version | uint32 indexInterval
+ *   chunk:   uint8 type | uint8 lost | uint16 length | uint32 sessionId |
+ *            uint64 timestampNs | bytes[length]
+ *   footer:  session[sessions] | index[entries] | trailer
+ *   session: uint64 offset | uint64 endNs | uint64 frames
+ *   index:   uint64 timestampNs | uint64 offset | uint32 sessionId | uint32 frame
+ *   trailer: uint64 footerOffset | uint32 sessions | uint32 entries | "VMARCEND"
+ *
+ * A SESSION chunk opens a session: uint8 codec | uint8 channels |
+ * uint16 frameSamples | uint32 sampleRate | uint32 frameUs | deviceId.
+ * FRAME chunks carry one encoded frame each, lost counts the frames that went
+ * missing right before it. END closes the session. The footer is written on
+ * close(); its session entries point at the SESSION chunks, and there is one
+ * index entry for every indexInterval-th frame of each session, the first
+ * included. A file without a footer (the process died) is scanned instead.
+ */
+
+#define AUDIO_ARCHIVE_MAGIC          "VMAUDARC"
+#define AUDIO_ARCHIVE_TRAILER_MAGIC  "VMARCEND"
+#define AUDIO_ARCHIVE_VERSION        1
+#define AUDIO_ARCHIVE_HEADER_SIZE    16
+#define AUDIO_ARCHIVE_CHUNK_SIZE     16
+#define AUDIO_ARCHIVE_ENTRY_SIZE     24     // session, index entry and trailer alike
+#define AUDIO_ARCHIVE_INDEX_INTERVAL 128    // frames, about a second of mSBC
+#define AUDIO_ARCHIVE_WARMUP_FRAMES  8      // decoded and dropped before a seek target
+
+enum AudioArchiveChunkType : uint8_t {
+    AUDIO_ARCHIVE_SESSION = 0,
+    AUDIO_ARCHIVE_FRAME = 1,
+    AUDIO_ARCHIVE_END = 2,
+};
+
+// Codec of a session, numbered as AudioCodec (DecoderPool.h)
+enum AudioArchiveCodec : uint8_t {
+    AUDIO_ARCHIVE_MSBC = 1,
+    AUDIO_ARCHIVE_SBC = 2,
+    AUDIO_ARCHIVE_LC3 = 3,
+};
+
+struct AudioArchiveSession {
+    uint32_t id = 0;
+    std::string deviceId;
+    uint8_t codec = AUDIO_ARCHIVE_MSBC;
+    int sampleRate = 16000;
+    int channels = 1;
+    size_t frameSamples = 120;  // per channel
+    int frameUs = 0;            // LC3 frame duration
+    uint64_t startNs = 0;
+    uint64_t endNs = 0;         // of its last frame, or of END
+    uint64_t frames = 0;
+    uint64_t offset = 0;        // of its SESSION chunk
+
+    uint64_t frameNs() const { return sampleRate > 0 ? frameSamples * 1000000000ull / sampleRate : 0; }
+};
+
+struct AudioArchiveIndexEntry {
+    uint64_t timestampNs;
+    uint64_t offset;            // of the FRAME chunk
+    uint32_t sessionId;
+    uint32_t frame;             // within its session
+};
+
+// One frame handed out by the reader; data points into the mapped file
+struct AudioArchiveFrame {
+    uint32_t sessionId = 0;
+    uint64_t timestampNs = 0;
+    uint64_t frame = 0;         // within its session
+    unsigned lost = 0;          // frames missing right before this one
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+};
+
+/*
+ * Appends sessions to an archive as frames arrive. Thread-safe; the sparse
+ * index is kept in memory (one entry per indexInterval frames) and written
+ * with the footer on close().
+ */
+class AudioArchiveWriter {
+public:
+    ~AudioArchiveWriter();
+    bool open(const std::string& path, uint32_t indexInterval = AUDIO_ARCHIVE_INDEX_INTERVAL);
+    // Returns the new session's ID (never 0); codec, rate, channels,
+    // frameSamples, frameUs and deviceId of session are used
+    uint32_t beginSession(const AudioArchiveSession& session, uint64_t timestampNs);
+    void writeFrame(uint32_t sessionId, uint64_t timestampNs, const uint8_t* data, size_t length, unsigned lost);
+    void endSession(uint32_t sessionId, uint64_t timestampNs);
+    // Ends the sessions still open and writes the footer
+    void close();
+
+private:
+    void writeChunk(AudioArchiveChunkType type, unsigned lost, uint32_t sessionId, uint64_t timestampNs,
+                    const uint8_t* data, size_t length);
+
+    std::mutex mutex;
+    std::ofstream file;
+    uint64_t offset = 0;
+    uint32_t indexInterval = AUDIO_ARCHIVE_INDEX_INTERVAL;
+    uint32_t nextSessionId = 1;
+    std::map<uint32_t, AudioArchiveSession> sessions;
+    std::set<uint32_t> openSessions;    // not ended yet
+    std::vector<AudioArchiveIndexEntry> index;
+};
+
+class AudioArchiveReader;
+
+// Frames of one session from a seek point up to a time, in file order
+class AudioArchiveFrameIterator {
+public:
+    // Returns false past the end of the range, the session or the file
+    bool next(AudioArchiveFrame& out);
+
+private:
+    friend class AudioArchiveReader;
+    const AudioArchiveReader* reader = nullptr;
+    uint32_t sessionId = 0;
+    uint64_t offset = 0;
+    uint64_t frame = 0;
+    uint64_t fromNs = 0;
+    uint64_t toNs = 0;
+};
+
+/*
+ * Maps an archive read-only. Seeking costs one index lookup plus at most
+ * indexInterval frames of the session: the entry is computed from the
+ * session's frame duration and only nudged when frames went missing.
+ */
+class AudioArchiveReader {
+public:
+    AudioArchiveReader() = default;
+    AudioArchiveReader(const AudioArchiveReader&) = delete;
+    AudioArchiveReader& operator=(const AudioArchiveReader&) = delete;
+    ~AudioArchiveReader();
+
+    bool open(const std::string& path);
+    const std::vector<AudioArchiveSession>& sessions() const { return sessionList; }
+    const AudioArchiveSession* session(uint32_t sessionId) const;
+    // Sessions with frames in [fromNs, toNs), oldest first; deviceId "" for all
+    std::vector<const AudioArchiveSession*> sessionsInRange(const std::string& deviceId, uint64_t fromNs, uint64_t toNs) const;
+    bool indexed() const { return hadFooter; }
+
+    // Frames of the session with a timestamp in [fromNs, toNs)
+    AudioArchiveFrameIterator frames(uint32_t sessionId, uint64_t fromNs, uint64_t toNs) const;
+
+    // Interleaved 16-bit PCM at the session's rate for its frames in
+    // [fromNs, toNs); lost frames become silence. The decoder first runs over
+    // at least warmupFrames frames before fromNs, output dropped, so the
+    // samples match a decode from the session start. firstFrame gets the
+    // first session frame decoded, preceded in pcm by its lost frames.
+    bool decode(uint32_t sessionId, uint64_t fromNs, uint64_t toNs, std::vector<int16_t>& pcm,
+                size_t warmupFrames = AUDIO_ARCHIVE_WARMUP_FRAMES, uint64_t* firstFrame = nullptr) const;
+
+private:
+    friend class AudioArchiveFrameIterator;
+    bool readFooter();
+    bool scan();
+    bool parseSession(uint64_t offset, AudioArchiveSession* session) const;
+    // Index of the session's last entry before timestampNs (or its first)
+    size_t seekEntry(const std::vector<AudioArchiveIndexEntry>& entries, const AudioArchiveSession& session,
+                     uint64_t timestampNs) const;
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    int fd = -1;
+    bool hadFooter = false;
+    uint32_t indexInterval = AUDIO_ARCHIVE_INDEX_INTERVAL;
+    std::vector<AudioArchiveSession> sessionList;
+    std::map<uint32_t, size_t> sessionById;
+    std::map<uint32_t, std::vector<AudioArchiveIndexEntry>> indexBySession;
+};
@@ -0,0 +1,49 @@
+//
+//  AudioHistory.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "AudioHistory.h"
+#include "LatencyStats.h"
+#include <algorithm>
+#include <cstring>
+
+AudioHistory::AudioHistory(size_t capacity) : slots(std::max<size_t>(capacity, 1)) {
+}
+
+void AudioHistory::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    head = 0;
+    count = 0;
+}
+
+void AudioHistory::record(uint64_t seq, bool concealed, const int16_t* pcm, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Frame& slot = slots[head];
+    slot.seq = seq;
+    slot.concealed = concealed;
+    slot.length = (uint16_t)std::min(length, sizeof(slot.pcm));
+    memcpy(slot.pcm, pcm, slot.length);
+
+    head = (head + 1) % slots.size();
+    if (count < slots.size())
+        count++;
+    lastRecord.store(latencyClockNs(), std::memory_order_relaxed);
+}
+
+bool AudioHistory::since(uint64_t fromSeq, std::vector<Frame>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t oldest = (head + slots.size() - count) % slots.size();
+    bool complete = count > 0 && slots[oldest].seq <= fromSeq;
+
+    // seq only grows, so the frames wanted are a suffix of the ring
+    size_t skip = 0;
+    while (skip < count && slots[(oldest + skip) % slots.size()].seq < fromSeq)
+        skip++;
+    for (size_t i = skip; i < count; ++i) {
+        out.push_back(slots[(oldest + i) % slots.size()]);
+    }
+    return complete;
+}
@@ -0,0 +1,54 @@
+//
+//  AudioHistory.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Longest frame kept: one mSBC frame of 16 kHz mono
+#define AUDIO_HISTORY_FRAME_SAMPLES 120
+// Default history per device, about 320 KB
+#define AUDIO_HISTORY_SECONDS 10
+
+/*
+ * Fixed-memory ring of the most recent 16 kHz frames of one device, so a
+ * client that reconnects can ask for everything from a sequence number on
+ * (RESUME_FROM), even if a new utterance started meanwhile: the device's seq
+ * keeps counting across streams, so no two frames kept share one. All slots are allocated up front;
+ * record() only copies into the oldest one.
+ */
+class AudioHistory {
+public:
+    struct Frame {
+        uint64_t seq;
+        bool concealed;
+        uint16_t length;        // bytes
+        int16_t pcm[AUDIO_HISTORY_FRAME_SAMPLES];
+    };
+
+    explicit AudioHistory(size_t capacity);
+
+    void clear();
+    void record(uint64_t seq, bool concealed, const int16_t* pcm, size_t length);
+
+    // Appends the frames with seq >= fromSeq, oldest first. Returns false if
+    // frames from fromSeq on have already been overwritten (the oldest kept
+    // are still appended).
+    bool since(uint64_t fromSeq, std::vector<Frame>& out);
+
+    // latencyClockNs() of the last record(), 0 if none
+    uint64_t lastRecordNs() const { return lastRecord.load(std::memory_order_relaxed); }
+
+private:
+    std::mutex mutex;
+    std::vector<Frame> slots;
+    size_t head = 0;            // next slot to write
+    size_t count = 0;
+    std::atomic<uint64_t> lastRecord{0};
+};
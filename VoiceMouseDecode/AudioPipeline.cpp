@@ -0,0 +1,196 @@
+//
+//  AudioPipeline.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "AudioPipeline.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "PCMServer.h"
+
+void AudioPipeline::announceCodec(DeviceDecoder& decoder, bool supported) {
+    const AudioFormat& format = decoder.format;
+    std::cout << "🎼 " << audioCodecName(format.codec) << " audio, " << format.sampleRate << " Hz, "
+              << format.channels << " channel(s)" << (supported ? "" : ", unsupported") << std::endl;
+    // Every codec leaves decode() as 16 kHz mono
+    server.sendAudioCodec(decoder.label, audioCodecName(format.codec), SAMPLE_RATE, 1, format.sampleRate,
+                          format.channels, format.frameLength, supported);
+}
+
+void AudioPipeline::playout(const JitterBuffer::Frame& frame) {
+    for (auto &audio : frame.audio) {
+        server.sendAudioPCM(frame.deviceId, (uint8_t*)audio.second.data(), audio.second.size(), audio.first,
+                            nullptr, frame.seq, frame.concealed);
+    }
+}
+
+// Sends one decoded 16 kHz frame in every sample rate the clients asked for.
+// Each rate is resampled once per device however many clients share it.
+// With the jitter buffer on, the frame is queued in all rates for playout
+// instead of being sent right away. timing is optional, as for sendAudioPCM.
+void AudioPipeline::sendDecodedAudio(DeviceDecoder& decoder, int16_t* pcm, size_t len, uint64_t seq, bool concealed,
+                                     FrameTiming* timing) {
+    thread_local std::vector<int16_t> resampled;
+    JitterBuffer::Frame held;
+    decoder.history.record(seq, concealed, pcm, len);
+
+    auto deliver = [&](const uint8_t* data, size_t n, int rate) {
+        if (decoder.jitter)
+            held.audio.emplace_back(rate, std::vector<uint8_t>(data, data + n));
+        else
+            server.sendAudioPCM(decoder.label, (uint8_t*)data, n, rate, timing, seq, concealed);
+    };
+
+    for (int rate : server.requestedSampleRates()) {
+        if (rate == SAMPLE_RATE) {
+            deliver((uint8_t*)pcm, len, SAMPLE_RATE);
+            continue;
+        }
+        ResamplerState* resampler = decoder.resamplerFor(rate);
+        if (!resampler)
+            continue;
+
+        uint64_t start = latencyClockNs();
+        size_t samples = len / sizeof(int16_t);
+        resampled.resize(resample_max_output(resampler, samples));
+        size_t n = resample_process(resampler, pcm, samples, resampled.data(), resampled.size());
+        if (timing)
+            timing->stageNs[LATENCY_ENCODE] += latencyClockNs() - start;
+        deliver((uint8_t*)resampled.data(), n * sizeof(int16_t), rate);
+    }
+
+    if (decoder.jitter && !held.audio.empty()) {
+        held.deviceId = decoder.label;
+        held.seq = seq;
+        held.concealed = concealed;
+        held.arrivalNs = timing ? timing->arrivalNs : latencyClockNs();
+        decoder.jitter->push(std::move(held));
+    }
+}
+
+// Hands one frame (decoded or concealed) to onDecodedFrame, runs VAD on it and
+// sends it, or holds it back while silent frames are suppressed. Every frame
+// takes the next stream sequence number, sent or not.
+bool AudioPipeline::emitDecodedFrame(DeviceDecoder& decoder, int16_t* pcm, size_t len, bool concealed,
+                                     FrameTiming* timing) {
+    uint64_t seq = decoder.nextStreamSeq++;
+    if (onDecodedFrame && !onDecodedFrame(pcm, len))
+        return false;
+
+    VadEvent events[4];
+    size_t eventCount = vad_process(&decoder.vad, pcm, len / sizeof(int16_t), events, 4);
+    for (size_t i = 0; i < eventCount; ++i) {
+        bool start = events[i].type == VAD_EVENT_SPEECH_START;
+        std::cout << (start ? "🗣️ Speech start" : "🤫 Speech end") << " at sample " << events[i].sample_offset << std::endl;
+        server.sendVadEvent(decoder.label, start, events[i].sample_offset);
+    }
+
+    // Send audio data to client
+    if (server.isSilenceSuppressed() && !vad_is_speech(&decoder.vad)) {
+        decoder.vadPreRoll.push_back({seq, concealed, std::vector<uint8_t>((uint8_t*)pcm, (uint8_t*)pcm + len)});
+        if (decoder.vadPreRoll.size() > AUDIO_PIPELINE_VAD_PREROLL_FRAMES)
+            decoder.vadPreRoll.pop_front();
+    } else {
+        for (auto &frame : decoder.vadPreRoll) {
+            sendDecodedAudio(decoder, (int16_t*)frame.pcm.data(), frame.pcm.size(), frame.seq, frame.concealed, timing);
+        }
+        decoder.vadPreRoll.clear();
+        sendDecodedAudio(decoder, pcm, len, seq, concealed, timing);
+    }
+    return true;
+}
+
+void AudioPipeline::flush(DeviceDecoder& decoder) {
+    int16_t pcm[MSBC_FRAME_SAMPLES];
+    size_t len = 0;
+    while (decoder.flushFrame(pcm, sizeof(pcm), &len, pool.options))
+        emitDecodedFrame(decoder, pcm, len, false, nullptr);
+}
+
+// Sequence tracking, codec detection, concealment and decode of each frame
+void AudioPipeline::handleFrames(DeviceDecoder& decoder, void* context, const uint8_t* const* frames,
+                                 size_t count, const uint8_t* reportEnd, uint64_t nowNs, uint64_t arrivalNs) {
+    for (size_t k = 0; k < count; ++k) {
+        FrameTiming timing;
+        timing.arrivalNs = arrivalNs;
+        uint64_t decodeStart = latencyClockNs();
+        timing.stageNs[LATENCY_QUEUE] = decodeStart > timing.arrivalNs ? decodeStart - timing.arrivalNs : 0;
+
+        // H2 header: data[0] is 0x01, data[1] carries the frame sequence number.
+        // Earlier frames of a report were captured one frame interval apart.
+        const uint8_t* data = frames[k];
+        uint64_t capturedNs = nowNs - (count - 1 - k) * MSBC_FRAME_INTERVAL_NS;
+        int lostFrames = 0;
+        SequenceStatus seqStatus = decoder.sequence.update(data[1], capturedNs, &lostFrames);
+        if (seqStatus == SEQ_DUPLICATE)
+        {
+            std::cout << "🔁 Duplicate mSBC frame dropped" << std::endl;
+            continue;
+        }
+
+        // The codec is whatever the frame's syncword says (0xAD mSBC, 0x9C SBC)
+        // or LC3 if configured for the product; a frame runs at most up to the next one
+        const uint8_t* msbc_data = data + 2;
+        size_t available = (k + 1 < count ? frames[k + 1] : reportEnd) - msbc_data;
+        bool formatChanged = false;
+        bool supported = decoder.configure(msbc_data, available, &formatChanged);
+        if (formatChanged)
+            announceCodec(decoder, supported);
+        const size_t msbc_data_len = std::min(available, decoder.format.frameLength);
+        if (onEncodedFrame)
+            onEncodedFrame(context, decoder, formatChanged, supported, msbc_data, msbc_data_len, lostFrames, capturedNs);
+
+        // Passthrough clients get the raw frame with the seq its decoded
+        // frame has, so both streams number frames the same way
+        uint64_t frameSeq = decoder.nextStreamSeq + lostFrames;
+        if (server.wantsEncoded())
+            server.sendEncodedAudio(decoder.label, msbc_data, msbc_data_len, frameSeq, capturedNs);
+        if (!server.wantsPcm())
+        {
+            // Nobody wants PCM: skip decoding and DSP altogether
+            decoder.nextStreamSeq = frameSeq + 1;
+            metricsAdd(METRIC_FRAMES_PASSED_THROUGH);
+            continue;
+        }
+
+        int16_t pcm_output[240] = {0};
+        size_t pcm_len = 0;
+
+        if (seqStatus == SEQ_GAP)
+        {
+            std::cout << "⚠️ " << lostFrames << " mSBC frame(s) lost, concealing" << std::endl;
+            for (int i = 0; i < lostFrames; ++i) {
+                decoder.conceal(pcm_output, sizeof(pcm_output), &pcm_len);
+                if (!emitDecodedFrame(decoder, pcm_output, pcm_len, true, &timing))
+                    return;
+            }
+        }
+
+        ssize_t result = -1;
+        if (supported)
+            result = decoder.decode(msbc_data, msbc_data_len, pcm_output, sizeof(pcm_output), &pcm_len, pool.options, &timing);
+
+        if (result <= 0)
+        {
+            std::cerr << "❌ " << audioCodecName(decoder.format.codec) << " decode failed, error code: " << result << std::endl;
+            decoder.conceal(pcm_output, sizeof(pcm_output), &pcm_len);
+            if (!emitDecodedFrame(decoder, pcm_output, pcm_len, true, &timing))
+                return;
+        }
+        else
+        {
+            // mSBC gives exactly one 7.5 ms frame; SBC none, one or more
+            if (pcm_len > 0 && !emitDecodedFrame(decoder, pcm_output, pcm_len, false, &timing))
+                return;
+            while (decoder.takeFrame(pcm_output, sizeof(pcm_output), &pcm_len, pool.options, &timing)) {
+                if (!emitDecodedFrame(decoder, pcm_output, pcm_len, false, &timing))
+                    return;
+            }
+        }
+        timing.stageNs[LATENCY_TOTAL] = latencyClockNs() - timing.arrivalNs;
+        decoder.latency.record(timing);
+    }
+}
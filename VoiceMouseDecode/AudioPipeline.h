@@ -0,0 +1,65 @@
+//
+//  AudioPipeline.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "DecoderPool.h"
+#include "JitterBuffer.h"
+
+class PCMServer;
+
+// While silent frames are suppressed, the most recent frames are held back so
+// the onset isn't clipped when SPEECH_START fires (it is reported a few frames
+// after the speech began).
+#define AUDIO_PIPELINE_VAD_PREROLL_FRAMES 6
+
+/*
+ * The audio path of a voice session, from the frames of one audio report to
+ * the clients: H2 sequence tracking, codec detection, mSBC passthrough,
+ * concealment, decode and DSP, VAD with its pre-roll and silence
+ * suppression, the resume history, per-client resampling and the jitter
+ * buffer. The service (main.cpp) and tools/loadgen.cpp both run it, so load
+ * figures measure what the service does. What only the service does with a
+ * frame (archive, catalog, debug dump) it adds through the hooks.
+ */
+class AudioPipeline {
+public:
+    AudioPipeline(PCMServer& server, DecoderPool& pool) : server(server), pool(pool) {}
+
+    // Every frame not dropped as a duplicate, once its codec is known;
+    // lostFrames went missing right before it. context is handleFrames'.
+    // Optional.
+    std::function<void(void* context, DeviceDecoder& decoder, bool formatChanged, bool supported,
+                       const uint8_t* frame, size_t length, int lostFrames, uint64_t capturedNs)> onEncodedFrame;
+    // Every decoded or concealed 16 kHz frame, sent or not; returning false
+    // drops the rest of the report. Optional.
+    std::function<bool(const int16_t* pcm, size_t length)> onDecodedFrame;
+
+    // The frames of one audio report (their H2 headers, oldest first, see
+    // locateAudioFrames), the last one running up to reportEnd. nowNs is the
+    // report's HidBackend::now(), arrivalNs its latencyClockNs() arrival; the
+    // frames share both, decoding the earlier ones counts as queueing for the
+    // later ones. context is handed back to onEncodedFrame.
+    void handleFrames(DeviceDecoder& decoder, void* context, const uint8_t* const* frames, size_t count,
+                      const uint8_t* reportEnd, uint64_t nowNs, uint64_t arrivalNs);
+    // Sends what noise suppression still holds of the stream when it ends
+    void flush(DeviceDecoder& decoder);
+    // Logs the codec the device's audio is in and tells the clients
+    void announceCodec(DeviceDecoder& decoder, bool supported);
+    // JitterPlayout's send function: a held frame, in every rate it was kept in
+    void playout(const JitterBuffer::Frame& frame);
+
+private:
+    bool emitDecodedFrame(DeviceDecoder& decoder, int16_t* pcm, size_t len, bool concealed, FrameTiming* timing);
+    void sendDecodedAudio(DeviceDecoder& decoder, int16_t* pcm, size_t len, uint64_t seq, bool concealed,
+                          FrameTiming* timing);
+
+    PCMServer& server;
+    DecoderPool& pool;
+};
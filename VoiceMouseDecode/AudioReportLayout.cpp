@@ -0,0 +1,75 @@
+//
+//  AudioReportLayout.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "AudioReportLayout.h"
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+
+// Shipping firmware: one frame at the start of the report (0x01, H2, frame, padding)
+static std::map<uint16_t, AudioReportLayout> layouts = {
+    {0x8266, {1, 0, MSBC_H2_FRAME_LEN}},   // Bluetooth mouse
+    {0xCA10, {1, 0, MSBC_H2_FRAME_LEN}},   // 2.4G
+};
+
+AudioReportLayout audioReportLayoutForProduct(uint16_t productId) {
+    auto it = layouts.find(productId);
+    return it != layouts.end() ? it->second : AudioReportLayout();
+}
+
+void setAudioReportLayout(uint16_t productId, const AudioReportLayout& layout) {
+    layouts[productId] = layout;
+}
+
+bool parseAudioReportLayout(const std::string& spec, uint16_t* productId, AudioReportLayout* layout) {
+    unsigned long values[4] = {0, 0, 0, MSBC_H2_FRAME_LEN};
+    const char* p = spec.c_str();
+    int count = 0;
+    while (count < 4) {
+        char* end = nullptr;
+        values[count] = strtoul(p, &end, count == 0 ? 16 : 10);
+        if (end == p) return false;
+        count++;
+        if (*end == '\0') break;
+        if (*end != ':') return false;
+        p = end + 1;
+    }
+    if (count < 2 || values[0] > 0xFFFF || values[1] > AUDIO_REPORT_MAX_FRAMES || values[3] < MSBC_H2_FRAME_LEN)
+        return false;
+    *productId = (uint16_t)values[0];
+    layout->frameCount = values[1];
+    layout->firstOffset = values[2];
+    layout->frameStride = values[3];
+    return true;
+}
+
+size_t locateAudioFrames(const AudioReportLayout& layout, const uint8_t* report, size_t length,
+                         const uint8_t** frames, size_t maxFrames) {
+    if (layout.frameCount > 0) {
+        size_t described = layout.firstOffset + layout.frameCount * layout.frameStride;
+        size_t slot = layout.scannable ? MSBC_H2_FRAME_LEN : layout.frameStride;
+        if (length < described + MSBC_H2_FRAME_LEN || !layout.scannable) {
+            size_t n = 0;
+            for (size_t k = 0; k < layout.frameCount && n < maxFrames; ++k) {
+                size_t offset = layout.firstOffset + k * layout.frameStride;
+                if (offset + slot > length || report[offset] != 0x01)
+                    break;
+                frames[n++] = report + offset;
+            }
+            return n;
+        }
+    }
+
+    if (!layout.scannable)
+        return 0;
+    size_t offsets[AUDIO_REPORT_MAX_FRAMES];
+    size_t n = msbc_scan_frames(report, length, offsets, std::min<size_t>(maxFrames, AUDIO_REPORT_MAX_FRAMES));
+    for (size_t i = 0; i < n; ++i) {
+        frames[i] = report + offsets[i];
+    }
+    return n;
+}
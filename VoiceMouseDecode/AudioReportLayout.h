@@ -0,0 +1,46 @@
+//
+//  AudioReportLayout.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "msbc_scan.h"
+
+// Most mSBC frames taken from one audio report
+#define AUDIO_REPORT_MAX_FRAMES 8
+
+/*
+ * Where the H2-framed mSBC frames sit in a device's audio report. Each slot
+ * is the 2-byte H2 header and the 57-byte frame, followed by padding up to
+ * frameStride. frameCount 0 means the layout is unknown and frames are
+ * found with msbc_scan_frames().
+ */
+struct AudioReportLayout {
+    size_t frameCount = 0;
+    size_t firstOffset = 0;                 // of the first H2 header
+    size_t frameStride = MSBC_H2_FRAME_LEN;
+    // false for LC3, which has no syncword: the fixed layout is the only
+    // way to find its frames, and a slot is just the H2 header and the frame
+    bool scannable = true;
+};
+
+// The layout configured for a product ID, or an unknown one
+AudioReportLayout audioReportLayoutForProduct(uint16_t productId);
+void setAudioReportLayout(uint16_t productId, const AudioReportLayout& layout);
+
+// Parses "pid:frames[:offset[:stride]]" (pid in hex) as given to --report-layout
+bool parseAudioReportLayout(const std::string& spec, uint16_t* productId, AudioReportLayout* layout);
+
+// Fills frames with the H2 headers of the frames in report, in order, and
+// returns how many there are. A fixed layout is used while the report has
+// no room for more frames than it describes; a longer report (firmware that
+// packs more frames) is scanned, as is every report of an unknown layout.
+// A fixed slot only has to start with 0x01, as the single-frame path always
+// required: a corrupted H2 byte is left to sequence tracking.
+size_t locateAudioFrames(const AudioReportLayout& layout, const uint8_t* report, size_t length,
+                         const uint8_t** frames, size_t maxFrames);
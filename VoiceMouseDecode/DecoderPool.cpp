@@ -0,0 +1,445 @@
+//
+//  DecoderPool.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "DecoderPool.h"
+#include "JitterBuffer.h"
+#include "json.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using json = nlohmann::json;
+
+bool detectAudioFormat(const uint8_t* frame, size_t length, AudioFormat* format) {
+    if (length < 4 || (frame[0] != MSBC_SYNCWORD && frame[0] != SBC_SYNCWORD))
+        return false;
+
+    // Let sbc.c read the header (and check its CRC) the way the decoder will
+    sbc_t probe;
+    int ret = frame[0] == MSBC_SYNCWORD ? sbc_init_msbc(&probe, 0) : sbc_init(&probe, 0);
+    if (ret != 0)
+        return false;
+    ssize_t frameLength = sbc_parse(&probe, frame, length);
+    if (frameLength <= 0) {
+        sbc_finish(&probe);
+        return false;
+    }
+
+    static const int rates[] = {16000, 32000, 44100, 48000};
+    format->codec = frame[0] == MSBC_SYNCWORD ? AUDIO_CODEC_MSBC : AUDIO_CODEC_SBC;
+    format->sampleRate = rates[probe.frequency & 0x3];
+    format->channels = probe.mode == SBC_MODE_MONO ? 1 : 2;
+    format->frameLength = (size_t)frameLength;
+    format->frameSamples = sbc_get_codesize(&probe) / (2 * format->channels);
+    format->header[0] = frame[0];
+    format->header[1] = frame[1];
+    sbc_finish(&probe);
+    return true;
+}
+
+static std::mutex lc3FormatsMutex;
+static std::map<uint16_t, AudioFormat> lc3Formats;
+
+bool lc3FormatForProduct(uint16_t productId, AudioFormat* format) {
+    std::lock_guard<std::mutex> lock(lc3FormatsMutex);
+    auto it = lc3Formats.find(productId);
+    if (it == lc3Formats.end())
+        return false;
+    *format = it->second;
+    return true;
+}
+
+void setLc3Format(uint16_t productId, const AudioFormat& format) {
+    std::lock_guard<std::mutex> lock(lc3FormatsMutex);
+    lc3Formats[productId] = format;
+}
+
+bool parseLc3Format(const std::string& spec, uint16_t* productId, AudioFormat* format) {
+    unsigned long values[4] = {0, 0, 0, 0};
+    const char* p = spec.c_str();
+    for (int i = 0; i < 4; ++i) {
+        char* end = nullptr;
+        values[i] = strtoul(p, &end, i == 0 ? 16 : 10);
+        if (end == p || *end != (i == 3 ? '\0' : ':'))
+            return false;
+        p = end + 1;
+    }
+    lc3dec_t probe;
+    if (values[0] > 0xFFFF || values[3] < LC3DEC_MIN_FRAME_BYTES || values[3] > LC3DEC_MAX_FRAME_BYTES ||
+        lc3dec_init(&probe, (int)values[1], (int)values[2]) == -EINVAL)
+        return false;
+    lc3dec_finish(&probe);
+
+    *productId = (uint16_t)values[0];
+    format->codec = AUDIO_CODEC_LC3;
+    format->sampleRate = (int)values[1];
+    format->channels = 1;
+    format->frameLength = values[3];
+    format->frameUs = (int)values[2];
+    format->frameSamples = (size_t)format->sampleRate * format->frameUs / 1000000;
+    return true;
+}
+
+const char* audioCodecName(AudioCodec codec) {
+    switch (codec) {
+        case AUDIO_CODEC_MSBC: return "mSBC";
+        case AUDIO_CODEC_SBC: return "SBC";
+        case AUDIO_CODEC_LC3: return "LC3";
+        default: return "unknown";
+    }
+}
+
+DeviceDecoder::DeviceDecoder() {
+    sbc_init_msbc(&sbc, 0);
+    sbc.endian = SBC_LE;
+    memset(&lc3, 0, sizeof(lc3));
+    format.codec = AUDIO_CODEC_MSBC;
+    format.sampleRate = SAMPLE_RATE;
+    format.channels = 1;
+    format.frameLength = MSBC_FRAME_LEN;
+    format.frameSamples = MSBC_FRAME_SAMPLES;
+    format.header[0] = MSBC_SYNCWORD;
+    publishFormat();
+    agc_init(&agc);
+    noise_suppress_init(&noiseSuppressor);
+    beginStream();
+}
+
+DeviceDecoder::~DeviceDecoder() {
+    if (jitter)
+        jitter->close();
+    sbc_finish(&sbc);
+    lc3dec_finish(&lc3);
+}
+
+void DeviceDecoder::beginStream() {
+    noise_suppress_reset(&noiseSuppressor);
+    suppressorTail = 0;
+    agc_begin_session(&agc);
+    denoise_init(&highPass);
+    vad_init(&vad);
+    vadPreRoll.clear();
+    sequence.reset();
+    concealedRun = 0;
+    if (jitter)
+        jitter->reset();
+}
+
+SequenceStatus FrameSequence::update(uint8_t h2, uint64_t arrivalNs, int* lostFrames) {
+    *lostFrames = 0;
+    int seq = h2SequenceNumber(h2);
+    if (seq < 0)
+        return SEQ_INVALID;
+
+    SequenceStatus status = SEQ_IN_ORDER;
+    if (last < 0) {
+        status = SEQ_FIRST;
+    } else {
+        int missing = (seq - last - 1) & 0x3;
+        if (missing == 3 && arrivalNs - lastArrivalNs < 2 * MSBC_FRAME_INTERVAL_NS) {
+            duplicates++;
+            metricsAdd(METRIC_DUPLICATE_FRAMES);
+            return SEQ_DUPLICATE;
+        }
+        if (missing > 0) {
+            *lostFrames = missing;
+            lost += missing;
+            metricsAdd(METRIC_FRAMES_LOST, missing);
+            status = SEQ_GAP;
+        }
+    }
+    last = seq;
+    lastArrivalNs = arrivalNs;
+    return status;
+}
+
+bool DeviceDecoder::configure(const uint8_t* frame, size_t frameLen, bool* changed) {
+    *changed = false;
+    // LC3 has no header to read: its format came from setFormat()
+    if (format.codec == AUDIO_CODEC_LC3)
+        return formatSupported;
+    // mSBC has nothing to change in its header; SBC fixes the configuration in byte 1
+    if (frameLen >= 2 && frame[0] == format.header[0] &&
+        (format.codec == AUDIO_CODEC_MSBC || frame[1] == format.header[1]))
+        return formatSupported;
+
+    AudioFormat detected;
+    if (!detectAudioFormat(frame, frameLen, &detected))
+        return formatSupported;
+
+    format = detected;
+    resetCodec();
+    *changed = true;
+    return formatSupported;
+}
+
+bool DeviceDecoder::setFormat(const AudioFormat& newFormat) {
+    format = newFormat;
+    resetCodec();
+    return formatSupported;
+}
+
+// Sets up the codec and the resampler for format; the pipeline stages carry over
+void DeviceDecoder::resetCodec() {
+    sbc_finish(&sbc);
+    lc3dec_finish(&lc3);
+    bool codecReady = true;
+    if (format.codec == AUDIO_CODEC_LC3) {
+        int ret = lc3dec_init(&lc3, format.sampleRate, format.frameUs);
+        if (ret != 0)
+            std::cerr << "❌ LC3 decoder unavailable (" << lc3dec_get_implementation_info() << "), error code: "
+                      << ret << std::endl;
+        codecReady = ret == 0;
+    } else if (format.codec == AUDIO_CODEC_MSBC) {
+        sbc_init_msbc(&sbc, 0);
+    } else {
+        sbc_init(&sbc, 0);
+    }
+    sbc.endian = SBC_LE;
+    backlog.clear();
+    formatSupported = codecReady && (format.sampleRate == SAMPLE_RATE ||
+                                     resample_init(&toPipelineRate, format.sampleRate, SAMPLE_RATE) == 0);
+    publishFormat();
+}
+
+// sampleRate in bits 0-31, codec 32-39, channels 40-47, formatSupported 48
+void DeviceDecoder::publishFormat() {
+    formatStats.store((uint64_t)(uint32_t)format.sampleRate | (uint64_t)(format.codec & 0xFF) << 32 |
+                      (uint64_t)(format.channels & 0xFF) << 40 | (uint64_t)formatSupported << 48,
+                      std::memory_order_relaxed);
+}
+
+ssize_t DeviceDecoder::decodeFrame(const uint8_t* frame, size_t frameLen, int16_t* pcm, size_t pcmMaxLen,
+                                   size_t* written) {
+    if (format.codec == AUDIO_CODEC_LC3)
+        return lc3dec_decode(&lc3, frame, frameLen, pcm, pcmMaxLen, written);
+    return sbc_decode(&sbc, frame, frameLen, (uint8_t *)pcm, pcmMaxLen, written);
+}
+
+ssize_t DeviceDecoder::decode(const uint8_t* frame, size_t frameLen, int16_t* pcm, size_t pcmMaxLen,
+                              size_t* written, const PipelineOptions& options, FrameTiming* timing) {
+    uint64_t start = timing ? latencyClockNs() : 0;
+    ssize_t result;
+    // Frames that already are 7.5 ms of 16 kHz mono skip the backlog
+    bool native = format.sampleRate == SAMPLE_RATE && format.channels == 1 &&
+                  format.frameSamples == MSBC_FRAME_SAMPLES;
+    int16_t decoded[DECODED_MAX_FRAME_SAMPLES];
+    size_t decodedLen = 0;
+    *written = 0;
+    if (native)
+        result = decodeFrame(frame, frameLen, pcm, pcmMaxLen, &decodedLen);
+    else
+        result = decodeFrame(frame, frameLen, decoded, sizeof(decoded), &decodedLen);
+    if (timing)
+        timing->stageNs[LATENCY_DECODE] = latencyClockNs() - start;
+    if (result == -3) {
+        metricsAdd(METRIC_CRC_FAILURES);
+        crcErrors++;
+    } else if (result == -2) {
+        metricsAdd(METRIC_SYNC_ERRORS);
+        decodeErrors++;
+    } else if (result < 0) {
+        metricsAdd(METRIC_DECODE_ERRORS);
+        decodeErrors++;
+    }
+    if (result <= 0 || decodedLen == 0)
+        return result;
+    metricsAdd(METRIC_FRAMES_DECODED);
+
+    if (native) {
+        *written = decodedLen;
+        uint64_t processStart = timing ? latencyClockNs() : 0;
+        process(pcm, decodedLen / sizeof(int16_t), options);
+        if (timing)
+            timing->stageNs[LATENCY_DENOISE] = latencyClockNs() - processStart;
+        return result;
+    }
+
+    // SBC, LC3: down to mono, then to 16 kHz, into the backlog
+    size_t samples = decodedLen / (sizeof(int16_t) * format.channels);
+    if (format.channels == 2) {
+        for (size_t i = 0; i < samples; ++i) {
+            decoded[i] = (int16_t)(((int)decoded[2 * i] + decoded[2 * i + 1]) / 2);
+        }
+    }
+    if (format.sampleRate == SAMPLE_RATE) {
+        backlog.insert(backlog.end(), decoded, decoded + samples);
+    } else {
+        size_t offset = backlog.size();
+        backlog.resize(offset + resample_max_output(&toPipelineRate, samples));
+        size_t n = resample_process(&toPipelineRate, decoded, samples, backlog.data() + offset, backlog.size() - offset);
+        backlog.resize(offset + n);
+    }
+    takeFrame(pcm, pcmMaxLen, written, options, timing);
+    return result;
+}
+
+bool DeviceDecoder::takeFrame(int16_t* pcm, size_t pcmMaxLen, size_t* written, const PipelineOptions& options,
+                              FrameTiming* timing) {
+    if (backlog.size() < MSBC_FRAME_SAMPLES || pcmMaxLen < MSBC_FRAME_SAMPLES * sizeof(int16_t))
+        return false;
+    uint64_t start = timing ? latencyClockNs() : 0;
+    memcpy(pcm, backlog.data(), MSBC_FRAME_SAMPLES * sizeof(int16_t));
+    backlog.erase(backlog.begin(), backlog.begin() + MSBC_FRAME_SAMPLES);
+    *written = MSBC_FRAME_SAMPLES * sizeof(int16_t);
+    process(pcm, MSBC_FRAME_SAMPLES, options);
+    if (timing)
+        timing->stageNs[LATENCY_DENOISE] += latencyClockNs() - start;
+    return true;
+}
+
+bool DeviceDecoder::flushFrame(int16_t* pcm, size_t pcmMaxLen, size_t* written, const PipelineOptions& options) {
+    if (suppressorTail == 0 || pcmMaxLen < MSBC_FRAME_SAMPLES * sizeof(int16_t))
+        return false;
+    // Past the tail the frame is filled with what follows it: silence
+    noise_suppress_flush(pcm, MSBC_FRAME_SAMPLES, &noiseSuppressor);
+    suppressorTail -= std::min(suppressorTail, (size_t)MSBC_FRAME_SAMPLES);
+    if (options.denoiseGate)
+        denoise_buffer(pcm, MSBC_FRAME_SAMPLES, &highPass);
+    *written = MSBC_FRAME_SAMPLES * sizeof(int16_t);
+    return true;
+}
+
+void DeviceDecoder::process(int16_t* pcm, size_t samples, const PipelineOptions& options) {
+    if (options.agc)
+        agc_process(pcm, samples, &agc);
+    if (options.noiseSuppression) {
+        noise_suppress_buffer(pcm, samples, &noiseSuppressor);
+        suppressorTail = std::min(suppressorTail + samples, (size_t)NS_LATENCY);
+    }
+    if (options.denoiseGate)
+        denoise_buffer(pcm, samples, &highPass);
+
+    memcpy(lastPcm, pcm, std::min(samples * sizeof(int16_t), sizeof(lastPcm)));
+    concealedRun = 0;
+}
+
+void DeviceDecoder::conceal(int16_t* pcm, size_t pcmMaxLen, size_t* written) {
+    size_t samples = std::min((size_t)MSBC_FRAME_SAMPLES, pcmMaxLen / sizeof(int16_t));
+    concealedRun++;
+    if (concealedRun > MSBC_MAX_CONCEALED_FRAMES) {
+        memset(pcm, 0, samples * sizeof(int16_t));
+    } else {
+        int shift = concealedRun;    // -6 dB per concealed frame
+        for (size_t i = 0; i < samples; ++i) {
+            pcm[i] = (int16_t)(lastPcm[i] >> shift);
+        }
+    }
+    *written = samples * sizeof(int16_t);
+    concealed++;
+    metricsAdd(METRIC_CONCEALED_FRAMES);
+}
+
+ResamplerState* DeviceDecoder::resamplerFor(int rate) {
+    auto it = resamplers.find(rate);
+    if (it != resamplers.end())
+        return &it->second;
+
+    ResamplerState state;
+    if (resample_init(&state, SAMPLE_RATE, rate) != 0)
+        return nullptr;
+    return &resamplers.emplace(rate, state).first->second;
+}
+
+DeviceDecoder& DecoderPool::acquire(const void* device) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& slot = decoders[device];
+    if (!slot) {
+        slot = std::make_unique<DeviceDecoder>();
+        if (jitterPlayout)
+            slot->jitter = jitterPlayout->createBuffer();
+    }
+    return *slot;
+}
+
+void DecoderPool::release(const void* device) {
+    std::lock_guard<std::mutex> lock(mutex);
+    decoders.erase(device);
+}
+
+void DecoderPool::setLabel(DeviceDecoder& decoder, const std::string& label) {
+    std::lock_guard<std::mutex> lock(mutex);
+    decoder.label = label;
+}
+
+std::string DecoderPool::latencyStatsJson() {
+    json devices = json::array();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : decoders) {
+        json device = json::parse(entry.second->latency.toJson());
+        device["deviceId"] = entry.second->label;
+        devices.push_back(device);
+    }
+    return devices.dump();
+}
+
+bool DecoderPool::resumeFrames(const std::string& deviceId, uint64_t fromSeq, std::string* label,
+                               std::vector<AudioHistory::Frame>& frames, bool* complete) {
+    std::lock_guard<std::mutex> lock(mutex);
+    DeviceDecoder* found = nullptr;
+    for (auto& entry : decoders) {
+        DeviceDecoder* decoder = entry.second.get();
+        if (deviceId.empty() ? (!found || decoder->history.lastRecordNs() > found->history.lastRecordNs())
+                             : decoder->label == deviceId)
+            found = decoder;
+    }
+    if (!found)
+        return false;
+
+    *label = found->label;
+    *complete = found->history.since(fromSeq, frames);
+    return true;
+}
+
+static json buttonStatsJson(const AiButtonStats& stats) {
+    auto us = [](uint64_t ns) { return std::round(ns / 100.0) / 10.0; };
+    auto percentilesUs = [&](const LatencyHistogram& h) {
+        return json{
+            {"p50Us", us(h.percentile(0.50))},
+            {"p99Us", us(h.percentile(0.99))},
+            {"maxUs", us(h.max())},
+        };
+    };
+    return {
+        {"presses", stats.presses.load()},
+        {"longPresses", stats.longPresses.load()},
+        {"clicks", stats.clicks.load()},
+        {"sessionEnds", stats.sessionEnds.load()},
+        {"timerLate", percentilesUs(stats.timerLate)},
+        {"audioLag", percentilesUs(stats.audioLag)},
+        {"hold", percentilesUs(stats.hold)},
+    };
+}
+
+std::string DecoderPool::deviceStatsJson() {
+    json devices = json::array();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : decoders) {
+        uint64_t format = entry.second->formatStats.load(std::memory_order_relaxed);
+        devices.push_back({
+            {"deviceId", entry.second->label},
+            {"codec", {
+                {"name", audioCodecName((AudioCodec)(format >> 32 & 0xFF))},
+                {"sampleRate", (int)(uint32_t)format},
+                {"channels", (int)(format >> 40 & 0xFF)},
+                {"supported", (bool)(format >> 48 & 1)},
+            }},
+            {"sessions", entry.second->sessions.load()},
+            {"frames", entry.second->latency.stages[LATENCY_TOTAL].count()},
+            {"lost", entry.second->sequence.lost.load()},
+            {"duplicates", entry.second->sequence.duplicates.load()},
+            {"concealed", entry.second->concealed.load()},
+            {"button", buttonStatsJson(entry.second->button)},
+        });
+        if (entry.second->jitter)
+            devices.back()["jitterBuffer"] = json::parse(entry.second->jitter->statsJson());
+    }
+    return devices.dump();
+}
@@ -0,0 +1,257 @@
+//
+//  DecoderPool.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "sbc.h"
+#include "msbc_scan.h"
+#include "lc3dec.h"
+#include "agc.h"
+#include "denoise.h"
+#include "noise_suppress.h"
+#include "vad.h"
+#include "resample.h"
+#include "LatencyStats.h"
+#include "Metrics.h"
+#include "AudioHistory.h"
+#include "AiButton.h"
+
+class JitterBuffer;
+class JitterPlayout;
+
+// mSBC: 15 blocks x 8 subbands, mono
+#define MSBC_FRAME_SAMPLES 120
+// One mSBC frame every 7.5 ms
+#define MSBC_FRAME_INTERVAL_NS 7500000ull
+// Consecutive frames concealed before falling silent
+#define MSBC_MAX_CONCEALED_FRAMES 3
+// A2DP SBC frames start with this instead of MSBC_SYNCWORD
+#define SBC_SYNCWORD 0x9C
+// Largest decoded SBC frame: 16 blocks x 8 subbands x 2 channels
+#define SBC_MAX_FRAME_SAMPLES 256
+// Largest frame any codec decodes to
+#define DECODED_MAX_FRAME_SAMPLES (LC3DEC_MAX_FRAME_SAMPLES > SBC_MAX_FRAME_SAMPLES ? LC3DEC_MAX_FRAME_SAMPLES : SBC_MAX_FRAME_SAMPLES)
+
+enum AudioCodec {
+    AUDIO_CODEC_UNKNOWN,
+    AUDIO_CODEC_MSBC,       // syncword 0xAD: HFP wideband, 16 kHz mono, 120 samples
+    AUDIO_CODEC_SBC,        // syncword 0x9C: A2DP, 16/32/44.1/48 kHz, mono to joint stereo
+    AUDIO_CODEC_LC3,        // no syncword: configured per product (--lc3), 8-48 kHz mono
+};
+
+struct AudioFormat {
+    AudioCodec codec = AUDIO_CODEC_UNKNOWN;
+    int sampleRate = 0;
+    int channels = 0;
+    size_t frameLength = 0;     // encoded bytes, at the first frame's bitpool
+    size_t frameSamples = 0;    // per channel
+    int frameUs = 0;            // LC3 frame duration, 7500 or 10000
+    uint8_t header[2] = {0, 0}; // syncword and the byte that fixes rate, mode and blocks
+};
+
+// Reads codec and parameters from the header of one encoded frame, which
+// must pass its CRC. Returns false if it is neither mSBC nor SBC.
+bool detectAudioFormat(const uint8_t* frame, size_t length, AudioFormat* format);
+// LC3 of a product, which its frames can't tell: set with --lc3 as
+// "pid:rate:frame_us:bytes" (pid in hex). Returns false if the product has none.
+bool lc3FormatForProduct(uint16_t productId, AudioFormat* format);
+bool parseLc3Format(const std::string& spec, uint16_t* productId, AudioFormat* format);
+void setLc3Format(uint16_t productId, const AudioFormat& format);
+const char* audioCodecName(AudioCodec codec);
+
+// Sequence number (0-3) carried in the second byte of the HFP H2
+// synchronization header: 0x08, 0x38, 0xC8, 0xF8. Each of SN0 and SN1 is
+// sent twice, so any other value is a corrupted header; returns -1 then.
+inline int h2SequenceNumber(uint8_t h2) {
+    if ((h2 & 0x0F) != 0x08)
+        return -1;
+    int sn0 = (h2 >> 4) & 0x3;
+    int sn1 = (h2 >> 6) & 0x3;
+    if ((sn0 != 0 && sn0 != 0x3) || (sn1 != 0 && sn1 != 0x3))
+        return -1;
+    return (sn0 & 1) | ((sn1 & 1) << 1);
+}
+
+enum SequenceStatus {
+    SEQ_FIRST,          // first frame of the stream
+    SEQ_IN_ORDER,
+    SEQ_GAP,            // *lostFrames frames went missing before this one
+    SEQ_DUPLICATE,      // same frame delivered again; drop it
+    SEQ_INVALID,        // corrupted H2 header; tracking is left as is
+};
+
+// Tracks the 2-bit H2 sequence of one stream. A gap of 1-3 frames is read
+// from the sequence alone; a repeated number is a duplicate if it arrives
+// within two frame intervals of the previous frame, otherwise 3 lost frames.
+struct FrameSequence {
+    int last = -1;
+    uint64_t lastArrivalNs = 0;
+    std::atomic<uint64_t> lost{0};
+    std::atomic<uint64_t> duplicates{0};
+
+    SequenceStatus update(uint8_t h2, uint64_t arrivalNs, int* lostFrames);
+    void reset() { last = -1; lastArrivalNs = 0; }
+};
+
+struct PipelineOptions {
+    bool agc = true;
+    bool noiseSuppression = true;
+    bool denoiseGate = false;   // legacy high-pass + energy gate + smoother
+};
+
+// Everything one device needs to turn mSBC frames into processed PCM.
+// Used by one input thread at a time, so it needs no locking of its own.
+struct DeviceDecoder {
+    sbc_t sbc;
+    lc3dec_t lc3;               // set up only while format.codec is LC3
+    AgcState agc;
+    NoiseSuppressorState noiseSuppressor;
+    size_t suppressorTail = 0;  // samples of this stream in its delay line
+    HighPassFilterState highPass;
+    VadState vad;
+
+    // Frames held back while silent frames are suppressed (see main.cpp)
+    struct HeldFrame {
+        uint64_t seq;
+        bool concealed;
+        std::vector<uint8_t> pcm;
+    };
+    std::deque<HeldFrame> vadPreRoll;
+
+    // Loss detection from the H2 header, and the sequence number stamped on
+    // every outgoing audio frame (decoded or concealed). It counts on across
+    // voice streams, so a seq names one frame of the device for good.
+    FrameSequence sequence;
+    uint64_t nextStreamSeq = 0;
+
+    // Codec of the device's audio; mSBC until a frame says otherwise (configure)
+    // or the product is known to send LC3 (setFormat). Audio at other rates,
+    // with two channels or in frames of another length is brought to 16 kHz
+    // mono and cut into MSBC_FRAME_SAMPLES frames, so everything after
+    // decode() sees the same 7.5 ms frames whatever the codec.
+    AudioFormat format;
+    bool formatSupported = true;
+    // codec, sampleRate, channels and formatSupported packed into one word
+    // (see publishFormat), for the stats queries on client threads: format
+    // itself is only touched by the input thread
+    std::atomic<uint64_t> formatStats{0};
+    ResamplerState toPipelineRate;      // format.sampleRate -> SAMPLE_RATE
+    std::vector<int16_t> backlog;       // 16 kHz mono not yet making up a frame
+
+    // Last frame produced, repeated with decaying gain to conceal losses
+    int16_t lastPcm[MSBC_FRAME_SAMPLES] = {0};
+    int concealedRun = 0;
+    std::atomic<uint64_t> concealed{0};
+    std::atomic<uint64_t> crcErrors{0};
+    std::atomic<uint64_t> decodeErrors{0};     // sync and other decode failures
+
+    // Frames sent lately, whatever stream they belong to, for clients resuming
+    // after a reconnect
+    AudioHistory history{AUDIO_HISTORY_SECONDS * 1000000000ull / MSBC_FRAME_INTERVAL_NS};
+
+    // Set when the jitter buffer is on: frames go through it instead of
+    // straight to the clients (see sendDecodedAudio in main.cpp)
+    std::shared_ptr<JitterBuffer> jitter;
+
+    // One resampler per output rate some client asked for, shared by all of them
+    std::map<int, ResamplerState> resamplers;
+
+    // Per-stage latency of every frame since the device connected
+    DeviceLatency latency;
+    // Device ID shown in stats. Set through DecoderPool::setLabel, since
+    // the pool's queries read it from other threads.
+    std::string label;
+    std::atomic<uint64_t> sessions{0};  // long-press voice sessions
+    AiButtonStats button;       // press/long-press/release timing (see AiButton)
+
+    DeviceDecoder();
+    ~DeviceDecoder();
+    DeviceDecoder(const DeviceDecoder&) = delete;
+    DeviceDecoder& operator=(const DeviceDecoder&) = delete;
+
+    // Resets the per-utterance stages, H2 loss tracking and AGC telemetry;
+    // codec, AGC gain, the noise estimate, the outgoing seq and the history
+    // carry over
+    void beginStream();
+
+    // Returns the 16 kHz -> rate resampler, creating it on first use;
+    // nullptr if the rate isn't supported
+    ResamplerState* resamplerFor(int rate);
+
+    // Switches the decoder to the codec frame is encoded with when its header
+    // differs from the current format's; *changed tells whether it did. A
+    // frame with a corrupted header keeps the current format. Returns
+    // formatSupported: false if the rate can't be brought to 16 kHz.
+    bool configure(const uint8_t* frame, size_t frameLen, bool* changed);
+
+    // Switches to a codec given by configuration rather than read from the
+    // frames (LC3); configure() leaves it alone from then on. Returns
+    // formatSupported.
+    bool setFormat(const AudioFormat& newFormat);
+
+    // Decodes one frame and runs the enabled stages in order
+    // AGC -> noise suppression -> denoise gate. Returns the codec's result
+    // (sbc_decode or lc3dec_decode); *written is in bytes. Fills the
+    // decode/denoise stages of timing if given.
+    // Counts the frame (or its CRC/sync error) in the process metrics.
+    // An SBC or LC3 frame may not complete a 7.5 ms frame (*written is 0
+    // then) or may complete more than one: takeFrame() returns the rest.
+    ssize_t decode(const uint8_t* frame, size_t frameLen, int16_t* pcm, size_t pcmMaxLen,
+                   size_t* written, const PipelineOptions& options, FrameTiming* timing = nullptr);
+    bool takeFrame(int16_t* pcm, size_t pcmMaxLen, size_t* written, const PipelineOptions& options,
+                   FrameTiming* timing = nullptr);
+
+    // At the end of a stream, returns the samples noise suppression still
+    // holds back (NS_LATENCY at most) as frames; false once there are none.
+    bool flushFrame(int16_t* pcm, size_t pcmMaxLen, size_t* written, const PipelineOptions& options);
+
+    // Fills pcm with a stand-in for one lost frame: the last good frame at
+    // half the gain of the previous stand-in, then silence after
+    // MSBC_MAX_CONCEALED_FRAMES in a row. *written is in bytes.
+    void conceal(int16_t* pcm, size_t pcmMaxLen, size_t* written);
+
+private:
+    void resetCodec();
+    void publishFormat();
+    ssize_t decodeFrame(const uint8_t* frame, size_t frameLen, int16_t* pcm, size_t pcmMaxLen, size_t* written);
+    void process(int16_t* pcm, size_t samples, const PipelineOptions& options);
+};
+
+class DecoderPool {
+public:
+    DeviceDecoder& acquire(const void* device);
+    void release(const void* device);
+    // Sets decoder.label under the pool lock, which the queries below hold
+    void setLabel(DeviceDecoder& decoder, const std::string& label);
+
+    // JSON array with the latency percentiles of every device
+    std::string latencyStatsJson();
+    // Frames of a device's current stream from fromSeq on (see AudioHistory::since).
+    // The device is the one labelled deviceId, or the one that recorded audio
+    // most recently if deviceId is empty. Returns false if there is none.
+    bool resumeFrames(const std::string& deviceId, uint64_t fromSeq, std::string* label,
+                      std::vector<AudioHistory::Frame>& frames, bool* complete);
+
+    // JSON array of {deviceId, codec, sessions, frames, lost, duplicates,
+    // concealed, button, jitterBuffer} for every device
+    std::string deviceStatsJson();
+
+    PipelineOptions options;
+    // When set, every device gets a jitter buffer played out by it
+    JitterPlayout* jitterPlayout = nullptr;
+
+private:
+    std::mutex mutex;
+    std::unordered_map<const void*, std::unique_ptr<DeviceDecoder>> decoders;
+};
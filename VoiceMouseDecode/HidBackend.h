@@ -0,0 +1,104 @@
+//
+//  HidBackend.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <time.h>
+#include "LatencyStats.h"
+#include "HidReport.h"
+
+// Opaque per-device handle; stays valid until deviceRemoved returns
+using HidDeviceRef = const void*;
+
+// Returned by scheduleTimer; 0 is never a valid timer
+using HidTimerId = uint64_t;
+
+struct HidDeviceInfo {
+    uint16_t vendorId = 0;
+    uint16_t productId = 0;
+    std::string serialNumber;
+};
+
+/*
+ * Platform HID input. Every platform reads whole input reports and delivers
+ * each one once, split into the element values that changed (usagePage/usage
+ * and bytes, as IOKit's value callback would report them; see HidReport.h),
+ * together with the context pointer deviceConnected returned for the device.
+ *
+ * macOS: IOHIDManager on the main run loop, IOHIDDeviceRegisterInputReportCallback
+ *        per device (HidBackendMac.cpp)
+ * Linux: hidapi over hidraw, one reader thread per interface (HidBackendLinux.cpp).
+ *        The interfaces of one physical device are one HidDeviceRef. Callbacks
+ *        of a device are serialized; those of different devices may run
+ *        concurrently, so state shared between devices needs its own lock.
+ *
+ * Timers fire on the same thread (macOS: CFRunLoopTimer on the run loop) or
+ * under the same lock (Linux: timerfd thread, holding the lock of the device
+ * whose callback scheduled the timer) as the input callbacks, so a timer
+ * handler may touch that device's state without locking of its own.
+ */
+class HidBackend {
+public:
+    struct Callbacks {
+        // Returns the context passed with every report of the device; it must
+        // stay valid until deviceRemoved returns
+        std::function<void*(HidDeviceRef, const HidDeviceInfo&)> deviceConnected;
+        std::function<void(HidDeviceRef, const HidDeviceInfo&)> deviceRemoved;
+        std::function<void(HidDeviceRef, void* context, const HidInputValue* values, size_t count)> inputReport;
+    };
+
+    virtual ~HidBackend() = default;
+
+    // Starts matching vendorId / productIds. Returns false if HID access is
+    // denied (Input Monitoring on macOS, hidraw permissions on Linux).
+    virtual bool open(uint16_t vendorId, const std::vector<uint16_t>& productIds, const Callbacks& callbacks) = 0;
+
+    // Blocks delivering callbacks until stop()
+    virtual void run() = 0;
+    virtual void stop() = 0;
+
+    // report[0] is the report ID
+    virtual bool sendOutputReport(HidDeviceRef device, const uint8_t* report, size_t length) = 0;
+
+    // Bluetooth address of the device as "aa:bb:cc:dd:ee:ff", empty if unknown
+    virtual std::string bluetoothAddress(HidDeviceRef device) = 0;
+
+    // Monotonic time of the input being delivered, in ns. Button timing must
+    // use this rather than the wall clock so replayed captures behave the
+    // same at any speed.
+    virtual uint64_t now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    // latencyClockNs() at which the report being delivered arrived from the
+    // OS. Only meaningful inside inputReport.
+    virtual uint64_t reportArrivalNs() {
+        return latencyClockNs();
+    }
+
+    // Calls fire once when now() reaches deadlineNs, whether or not any input
+    // arrives meanwhile. Inside fire, now() is the time it actually fired.
+    // May be called from callbacks and timer handlers.
+    virtual HidTimerId scheduleTimer(uint64_t deadlineNs, std::function<void()> fire) = 0;
+    // No-op if the timer already fired or was cancelled
+    virtual void cancelTimer(HidTimerId timer) = 0;
+};
+
+std::unique_ptr<HidBackend> createHidBackend();
+
+// Wraps backend and writes everything it delivers to a capture file (HidCapture.h)
+std::unique_ptr<HidBackend> createRecordingHidBackend(std::unique_ptr<HidBackend> backend, const std::string& path);
+
+// Plays a capture file back through the callbacks. speed 1 is real time,
+// 0 replays as fast as the pipeline takes it. Prints throughput when done.
+std::unique_ptr<HidBackend> createReplayHidBackend(const std::string& path, double speed);
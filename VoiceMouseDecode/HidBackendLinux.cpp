@@ -0,0 +1,496 @@
+//
+//  HidBackendLinux.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+//  Headless Linux build (hidapi over hidraw):
+//  g++ -std=c++17 -O2 -msse2 -o voicemousedecode main.cpp PCMServer.cpp DecoderPool.cpp AudioPipeline.cpp
+//      HidBackendLinux.cpp HidCapture.cpp HidReport.cpp AiButton.cpp AudioReportLayout.cpp LatencyStats.cpp Metrics.cpp JitterBuffer.cpp AudioHistory.cpp AudioArchive.cpp SessionCatalog.cpp base64.cpp *.c -lhidapi-hidraw -lsqlite3 -lpthread -ldl
+//  LC3 devices (--lc3) use liblc3 if it is installed (loaded at run time);
+//  add -DLC3DEC_WITH_LIBLC3 -llc3 to link it instead
+//
+
+#ifdef __linux__
+
+#include "HidBackend.h"
+#include "hidapi.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <limits.h>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdlib.h>
+#include <thread>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace {
+
+const int HID_READ_TIMEOUT_MS = 100;        // reader threads notice stop() within this
+const int HID_ENUMERATE_INTERVAL_MS = 1000; // hidraw has no hotplug callback, poll for new devices
+const size_t HID_MAX_REPORT = 1024;
+
+// One hidraw node: a single HID interface of a device
+struct LinuxHidInterface {
+    std::string path;
+    hid_device* handle = nullptr;
+    uint32_t usagePage = 0;
+    uint32_t usage = 0;
+    std::vector<uint8_t> outputReportIds;
+
+    HidReportParser parser;
+    std::vector<HidInputValue> values;  // of the report being dispatched
+
+    std::thread reader;
+    std::atomic<bool> finished{false};
+};
+
+// One physical device with every interface it exposes, so a mouse with
+// several hidraw nodes is connected once
+struct LinuxHidDevice : std::enable_shared_from_this<LinuxHidDevice> {
+    std::string key;                    // physicalDeviceKey
+    HidDeviceInfo info;
+    void* context = nullptr;            // from deviceConnected
+
+    // Serializes the callbacks of this device and the timers they scheduled;
+    // other devices dispatch concurrently
+    std::mutex dispatchMutex;
+    std::atomic<bool> removed{false};   // deviceRemoved ran
+    std::atomic<int> liveReaders{0};    // interfaces whose node is still there
+
+    std::mutex interfacesMutex;         // run() adds and reaps them while callbacks write
+    std::list<std::unique_ptr<LinuxHidInterface>> interfaces;
+};
+
+// The device whose callback or timer runs on this thread, and when the report
+// being dispatched arrived
+thread_local LinuxHidDevice* dispatchingDevice = nullptr;
+thread_local uint64_t dispatchArrivalNs = 0;
+
+// What the interfaces of one device have in common: the sysfs directory of the
+// device above the HID one (past the USB interface directory, "1-2:1.0"),
+// and the serial. Devices behind uhid (Bluetooth LE) share their directory, so
+// without a serial each node stands alone.
+std::string physicalDeviceKey(const struct hid_device_info* cur, const std::string& serial) {
+    std::string ids = std::to_string(cur->vendor_id) + ":" + std::to_string(cur->product_id) + ":" + serial;
+    const char* node = strrchr(cur->path, '/');
+    std::string link = std::string("/sys/class/hidraw/") + (node ? node + 1 : cur->path) + "/device";
+    char resolved[PATH_MAX];
+    if (!realpath(link.c_str(), resolved))
+        return serial.empty() ? cur->path : ids;
+
+    std::string dir = resolved;
+    dir.erase(dir.rfind('/'));
+    std::string name = dir.substr(dir.rfind('/') + 1);
+    size_t colon = name.find(':');
+    if (colon != std::string::npos && name.find('.', colon) != std::string::npos)
+        dir.erase(dir.rfind('/'));
+    if (dir.find("/virtual/") != std::string::npos)
+        return serial.empty() ? cur->path : ids;
+    return dir + "|" + ids;
+}
+
+class LinuxHidBackend : public HidBackend {
+public:
+    ~LinuxHidBackend() override {
+        stop();
+        for (auto& dev : devices) {
+            for (auto& iface : dev->interfaces) {
+                if (iface->reader.joinable()) iface->reader.join();
+                hid_close(iface->handle);
+            }
+        }
+        if (timerFd >= 0) close(timerFd);
+        hid_exit();
+    }
+
+    bool open(uint16_t vid, const std::vector<uint16_t>& pids, const Callbacks& cb) override {
+        if (hid_init() != 0) {
+            std::cerr << "❌ hid_init failed" << std::endl;
+            return false;
+        }
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timerFd < 0) {
+            std::cerr << "❌ timerfd_create failed" << std::endl;
+            return false;
+        }
+        vendorId = vid;
+        productIds = std::set<uint16_t>(pids.begin(), pids.end());
+        callbacks = cb;
+        running = true;
+
+        // hid_open_path fails with EACCES when the hidraw nodes aren't readable;
+        // treat a matching device we can't open as a permission problem
+        struct hid_device_info* list = hid_enumerate(vendorId, 0);
+        bool denied = false, opened = false;
+        for (struct hid_device_info* cur = list; cur; cur = cur->next) {
+            if (!productIds.count(cur->product_id)) continue;
+            hid_device* handle = hid_open_path(cur->path);
+            if (handle) {
+                opened = true;
+                hid_close(handle);
+            } else {
+                denied = true;
+            }
+        }
+        hid_free_enumeration(list);
+        if (denied && !opened) {
+            std::cerr << "❌ Failed to open hidraw device: check /dev/hidraw* permissions (udev rule)" << std::endl;
+            return false;
+        }
+        std::cout << "hidapi opened successfully (" << hid_version_str() << ")" << std::endl;
+        return true;
+    }
+
+    void run() override {
+        std::thread timerThread(&LinuxHidBackend::timerLoop, this);
+        while (running) {
+            enumerate();
+            reapFinished();
+
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(HID_ENUMERATE_INTERVAL_MS), [this] {
+                return !running || reapPending;
+            });
+            reapPending = false;
+        }
+
+        for (auto& dev : devices) {
+            for (auto& iface : dev->interfaces) {
+                if (iface->reader.joinable()) iface->reader.join();
+            }
+        }
+        timerThread.join();
+    }
+
+    void stop() override {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            running = false;
+        }
+        wake.notify_all();
+    }
+
+    // Goes to the interface that declares the report ID as output, or the
+    // first one if none does
+    bool sendOutputReport(HidDeviceRef device, const uint8_t* report, size_t length) override {
+        auto* dev = (LinuxHidDevice*)device;
+        std::lock_guard<std::mutex> lock(dev->interfacesMutex);
+        LinuxHidInterface* target = nullptr;
+        for (auto& iface : dev->interfaces) {
+            if (iface->finished) continue;
+            const auto& ids = iface->outputReportIds;
+            if (std::find(ids.begin(), ids.end(), report[0]) != ids.end()) {
+                target = iface.get();
+                break;
+            }
+            if (!target) target = iface.get();
+        }
+        if (!target) {
+            std::cerr << "❌ hid_write failed: device has no open interface" << std::endl;
+            return false;
+        }
+        int ret = hid_write(target->handle, report, length);
+        if (ret < 0) {
+            std::cerr << "❌ hid_write failed: " << narrow(hid_error(target->handle)) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t reportArrivalNs() override {
+        return dispatchArrivalNs;
+    }
+
+    std::string bluetoothAddress(HidDeviceRef device) override {
+        // hidraw exposes the Bluetooth address of a BT HID device as its serial (HID_UNIQ)
+        std::string serial = ((const LinuxHidDevice*)device)->info.serialNumber;
+        if (serial.size() != 17) return "";
+        for (auto& c : serial) c = (char)tolower((unsigned char)c);
+        return serial;
+    }
+
+    // A timer belongs to the device whose callback scheduled it and fires
+    // under its lock; one scheduled elsewhere fires under none
+    HidTimerId scheduleTimer(uint64_t deadlineNs, std::function<void()> fire) override {
+        std::shared_ptr<LinuxHidDevice> owner = dispatchingDevice ? dispatchingDevice->shared_from_this() : nullptr;
+        std::lock_guard<std::mutex> lock(timerMutex);
+        HidTimerId id = nextTimerId++;
+        timers[id] = {deadlineNs, std::move(fire), std::move(owner)};
+        armTimer();
+        return id;
+    }
+
+    void cancelTimer(HidTimerId timer) override {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        if (timers.erase(timer))
+            armTimer();
+    }
+
+private:
+    struct Timer {
+        uint64_t deadlineNs;
+        std::function<void()> fire;
+        std::shared_ptr<LinuxHidDevice> device;     // kept alive until it fired
+    };
+
+    static std::string narrow(const wchar_t* ws) {
+        std::string s;
+        if (!ws) return s;
+        for (; *ws; ++ws) s.push_back(*ws < 0x80 ? (char)*ws : '?');
+        return s;
+    }
+
+    // Opens the nodes not open yet. Nodes of a device already connected join
+    // it; a new device is connected once all its nodes in this listing are
+    // open, and only then do their readers start.
+    void enumerate() {
+        std::vector<std::shared_ptr<LinuxHidDevice>> connected;
+        std::vector<std::pair<LinuxHidDevice*, LinuxHidInterface*>> opened;
+
+        struct hid_device_info* list = hid_enumerate(vendorId, 0);
+        for (struct hid_device_info* cur = list; cur; cur = cur->next) {
+            if (!productIds.count(cur->product_id)) continue;
+            if (openPaths.count(cur->path)) continue;
+
+            hid_device* handle = hid_open_path(cur->path);
+            if (!handle) continue;
+
+            auto iface = std::make_unique<LinuxHidInterface>();
+            iface->path = cur->path;
+            iface->handle = handle;
+            iface->usagePage = cur->usage_page;
+            iface->usage = cur->usage;
+
+            uint8_t desc[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+            int descLen = hid_get_report_descriptor(handle, desc, sizeof(desc));
+            if (descLen > 0) {
+                iface->parser.setDescriptor(desc, descLen);
+                iface->outputReportIds = parseHidOutputReportIds(desc, descLen);
+            }
+
+            std::string serial = narrow(cur->serial_number);
+            std::string key = physicalDeviceKey(cur, serial);
+            std::shared_ptr<LinuxHidDevice> dev;
+            for (auto& existing : devices) {
+                if (existing->key == key && !existing->removed)
+                    dev = existing;
+            }
+            if (!dev) {
+                dev = std::make_shared<LinuxHidDevice>();
+                dev->key = key;
+                dev->info.vendorId = cur->vendor_id;
+                dev->info.productId = cur->product_id;
+                dev->info.serialNumber = serial;
+                devices.push_back(dev);
+                connected.push_back(dev);
+            }
+
+            openPaths.insert(iface->path);
+            opened.emplace_back(dev.get(), iface.get());
+            dev->liveReaders++;
+            std::lock_guard<std::mutex> lock(dev->interfacesMutex);
+            dev->interfaces.push_back(std::move(iface));
+        }
+        hid_free_enumeration(list);
+
+        for (auto& dev : connected) {
+            std::lock_guard<std::mutex> lock(dev->dispatchMutex);
+            dispatchingDevice = dev.get();
+            if (callbacks.deviceConnected)
+                dev->context = callbacks.deviceConnected(dev.get(), dev->info);
+            dispatchingDevice = nullptr;
+        }
+        for (auto& entry : opened) {
+            entry.second->reader = std::thread(&LinuxHidBackend::readLoop, this, entry.first, entry.second);
+        }
+    }
+
+    void reapFinished() {
+        for (auto it = devices.begin(); it != devices.end();) {
+            LinuxHidDevice* dev = it->get();
+            std::list<std::unique_ptr<LinuxHidInterface>> finished;
+            {
+                std::lock_guard<std::mutex> lock(dev->interfacesMutex);
+                for (auto iface = dev->interfaces.begin(); iface != dev->interfaces.end();) {
+                    if ((*iface)->finished) {
+                        finished.push_back(std::move(*iface));
+                        iface = dev->interfaces.erase(iface);
+                    } else {
+                        ++iface;
+                    }
+                }
+            }
+            for (auto& iface : finished) {
+                iface->reader.join();
+                hid_close(iface->handle);
+                openPaths.erase(iface->path);
+            }
+
+            bool empty;
+            {
+                std::lock_guard<std::mutex> lock(dev->interfacesMutex);
+                empty = dev->interfaces.empty();
+            }
+            if (dev->removed && empty)
+                it = devices.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    void readLoop(LinuxHidDevice* dev, LinuxHidInterface* iface) {
+        uint8_t report[HID_MAX_REPORT];
+        while (running) {
+            int n = hid_read_timeout(iface->handle, report, sizeof(report), HID_READ_TIMEOUT_MS);
+            if (n < 0) {
+                // hidraw node went away; the device is gone (unplugged, link
+                // dropped) once all its nodes are
+                if (--dev->liveReaders == 0) {
+                    std::lock_guard<std::mutex> lock(dev->dispatchMutex);
+                    if (!dev->removed.exchange(true) && callbacks.deviceRemoved) {
+                        dispatchingDevice = dev;
+                        callbacks.deviceRemoved(dev, dev->info);
+                        dispatchingDevice = nullptr;
+                    }
+                }
+                break;
+            }
+            if (n > 0) {
+                uint64_t arrival = latencyClockNs();
+                std::lock_guard<std::mutex> lock(dev->dispatchMutex);
+                if (dev->removed)
+                    continue;
+                dispatchingDevice = dev;
+                dispatchArrivalNs = arrival;
+                dispatchReport(dev, iface, report, n);
+                dispatchingDevice = nullptr;
+            }
+        }
+
+        iface->finished = true;
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            reapPending = true;
+        }
+        wake.notify_all();
+    }
+
+    // With timerMutex held: point the timerfd at the earliest deadline, or
+    // disarm it. An absolute deadline already passed fires right away.
+    void armTimer() {
+        struct itimerspec spec = {};
+        if (!timers.empty()) {
+            uint64_t earliest = UINT64_MAX;
+            for (auto& entry : timers) earliest = std::min(earliest, entry.second.deadlineNs);
+            earliest = std::max<uint64_t>(earliest, 1);     // all zero would disarm
+            spec.it_value.tv_sec = earliest / 1000000000ull;
+            spec.it_value.tv_nsec = earliest % 1000000000ull;
+        }
+        timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+
+    void timerLoop() {
+        while (running) {
+            struct pollfd pfd = {timerFd, POLLIN, 0};
+            if (poll(&pfd, 1, HID_READ_TIMEOUT_MS) <= 0)
+                continue;
+            uint64_t expirations;
+            if (read(timerFd, &expirations, sizeof(expirations)) < 0)
+                continue;
+            fireDueTimers();
+        }
+    }
+
+    // A due timer is taken only once its device's lock is held, so one
+    // cancelled by a callback that ran first can't fire afterwards
+    void fireDueTimers() {
+        uint64_t t = now();
+        while (true) {
+            HidTimerId id;
+            std::shared_ptr<LinuxHidDevice> device;
+            {
+                std::lock_guard<std::mutex> lock(timerMutex);
+                auto due = timers.end();
+                for (auto it = timers.begin(); it != timers.end(); ++it) {
+                    if (it->second.deadlineNs <= t && (due == timers.end() || it->second.deadlineNs < due->second.deadlineNs))
+                        due = it;
+                }
+                if (due == timers.end()) {
+                    armTimer();
+                    return;
+                }
+                id = due->first;
+                device = due->second.device;
+            }
+
+            std::unique_lock<std::mutex> dispatch;
+            if (device)
+                dispatch = std::unique_lock<std::mutex>(device->dispatchMutex);
+            std::function<void()> fire;
+            {
+                std::lock_guard<std::mutex> lock(timerMutex);
+                auto it = timers.find(id);
+                if (it == timers.end())
+                    continue;           // cancelled meanwhile
+                fire = std::move(it->second.fire);
+                timers.erase(it);
+            }
+            if (device && device->removed)
+                continue;
+            dispatchingDevice = device.get();
+            dispatchArrivalNs = latencyClockNs();
+            fire();
+            dispatchingDevice = nullptr;
+        }
+    }
+
+    void dispatchReport(LinuxHidDevice* dev, LinuxHidInterface* iface, const uint8_t* report, size_t length) {
+        if (!callbacks.inputReport) return;
+
+        if (iface->parser.empty()) {
+            // No descriptor: hand over the whole report as one element
+            HidInputValue value = {iface->usagePage, iface->usage, report, length};
+            callbacks.inputReport(dev, dev->context, &value, 1);
+            return;
+        }
+
+        iface->parser.parse(report, length, iface->values);
+        if (!iface->values.empty())
+            callbacks.inputReport(dev, dev->context, iface->values.data(), iface->values.size());
+    }
+
+    uint16_t vendorId = 0;
+    std::set<uint16_t> productIds;
+    Callbacks callbacks;
+
+    // Owned by the run() thread; timers may keep a removed device alive a little longer
+    std::list<std::shared_ptr<LinuxHidDevice>> devices;
+    std::set<std::string> openPaths;
+
+    std::atomic<bool> running{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool reapPending = false;
+
+    int timerFd = -1;
+    std::mutex timerMutex;                  // taken after a device's dispatchMutex, never before
+    std::map<HidTimerId, Timer> timers;
+    HidTimerId nextTimerId = 1;
+};
+
+} // namespace
+
+std::unique_ptr<HidBackend> createHidBackend() {
+    return std::make_unique<LinuxHidBackend>();
+}
+
+#endif
@@ -0,0 +1,262 @@
+//
+//  HidBackendMac.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#ifdef __APPLE__
+
+#include "HidBackend.h"
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/hid/IOHIDManager.h>
+#include <mach/mach_time.h>
+#include <iostream>
+#include <map>
+
+std::string getBluetoothMouseMac();
+
+namespace {
+
+// Input report buffer size when the device doesn't report kIOHIDMaxInputReportSizeKey
+const uint32_t HID_DEFAULT_MAX_REPORT = 64;
+
+class MacHidBackend;
+
+struct MacHidDevice {
+    IOHIDDeviceRef device = nullptr;
+    MacHidBackend* backend = nullptr;
+    HidReportParser parser;
+    std::vector<uint8_t> reportBuffer;  // IOKit writes each input report here
+    std::vector<HidInputValue> values;  // of the report being delivered
+    uint32_t primaryUsagePage = 0;
+    uint32_t primaryUsage = 0;
+    void* context = nullptr;            // from deviceConnected
+};
+
+class MacHidBackend : public HidBackend {
+public:
+    ~MacHidBackend() override {
+        for (auto& entry : timers) {
+            CFRunLoopTimerInvalidate(entry.second.timer);
+            CFRelease(entry.second.timer);
+        }
+        if (hidManager) CFRelease(hidManager);
+    }
+
+    bool open(uint16_t vendorId, const std::vector<uint16_t>& productIds, const Callbacks& cb) override {
+        callbacks = cb;
+
+        hidManager = IOHIDManagerCreate(kCFAllocatorDefault, kIOHIDOptionsTypeNone);
+        if (!hidManager) {
+            std::cerr << "Failed to create IOHIDManager\n";
+            return false;
+        }
+
+        IOReturn ret = IOHIDManagerOpen(hidManager, kIOHIDOptionsTypeNone);
+        if (ret != kIOReturnSuccess) {
+            std::cerr << "❌ Failed to open HID Manager: Input Monitoring permission required\n";
+            return false;
+        }
+        std::cout << "HID Manager opened successfully\n";
+
+        int vid = vendorId;
+        CFNumberRef vidRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &vid);
+        CFMutableArrayRef matchingArray = CFArrayCreateMutable(kCFAllocatorDefault, 0, &kCFTypeArrayCallBacks);
+        for (uint16_t productId : productIds) {
+            int pid = productId;
+            CFMutableDictionaryRef dict = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+            CFNumberRef pidRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &pid);
+            CFDictionarySetValue(dict, CFSTR(kIOHIDVendorIDKey), vidRef);
+            CFDictionarySetValue(dict, CFSTR(kIOHIDProductIDKey), pidRef);
+            CFArrayAppendValue(matchingArray, dict);
+            CFRelease(pidRef);
+            CFRelease(dict);
+        }
+
+        // 设置匹配多个设备
+        IOHIDManagerSetDeviceMatchingMultiple(hidManager, matchingArray);
+        CFRelease(vidRef);
+        CFRelease(matchingArray);
+
+        // register device connect/remove callbacks
+        IOHIDManagerRegisterDeviceMatchingCallback(hidManager, DeviceMatched, this);
+        IOHIDManagerRegisterDeviceRemovalCallback(hidManager, DeviceRemoved, this);
+        IOHIDManagerScheduleWithRunLoop(hidManager, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
+        runLoop = CFRunLoopGetCurrent();
+        return true;
+    }
+
+    void run() override {
+        CFRunLoopRun();
+    }
+
+    void stop() override {
+        if (runLoop) CFRunLoopStop(runLoop);
+    }
+
+    bool sendOutputReport(HidDeviceRef device, const uint8_t* report, size_t length) override {
+        IOReturn ret = IOHIDDeviceSetReport((IOHIDDeviceRef)device,
+                                            kIOHIDReportTypeOutput,
+                                            report[0],  // reportID
+                                            report,
+                                            length);    // 包含 reportID
+        if (ret != kIOReturnSuccess) {
+            std::cerr << "❌ Failed to send output report, IOReturn = 0x" << std::hex << ret << std::dec << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t reportArrivalNs() override {
+        return arrivalNs;
+    }
+
+    std::string bluetoothAddress(HidDeviceRef) override {
+        // IOKit doesn't expose the address of a HID device; ask IOBluetooth (BLEAudio.mm)
+        return getBluetoothMouseMac();
+    }
+
+    HidTimerId scheduleTimer(uint64_t deadlineNs, std::function<void()> fire) override {
+        HidTimerId id = nextTimerId++;
+        uint64_t t = now();
+        CFAbsoluteTime fireDate = CFAbsoluteTimeGetCurrent() + (deadlineNs > t ? (deadlineNs - t) / 1e9 : 0);
+        CFRunLoopTimerContext context = {0, this, nullptr, nullptr, nullptr};
+        CFRunLoopTimerRef timer = CFRunLoopTimerCreate(kCFAllocatorDefault, fireDate, 0, 0, 0, TimerFired, &context);
+        CFRunLoopTimerSetTolerance(timer, 0);   // no coalescing, the deadline is the point
+        timers[id] = {timer, std::move(fire)};
+        CFRunLoopAddTimer(runLoop ? runLoop : CFRunLoopGetCurrent(), timer, kCFRunLoopDefaultMode);
+        return id;
+    }
+
+    void cancelTimer(HidTimerId id) override {
+        auto it = timers.find(id);
+        if (it == timers.end()) return;
+        CFRunLoopTimerInvalidate(it->second.timer);
+        CFRelease(it->second.timer);
+        timers.erase(it);
+    }
+
+private:
+    struct Timer {
+        CFRunLoopTimerRef timer;
+        std::function<void()> fire;
+    };
+
+    static void TimerFired(CFRunLoopTimerRef timer, void* info) {
+        auto* self = static_cast<MacHidBackend*>(info);
+        for (auto it = self->timers.begin(); it != self->timers.end(); ++it) {
+            if (it->second.timer != timer) continue;
+            std::function<void()> fire = std::move(it->second.fire);
+            CFRelease(timer);   // the run loop holds its own reference while firing
+            self->timers.erase(it);
+            self->arrivalNs = latencyClockNs();
+            fire();
+            return;
+        }
+    }
+
+    static HidDeviceInfo deviceInfo(IOHIDDeviceRef device) {
+        HidDeviceInfo info;
+        int value = 0;
+        CFTypeRef ref = IOHIDDeviceGetProperty(device, CFSTR(kIOHIDVendorIDKey));
+        if (ref) CFNumberGetValue((CFNumberRef)ref, kCFNumberIntType, &value);
+        info.vendorId = value;
+
+        value = 0;
+        ref = IOHIDDeviceGetProperty(device, CFSTR(kIOHIDProductIDKey));
+        if (ref) CFNumberGetValue((CFNumberRef)ref, kCFNumberIntType, &value);
+        info.productId = value;
+
+        ref = IOHIDDeviceGetProperty(device, CFSTR(kIOHIDSerialNumberKey));
+        if (ref && CFGetTypeID(ref) == CFStringGetTypeID()) {
+            char buf[128];
+            if (CFStringGetCString((CFStringRef)ref, buf, sizeof(buf), kCFStringEncodingUTF8))
+                info.serialNumber = buf;
+        }
+        return info;
+    }
+
+    static uint32_t intProperty(IOHIDDeviceRef device, CFStringRef key, uint32_t fallback) {
+        int value = 0;
+        CFTypeRef ref = IOHIDDeviceGetProperty(device, key);
+        if (!ref || CFGetTypeID(ref) != CFNumberGetTypeID() || !CFNumberGetValue((CFNumberRef)ref, kCFNumberIntType, &value))
+            return fallback;
+        return (uint32_t)value;
+    }
+
+    static void DeviceMatched(void* context, IOReturn, void*, IOHIDDeviceRef device) {
+        auto* self = static_cast<MacHidBackend*>(context);
+
+        auto dev = std::make_unique<MacHidDevice>();
+        dev->device = device;
+        dev->backend = self;
+        dev->primaryUsagePage = intProperty(device, CFSTR(kIOHIDPrimaryUsagePageKey), 0);
+        dev->primaryUsage = intProperty(device, CFSTR(kIOHIDPrimaryUsageKey), 0);
+        CFTypeRef descriptor = IOHIDDeviceGetProperty(device, CFSTR(kIOHIDReportDescriptorKey));
+        if (descriptor && CFGetTypeID(descriptor) == CFDataGetTypeID()) {
+            dev->parser.setDescriptor(CFDataGetBytePtr((CFDataRef)descriptor), CFDataGetLength((CFDataRef)descriptor));
+        }
+        dev->reportBuffer.resize(intProperty(device, CFSTR(kIOHIDMaxInputReportSizeKey), HID_DEFAULT_MAX_REPORT));
+
+        MacHidDevice* raw = dev.get();
+        self->devices[device] = std::move(dev);
+        if (self->callbacks.deviceConnected)
+            raw->context = self->callbacks.deviceConnected(device, deviceInfo(device));
+
+        // Whole reports, once each, instead of one value callback per element
+        IOHIDDeviceRegisterInputReportWithTimeStampCallback(device, raw->reportBuffer.data(), raw->reportBuffer.size(),
+                                                            InputReport, raw);
+    }
+
+    static void DeviceRemoved(void* context, IOReturn, void*, IOHIDDeviceRef device) {
+        auto* self = static_cast<MacHidBackend*>(context);
+        auto it = self->devices.find(device);
+        if (it != self->devices.end()) {
+            IOHIDDeviceRegisterInputReportWithTimeStampCallback(device, it->second->reportBuffer.data(),
+                                                                it->second->reportBuffer.size(), nullptr, nullptr);
+        }
+        if (self->callbacks.deviceRemoved)
+            self->callbacks.deviceRemoved(device, deviceInfo(device));
+        if (it != self->devices.end())
+            self->devices.erase(it);
+    }
+
+    static void InputReport(void* context, IOReturn result, void*, IOHIDReportType type, uint32_t,
+                            uint8_t* report, CFIndex reportLength, uint64_t timeStamp) {
+        auto* dev = static_cast<MacHidDevice*>(context);
+        MacHidBackend* self = dev->backend;
+        if (result != kIOReturnSuccess || type != kIOHIDReportTypeInput || !self->callbacks.inputReport)
+            return;
+
+        // IOHID timestamps are mach_absolute_time units
+        static mach_timebase_info_data_t timebase;
+        if (timebase.denom == 0) mach_timebase_info(&timebase);
+        self->arrivalNs = timeStamp * timebase.numer / timebase.denom;
+
+        if (dev->parser.empty()) {
+            HidInputValue value = {dev->primaryUsagePage, dev->primaryUsage, report, (size_t)reportLength};
+            self->callbacks.inputReport(dev->device, dev->context, &value, 1);
+            return;
+        }
+        dev->parser.parse(report, reportLength, dev->values);
+        if (!dev->values.empty())
+            self->callbacks.inputReport(dev->device, dev->context, dev->values.data(), dev->values.size());
+    }
+
+    IOHIDManagerRef hidManager = nullptr;
+    CFRunLoopRef runLoop = nullptr;
+    Callbacks callbacks;
+    uint64_t arrivalNs = 0;     // of the report being delivered
+    std::map<IOHIDDeviceRef, std::unique_ptr<MacHidDevice>> devices;   // touched on connect/remove only
+    std::map<HidTimerId, Timer> timers;     // run loop thread only
+    HidTimerId nextTimerId = 1;
+};
+
+} // namespace
+
+std::unique_ptr<HidBackend> createHidBackend() {
+    return std::make_unique<MacHidBackend>();
+}
+
+#endif
@@ -0,0 +1,408 @@
+//
+//  HidCapture.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "HidCapture.h"
+#include "HidBackend.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+// ====== 小端编码 ======
+static void putLE(uint8_t* p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t getLE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+bool HidCaptureWriter::open(const std::string& path) {
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "❌ Can't open capture file to write: " << path << std::endl;
+        return false;
+    }
+    uint8_t header[HID_CAPTURE_HEADER_SIZE] = {0};
+    memcpy(header, HID_CAPTURE_MAGIC, 8);
+    putLE(header + 8, HID_CAPTURE_VERSION, 4);
+    file.write((const char*)header, sizeof(header));
+    return true;
+}
+
+void HidCaptureWriter::write(const HidCaptureRecord& record) {
+    uint8_t header[HID_CAPTURE_RECORD_SIZE] = {0};
+    size_t length = std::min<size_t>(record.data.size(), 0xFFFF);
+    putLE(header, record.timestampNs, 8);
+    putLE(header + 8, record.deviceId, 4);
+    header[12] = record.type;
+    putLE(header + 14, length, 2);
+    putLE(header + 16, record.usagePage, 4);
+    putLE(header + 20, record.usage, 4);
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)record.data.data(), length);
+}
+
+void HidCaptureWriter::flush() {
+    file.flush();
+}
+
+bool HidCaptureReader::open(const std::string& path) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "❌ Can't open capture file: " << path << std::endl;
+        return false;
+    }
+    uint8_t header[HID_CAPTURE_HEADER_SIZE];
+    if (!file.read((char*)header, sizeof(header)) || memcmp(header, HID_CAPTURE_MAGIC, 8) != 0) {
+        std::cerr << "❌ Not a HID capture file: " << path << std::endl;
+        return false;
+    }
+    uint32_t version = (uint32_t)getLE(header + 8, 4);
+    if (version != HID_CAPTURE_VERSION) {
+        std::cerr << "❌ Unsupported HID capture version " << version << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool HidCaptureReader::next(HidCaptureRecord& record) {
+    uint8_t header[HID_CAPTURE_RECORD_SIZE];
+    if (!file.read((char*)header, sizeof(header)))
+        return false;
+    record.timestampNs = getLE(header, 8);
+    record.deviceId = (uint32_t)getLE(header + 8, 4);
+    record.type = (HidCaptureRecordType)header[12];
+    size_t length = (size_t)getLE(header + 14, 2);
+    record.usagePage = (uint32_t)getLE(header + 16, 4);
+    record.usage = (uint32_t)getLE(header + 20, 4);
+    record.data.resize(length);
+    return length == 0 || (bool)file.read((char*)record.data.data(), length);
+}
+
+namespace {
+
+std::vector<uint8_t> deviceRecordData(const HidDeviceInfo& info, const std::string& address) {
+    std::vector<uint8_t> data(info.serialNumber.begin(), info.serialNumber.end());
+    data.push_back(0);
+    data.insert(data.end(), address.begin(), address.end());
+    return data;
+}
+
+// ====== 录制: 透传并写入 capture 文件 ======
+class RecordingHidBackend : public HidBackend {
+public:
+    RecordingHidBackend(std::unique_ptr<HidBackend> inner, const std::string& path)
+        : inner(std::move(inner)), path(path) {}
+
+    ~RecordingHidBackend() override {
+        writer.flush();
+        std::cout << "💾 Recorded " << recordCount << " HID records to " << path << std::endl;
+    }
+
+    bool open(uint16_t vendorId, const std::vector<uint16_t>& productIds, const Callbacks& cb) override {
+        if (!writer.open(path))
+            return false;
+        callbacks = cb;
+
+        Callbacks wrapped;
+        wrapped.deviceConnected = [this](HidDeviceRef device, const HidDeviceInfo& info) -> void* {
+            // Resolve the address now so replay doesn't need the Bluetooth stack
+            std::string address = inner->bluetoothAddress(device);
+            {
+                std::lock_guard<std::mutex> lock(recordMutex);
+                uint32_t id = nextDeviceId++;
+                deviceIds[device] = id;
+                addresses[device] = address;
+                record(id, HID_CAPTURE_CONNECT, info.vendorId, info.productId, deviceRecordData(info, address), inner->now());
+            }
+            return callbacks.deviceConnected ? callbacks.deviceConnected(device, info) : nullptr;
+        };
+        wrapped.deviceRemoved = [this](HidDeviceRef device, const HidDeviceInfo& info) {
+            {
+                std::lock_guard<std::mutex> lock(recordMutex);
+                record(deviceIds[device], HID_CAPTURE_REMOVE, info.vendorId, info.productId, deviceRecordData(info, addresses[device]), inner->now());
+                writer.flush();
+            }
+            if (callbacks.deviceRemoved) callbacks.deviceRemoved(device, info);
+            std::lock_guard<std::mutex> lock(recordMutex);
+            deviceIds.erase(device);
+            addresses.erase(device);
+        };
+        wrapped.inputReport = [this](HidDeviceRef device, void* context, const HidInputValue* values, size_t count) {
+            {
+                // One timestamp for all values of a report, so replay delivers them together again
+                std::lock_guard<std::mutex> lock(recordMutex);
+                uint64_t t = inner->now();
+                uint32_t id = deviceIds[device];
+                for (size_t i = 0; i < count; ++i) {
+                    const HidInputValue& v = values[i];
+                    record(id, HID_CAPTURE_INPUT, v.usagePage, v.usage, std::vector<uint8_t>(v.data, v.data + v.length), t);
+                }
+            }
+            if (callbacks.inputReport) callbacks.inputReport(device, context, values, count);
+        };
+
+        std::cout << "⏺️ Recording HID input to " << path << std::endl;
+        return inner->open(vendorId, productIds, wrapped);
+    }
+
+    void run() override { inner->run(); }
+    void stop() override { inner->stop(); }
+
+    bool sendOutputReport(HidDeviceRef device, const uint8_t* report, size_t length) override {
+        return inner->sendOutputReport(device, report, length);
+    }
+
+    std::string bluetoothAddress(HidDeviceRef device) override {
+        {
+            std::lock_guard<std::mutex> lock(recordMutex);
+            auto it = addresses.find(device);
+            if (it != addresses.end())
+                return it->second;
+        }
+        return inner->bluetoothAddress(device);
+    }
+
+    uint64_t now() override { return inner->now(); }
+    uint64_t reportArrivalNs() override { return inner->reportArrivalNs(); }
+
+    // Timer firings aren't recorded: replay schedules the same timers again
+    // from the recorded input and fires them on the capture clock
+    HidTimerId scheduleTimer(uint64_t deadlineNs, std::function<void()> fire) override {
+        return inner->scheduleTimer(deadlineNs, std::move(fire));
+    }
+    void cancelTimer(HidTimerId timer) override { inner->cancelTimer(timer); }
+
+private:
+    // With recordMutex held: devices may deliver concurrently (Linux)
+    void record(uint32_t deviceId, HidCaptureRecordType type, uint32_t usagePage, uint32_t usage, std::vector<uint8_t> data, uint64_t t) {
+        if (recordCount == 0) startNs = t;
+
+        HidCaptureRecord r;
+        r.timestampNs = t - startNs;
+        r.deviceId = deviceId;
+        r.type = type;
+        r.usagePage = usagePage;
+        r.usage = usage;
+        r.data = std::move(data);
+        writer.write(r);
+        recordCount++;
+    }
+
+    std::unique_ptr<HidBackend> inner;
+    std::string path;
+    HidCaptureWriter writer;
+    Callbacks callbacks;
+    std::mutex recordMutex;         // the writer and the maps below
+    std::map<HidDeviceRef, uint32_t> deviceIds;
+    std::map<HidDeviceRef, std::string> addresses;
+    uint32_t nextDeviceId = 0;
+    uint64_t recordCount = 0;
+    uint64_t startNs = 0;
+};
+
+// ====== 回放: 按录制时间 (或加速/最快) 重新投递 ======
+class ReplayHidBackend : public HidBackend {
+public:
+    ReplayHidBackend(const std::string& path, double speed) : path(path), speed(speed) {}
+
+    bool open(uint16_t, const std::vector<uint16_t>&, const Callbacks& cb) override {
+        callbacks = cb;
+        if (!reader.open(path))
+            return false;
+        running = true;
+        return true;
+    }
+
+    void run() override {
+        using clock = std::chrono::steady_clock;
+        HidCaptureRecord record;
+        uint64_t records = 0, inputs = 0, inputBytes = 0, lastNs = 0;
+        auto start = clock::now();
+
+        while (running && reader.next(record)) {
+            // Input values recorded together came from one report; deliver them as one
+            if (record.type == HID_CAPTURE_INPUT && !pending.empty() &&
+                record.deviceId == pending[0].deviceId && record.timestampNs == pending[0].timestampNs) {
+                records++;
+                inputs++;
+                inputBytes += record.data.size();
+                pending.push_back(std::move(record));
+                continue;
+            }
+            deliverPending();
+            fireTimers(record.timestampNs, start);
+            if (!waitUntil(record.timestampNs, start)) break;
+            captureNs = record.timestampNs;
+            lastNs = record.timestampNs;
+            records++;
+
+            switch (record.type) {
+                case HID_CAPTURE_CONNECT: {
+                    auto& dev = devices[record.deviceId];
+                    dev = std::make_unique<ReplayDevice>();
+                    dev->info.vendorId = (uint16_t)record.usagePage;
+                    dev->info.productId = (uint16_t)record.usage;
+                    splitDeviceRecordData(record.data, dev->info.serialNumber, dev->address);
+                    if (callbacks.deviceConnected) dev->context = callbacks.deviceConnected(dev.get(), dev->info);
+                    break;
+                }
+                case HID_CAPTURE_REMOVE: {
+                    auto it = devices.find(record.deviceId);
+                    if (it == devices.end()) break;
+                    if (callbacks.deviceRemoved) callbacks.deviceRemoved(it->second.get(), it->second->info);
+                    devices.erase(it);
+                    break;
+                }
+                case HID_CAPTURE_INPUT: {
+                    if (devices.find(record.deviceId) == devices.end()) break;
+                    inputs++;
+                    inputBytes += record.data.size();
+                    pending.push_back(std::move(record));
+                    break;
+                }
+            }
+        }
+        if (running)
+            deliverPending();
+
+        double wall = std::chrono::duration<double>(clock::now() - start).count();
+        double captured = lastNs / 1e9;
+        std::cout << "📊 Replayed " << records << " records (" << inputs << " input values, "
+                  << inputBytes << " bytes) covering " << std::fixed << std::setprecision(3) << captured
+                  << " s in " << wall << " s" << std::endl;
+        if (wall > 0) {
+            std::cout << "📊 Throughput: " << std::setprecision(0) << inputs / wall << " values/s, "
+                      << std::setprecision(2) << inputBytes / wall / 1e6 << " MB/s, "
+                      << captured / wall << "x real time" << std::endl;
+        }
+        std::cout << std::defaultfloat;
+    }
+
+    void stop() override {
+        {
+            std::lock_guard<std::mutex> lock(stopMutex);
+            running = false;
+        }
+        stopped.notify_all();
+    }
+
+    bool sendOutputReport(HidDeviceRef, const uint8_t*, size_t) override {
+        return true;    // the device's answer is already in the capture
+    }
+
+    std::string bluetoothAddress(HidDeviceRef device) override {
+        return ((const ReplayDevice*)device)->address;
+    }
+
+    // Capture time, so button timing replays identically at any speed
+    uint64_t now() override { return captureNs; }
+
+    // Timers run on the capture clock too, in order with the input around them
+    HidTimerId scheduleTimer(uint64_t deadlineNs, std::function<void()> fire) override {
+        HidTimerId id = nextTimerId++;
+        timers[id] = {deadlineNs, std::move(fire)};
+        return id;
+    }
+    void cancelTimer(HidTimerId timer) override { timers.erase(timer); }
+
+private:
+    struct Timer {
+        uint64_t deadlineNs;
+        std::function<void()> fire;
+    };
+
+    // Paces replay to capture time t. Returns false if stopped meanwhile.
+    bool waitUntil(uint64_t t, std::chrono::steady_clock::time_point start) {
+        if (speed <= 0)
+            return running;
+        auto due = start + std::chrono::nanoseconds((uint64_t)(t / speed));
+        std::unique_lock<std::mutex> lock(stopMutex);
+        stopped.wait_until(lock, due, [this] { return !running; });
+        return running;
+    }
+
+    // Fires, earliest first, every timer due by capture time t, including
+    // ones scheduled by the timers themselves
+    void fireTimers(uint64_t t, std::chrono::steady_clock::time_point start) {
+        while (running) {
+            auto due = timers.end();
+            for (auto it = timers.begin(); it != timers.end(); ++it) {
+                if (it->second.deadlineNs <= t && (due == timers.end() || it->second.deadlineNs < due->second.deadlineNs))
+                    due = it;
+            }
+            if (due == timers.end() || !waitUntil(due->second.deadlineNs, start))
+                return;
+            captureNs = std::max<uint64_t>(captureNs, due->second.deadlineNs);
+            std::function<void()> fire = std::move(due->second.fire);
+            timers.erase(due);
+            fire();
+        }
+    }
+
+    struct ReplayDevice {
+        HidDeviceInfo info;
+        std::string address;
+        void* context = nullptr;
+    };
+
+    void deliverPending() {
+        if (pending.empty())
+            return;
+        auto it = devices.find(pending[0].deviceId);
+        if (it != devices.end() && callbacks.inputReport) {
+            values.clear();
+            for (auto& r : pending) {
+                values.push_back({r.usagePage, r.usage, r.data.data(), r.data.size()});
+            }
+            callbacks.inputReport(it->second.get(), it->second->context, values.data(), values.size());
+        }
+        pending.clear();
+    }
+
+    static void splitDeviceRecordData(const std::vector<uint8_t>& data, std::string& serial, std::string& address) {
+        auto sep = std::find(data.begin(), data.end(), 0);
+        serial.assign(data.begin(), sep);
+        address.assign(sep == data.end() ? sep : sep + 1, data.end());
+    }
+
+    std::string path;
+    double speed;
+    HidCaptureReader reader;
+    Callbacks callbacks;
+    std::map<uint32_t, std::unique_ptr<ReplayDevice>> devices;
+    std::vector<HidCaptureRecord> pending;      // input values of the report being gathered
+    std::vector<HidInputValue> values;
+    std::map<HidTimerId, Timer> timers;         // only touched by run() and the callbacks it makes
+    HidTimerId nextTimerId = 1;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> captureNs{0};
+    std::mutex stopMutex;
+    std::condition_variable stopped;
+};
+
+} // namespace
+
+std::unique_ptr<HidBackend> createRecordingHidBackend(std::unique_ptr<HidBackend> backend, const std::string& path) {
+    return std::make_unique<RecordingHidBackend>(std::move(backend), path);
+}
+
+std::unique_ptr<HidBackend> createReplayHidBackend(const std::string& path, double speed) {
+    return std::make_unique<ReplayHidBackend>(path, speed);
+}
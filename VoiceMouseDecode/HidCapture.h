@@ -0,0 +1,65 @@
+//
+//  HidCapture.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * HID capture file: everything a HidBackend delivered, in order, so a
+ * session can be replayed without the mouse. All integers little endian.
+ *
+ *   header:  "VMHIDCAP" | uint32 version | uint32 reserved
+ *   record:  uint64 timestampNs | uint32 deviceId | uint8 type | uint8 reserved |
+ *            uint16 length | uint32 usagePage | uint32 usage | bytes[length]
+ *
+ * timestampNs counts from the first record. deviceId numbers devices in
+ * the order they connected. For CONNECT/REMOVE records usagePage/usage hold
+ * the vendor/product ID and bytes are "serial\0bluetoothAddress".
+ */
+
+#define HID_CAPTURE_MAGIC       "VMHIDCAP"
+#define HID_CAPTURE_VERSION     1
+#define HID_CAPTURE_HEADER_SIZE 16
+#define HID_CAPTURE_RECORD_SIZE 24
+
+enum HidCaptureRecordType : uint8_t {
+    HID_CAPTURE_CONNECT = 0,
+    HID_CAPTURE_REMOVE = 1,
+    HID_CAPTURE_INPUT = 2,
+};
+
+struct HidCaptureRecord {
+    uint64_t timestampNs = 0;
+    uint32_t deviceId = 0;
+    HidCaptureRecordType type = HID_CAPTURE_INPUT;
+    uint32_t usagePage = 0;
+    uint32_t usage = 0;
+    std::vector<uint8_t> data;
+};
+
+class HidCaptureWriter {
+public:
+    bool open(const std::string& path);
+    void write(const HidCaptureRecord& record);
+    void flush();
+
+private:
+    std::ofstream file;
+};
+
+class HidCaptureReader {
+public:
+    bool open(const std::string& path);
+    // Returns false at the end of the file or on a truncated record
+    bool next(HidCaptureRecord& record);
+
+private:
+    std::ifstream file;
+};
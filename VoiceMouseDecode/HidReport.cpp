@@ -0,0 +1,214 @@
+//
+//  HidReport.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "HidReport.h"
+#include <algorithm>
+#include <cstring>
+
+/*
+ * Enough of a HID report descriptor parser to split input reports into the
+ * elements IOKit hands to the value callback: one per usage of a variable
+ * item (the last usage takes the remaining count, so vendor byte buffers
+ * stay one element), one per array item, constant items are padding.
+ */
+std::vector<HidReportField> parseHidReportDescriptor(const uint8_t* desc, size_t length, bool* usesReportIds) {
+    struct Globals {
+        uint32_t usagePage = 0;
+        uint32_t reportSize = 0;
+        uint32_t reportCount = 0;
+        uint8_t reportId = 0;
+    };
+    Globals globals;
+    std::vector<Globals> globalStack;
+    std::vector<uint32_t> usages;           // 32-bit usages carry their page in the upper half
+    uint32_t usageMin = 0, usageMax = 0;
+    bool haveRange = false;
+    uint32_t bitOffsets[256] = {0};
+    std::vector<HidReportField> fields;
+    *usesReportIds = false;
+
+    auto fullUsage = [&](uint32_t value, size_t size) {
+        return size == 4 ? value : (globals.usagePage << 16) | value;
+    };
+
+    size_t i = 0;
+    while (i < length) {
+        uint8_t prefix = desc[i++];
+        if (prefix == 0xFE) {               // long item, never used by these devices
+            if (i + 1 >= length) break;
+            i += 2 + desc[i];
+            continue;
+        }
+        size_t size = prefix & 0x3;
+        if (size == 3) size = 4;
+        if (i + size > length) break;
+        uint32_t value = 0;
+        for (size_t k = 0; k < size; ++k) {
+            value |= (uint32_t)desc[i + k] << (8 * k);
+        }
+        i += size;
+
+        uint8_t type = (prefix >> 2) & 0x3;
+        uint8_t tag = prefix >> 4;
+
+        if (type == 0) {                    // Main
+            if (tag == 0x8) {               // Input
+                uint32_t& offset = bitOffsets[globals.reportId];
+                uint32_t count = globals.reportCount;
+                bool constant = value & 0x01;
+                bool variable = value & 0x02;
+                bool bufferedBytes = value & 0x100;
+
+                if (haveRange) {
+                    for (uint32_t u = usageMin; u <= usageMax && usages.size() < count; ++u) {
+                        usages.push_back(u);
+                    }
+                }
+
+                if (constant) {
+                    // padding
+                } else if (!variable) {
+                    uint32_t page = usages.empty() ? globals.usagePage : usages[0] >> 16;
+                    fields.push_back({globals.reportId, page, HID_USAGE_ARRAY, offset, globals.reportSize * count});
+                } else if (usages.empty() || bufferedBytes) {
+                    uint32_t u = usages.empty() ? (globals.usagePage << 16) : usages[0];
+                    fields.push_back({globals.reportId, u >> 16, u & 0xFFFF, offset, globals.reportSize * count});
+                } else {
+                    uint32_t pos = offset;
+                    for (uint32_t j = 0; j < count; ++j) {
+                        uint32_t u = usages[j < usages.size() ? j : usages.size() - 1];
+                        uint32_t n = (j + 1 < usages.size()) ? 1 : count - j;
+                        fields.push_back({globals.reportId, u >> 16, u & 0xFFFF, pos, globals.reportSize * n});
+                        pos += globals.reportSize * n;
+                        if (n > 1) break;
+                    }
+                }
+                offset += globals.reportSize * count;
+            }
+            usages.clear();                 // every main item ends the local state
+            haveRange = false;
+        } else if (type == 1) {             // Global
+            switch (tag) {
+                case 0x0: globals.usagePage = value; break;
+                case 0x7: globals.reportSize = value; break;
+                case 0x8: globals.reportId = (uint8_t)value; *usesReportIds = true; break;
+                case 0x9: globals.reportCount = value; break;
+                case 0xA: globalStack.push_back(globals); break;
+                case 0xB:
+                    if (!globalStack.empty()) {
+                        globals = globalStack.back();
+                        globalStack.pop_back();
+                    }
+                    break;
+            }
+        } else if (type == 2) {             // Local
+            switch (tag) {
+                case 0x0: usages.push_back(fullUsage(value, size)); break;
+                case 0x1: usageMin = fullUsage(value, size); haveRange = true; break;
+                case 0x2: usageMax = fullUsage(value, size); haveRange = true; break;
+            }
+        }
+    }
+    return fields;
+}
+
+std::vector<uint8_t> parseHidOutputReportIds(const uint8_t* desc, size_t length) {
+    std::vector<uint8_t> ids;
+    std::vector<uint8_t> idStack;
+    uint8_t reportId = 0;
+    size_t i = 0;
+    while (i < length) {
+        uint8_t prefix = desc[i++];
+        if (prefix == 0xFE) {
+            if (i + 1 >= length) break;
+            i += 2 + desc[i];
+            continue;
+        }
+        size_t size = prefix & 0x3;
+        if (size == 3) size = 4;
+        if (i + size > length) break;
+        uint8_t value = size ? desc[i] : 0;
+        i += size;
+
+        uint8_t type = (prefix >> 2) & 0x3;
+        uint8_t tag = prefix >> 4;
+        if (type == 0 && tag == 0x9) {          // Output
+            if (std::find(ids.begin(), ids.end(), reportId) == ids.end())
+                ids.push_back(reportId);
+        } else if (type == 1 && tag == 0x8) {   // Report ID
+            reportId = value;
+        } else if (type == 1 && tag == 0xA) {   // Push
+            idStack.push_back(reportId);
+        } else if (type == 1 && tag == 0xB && !idStack.empty()) {
+            reportId = idStack.back();
+            idStack.pop_back();
+        }
+    }
+    return ids;
+}
+
+// Copies bitSize bits starting at bitOffset into out, LSB first
+static void extractBits(const uint8_t* report, uint32_t bitOffset, uint32_t bitSize, uint8_t* out) {
+    size_t bytes = (bitSize + 7) / 8;
+    if (bitOffset % 8 == 0) {
+        memcpy(out, report + bitOffset / 8, bytes);
+    } else {
+        memset(out, 0, bytes);
+        for (uint32_t b = 0; b < bitSize; ++b) {
+            uint32_t src = bitOffset + b;
+            if (report[src / 8] & (1u << (src % 8)))
+                out[b / 8] |= 1u << (b % 8);
+        }
+    }
+    if (bitSize % 8)
+        out[bytes - 1] &= (1u << (bitSize % 8)) - 1;
+}
+
+bool HidReportParser::setDescriptor(const uint8_t* descriptor, size_t length) {
+    fields = parseHidReportDescriptor(descriptor, length, &usesReportIds);
+    current.clear();
+    for (auto& field : fields) {
+        current.emplace_back((field.bitSize + 7) / 8, 0);
+    }
+    return !fields.empty();
+}
+
+void HidReportParser::parse(const uint8_t* report, size_t length, std::vector<HidInputValue>& values) {
+    values.clear();
+    uint8_t reportId = 0;
+    if (usesReportIds) {
+        if (length == 0) return;
+        reportId = report[0];
+        report++;
+        length--;
+    }
+
+    uint8_t value[4];
+    for (size_t f = 0; f < fields.size(); ++f) {
+        const HidReportField& field = fields[f];
+        if (field.reportId != reportId) continue;
+        if ((field.bitOffset + field.bitSize + 7) / 8 > length) continue;
+
+        size_t bytes = (field.bitSize + 7) / 8;
+        std::vector<uint8_t>& last = current[f];
+
+        // IOKit only reports an element when its value changes; byte
+        // buffers (audio) are reported on every report
+        if (bytes <= 4) {
+            extractBits(report, field.bitOffset, field.bitSize, value);
+            if (memcmp(last.data(), value, bytes) == 0) continue;
+            memcpy(last.data(), value, bytes);
+            values.push_back({field.usagePage, field.usage, last.data(), bytes});
+        } else if (field.bitOffset % 8 == 0 && field.bitSize % 8 == 0) {
+            // whole bytes: hand out the report itself, no copy
+            values.push_back({field.usagePage, field.usage, report + field.bitOffset / 8, bytes});
+        } else {
+            extractBits(report, field.bitOffset, field.bitSize, last.data());
+            values.push_back({field.usagePage, field.usage, last.data(), bytes});
+        }
+    }
+}
@@ -0,0 +1,60 @@
+//
+//  HidReport.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define HID_USAGE_ARRAY 0xFFFFFFFF  // what IOKit reports as usage of an array element
+
+// One element value of an input report, as IOHIDValue would describe it
+struct HidInputValue {
+    uint32_t usagePage;
+    uint32_t usage;
+    const uint8_t* data;
+    size_t length;
+};
+
+// One input element of a report descriptor
+struct HidReportField {
+    uint8_t reportId;
+    uint32_t usagePage;
+    uint32_t usage;
+    uint32_t bitOffset;     // from the first byte after the report ID
+    uint32_t bitSize;
+};
+
+/*
+ * Splits whole input reports into the element values IOKit's value callback
+ * would deliver, using the device's report descriptor. Shared by the
+ * backends that read whole reports (IOHIDDeviceRegisterInputReportCallback,
+ * hid_read), so each report is walked once and handed on as one batch.
+ */
+class HidReportParser {
+public:
+    // Returns false if the descriptor has no input fields
+    bool setDescriptor(const uint8_t* descriptor, size_t length);
+    bool empty() const { return fields.empty(); }
+
+    // Replaces values with the elements of report (report ID first if the
+    // device uses report IDs) that changed since the last report; byte
+    // buffers such as audio are always included. values[i].data stays valid
+    // until the next parse() or until report is overwritten.
+    void parse(const uint8_t* report, size_t length, std::vector<HidInputValue>& values);
+
+private:
+    std::vector<HidReportField> fields;
+    std::vector<std::vector<uint8_t>> current;  // per field: last value, or scratch for unaligned buffers
+    bool usesReportIds = false;
+};
+
+std::vector<HidReportField> parseHidReportDescriptor(const uint8_t* descriptor, size_t length, bool* usesReportIds);
+
+// IDs of the output reports a descriptor declares (0 if it uses no report
+// IDs), to tell which interface of a device takes an output report
+std::vector<uint8_t> parseHidOutputReportIds(const uint8_t* descriptor, size_t length);
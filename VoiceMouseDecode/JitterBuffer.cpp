@@ -0,0 +1,229 @@
+//
+//  JitterBuffer.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "JitterBuffer.h"
+#include "DecoderPool.h"
+#include "LatencyStats.h"
+#include "Metrics.h"
+#include "json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using json = nlohmann::json;
+
+// Frames played without a late one before the adaptive delay may shrink (3 s)
+static const uint64_t SHRINK_AFTER_TICKS = 400;
+
+JitterBuffer::JitterBuffer(const JitterOptions& options, std::function<void()> onPush)
+    : options(options),
+      frameNs((int64_t)MSBC_FRAME_INTERVAL_NS),
+      onPush(onPush),
+      targetNs((int64_t)options.targetDelayMs * 1000000) {
+}
+
+void JitterBuffer::prime(const Frame& frame) {
+    baseNs = (int64_t)frame.arrivalNs + targetNs - (int64_t)frame.seq * frameNs;
+    lastTransitNs = 0;
+    played = false;
+    primed = true;
+}
+
+void JitterBuffer::push(Frame&& frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t now = latencyClockNs();
+        int64_t maxNs = (int64_t)options.maxDelayMs * 1000000;
+
+        // Nothing queued and nothing pushed for longer than the max delay: the
+        // stream paused, so the next frame starts a new one
+        if (!primed || (frames.empty() && now - lastPushNs > (uint64_t)maxNs))
+            prime(frame);
+        lastPushNs = now;
+
+        int64_t slot = slotNs(frame.seq);
+
+        // Interarrival jitter: change in transit time relative to the stream clock
+        int64_t transit = (int64_t)frame.arrivalNs - (slot - targetNs);
+        jitterNs += (std::abs((double)(transit - lastTransitNs)) - jitterNs) / 16.0;
+        lastTransitNs = transit;
+
+        bool missedSlot = slot + frameNs < (int64_t)now;
+        if ((played && frame.seq <= lastPlayedSeq) || missedSlot) {
+            lateCount++;
+            metricsAdd(METRIC_QUEUE_DROPS);
+            ticksSinceLate = 0;
+            if (options.adaptive && targetNs + frameNs <= maxNs) {
+                targetNs += frameNs;
+                baseNs += frameNs;
+            }
+            return;
+        }
+
+        if (slot - (int64_t)now > maxNs) {
+            earlyCount++;
+            if ((int64_t)frames.size() * frameNs > maxNs) {
+                droppedCount++;
+                metricsAdd(METRIC_QUEUE_DROPS);
+                return;
+            }
+        }
+
+        // Keep the queue in sequence order; reports are rarely reordered,
+        // so this is almost always an append
+        auto pos = frames.end();
+        while (pos != frames.begin() && std::prev(pos)->seq > frame.seq)
+            --pos;
+        if (pos != frames.begin() && std::prev(pos)->seq == frame.seq) {
+            droppedCount++;
+            metricsAdd(METRIC_QUEUE_DROPS);
+            return;
+        }
+        frames.insert(pos, std::move(frame));
+    }
+    if (onPush)
+        onPush();
+}
+
+bool JitterBuffer::pop(uint64_t nowNs, Frame* frame, uint64_t* nextDueNs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    *nextDueNs = 0;
+    if (frames.empty())
+        return false;
+
+    int64_t slot = slotNs(frames.front().seq);
+    if (slot > (int64_t)nowNs) {
+        *nextDueNs = (uint64_t)slot;
+        return false;
+    }
+
+    *frame = std::move(frames.front());
+    frames.pop_front();
+    played = true;
+    lastPlayedSeq = frame->seq;
+    playedCount++;
+
+    // Jitter settled well below the current delay for a while: give one
+    // frame of delay back by pulling the stream clock in
+    if (options.adaptive && ++ticksSinceLate >= SHRINK_AFTER_TICKS) {
+        ticksSinceLate = 0;
+        int64_t floorNs = (int64_t)options.targetDelayMs * 1000000;
+        if (targetNs - frameNs >= floorNs && 4 * jitterNs + frameNs < targetNs) {
+            targetNs -= frameNs;
+            baseNs -= frameNs;
+        }
+    }
+
+    if (!frames.empty())
+        *nextDueNs = (uint64_t)slotNs(frames.front().seq);
+    return true;
+}
+
+void JitterBuffer::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    frames.clear();
+    primed = false;
+    played = false;
+}
+
+void JitterBuffer::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    frames.clear();
+    closed = true;
+}
+
+std::string JitterBuffer::statsJson() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto ms = [](double ns) { return std::round(ns / 100000.0) / 10.0; };
+    json j = {
+        {"targetDelayMs", ms((double)targetNs)},
+        {"jitterMs", ms(jitterNs)},
+        {"depth", frames.size()},
+        {"played", playedCount},
+        {"late", lateCount},
+        {"early", earlyCount},
+        {"dropped", droppedCount},
+    };
+    return j.dump();
+}
+
+JitterPlayout::JitterPlayout(const JitterOptions& options, SendFunction send)
+    : options(options), send(send) {
+}
+
+JitterPlayout::~JitterPlayout() {
+    stop();
+}
+
+void JitterPlayout::start() {
+    if (running)
+        return;
+    running = true;
+    thread = std::thread(&JitterPlayout::run, this);
+    std::cout << "⏱️ Jitter buffer on: target " << options.targetDelayMs << " ms, max " << options.maxDelayMs
+              << " ms" << (options.adaptive ? ", adaptive" : "") << std::endl;
+}
+
+void JitterPlayout::stop() {
+    if (!running)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    cv.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+
+std::shared_ptr<JitterBuffer> JitterPlayout::createBuffer() {
+    auto buffer = std::make_shared<JitterBuffer>(options, [this]() { wake(); });
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers.push_back(buffer);
+    return buffer;
+}
+
+void JitterPlayout::wake() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        woken = true;
+    }
+    cv.notify_one();
+}
+
+void JitterPlayout::run() {
+    std::vector<std::shared_ptr<JitterBuffer>> active;
+    JitterBuffer::Frame frame;
+    while (running) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.erase(std::remove_if(buffers.begin(), buffers.end(),
+                                         [](const std::shared_ptr<JitterBuffer>& b) { return b->isClosed(); }),
+                          buffers.end());
+            active = buffers;
+        }
+
+        uint64_t now = latencyClockNs();
+        uint64_t next = now + MSBC_FRAME_INTERVAL_NS;
+        for (auto& buffer : active) {
+            uint64_t due = 0;
+            while (buffer->pop(now, &frame, &due)) {
+                send(frame);
+            }
+            if (due != 0 && due < next)
+                next = due;
+        }
+
+        uint64_t after = latencyClockNs();
+        std::unique_lock<std::mutex> lock(mutex);
+        if (next > after) {
+            cv.wait_for(lock, std::chrono::nanoseconds(next - after), [this]() { return woken || !running; });
+        }
+        woken = false;
+    }
+}
@@ -0,0 +1,118 @@
+//
+//  JitterBuffer.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct JitterOptions {
+    int targetDelayMs = 30;     // initial delay, and the floor when adaptive
+    int maxDelayMs = 120;
+    bool adaptive = true;       // grow on late frames, shrink back when jitter drops
+};
+
+/*
+ * Per-device playout buffer. Bluetooth delivers HID reports in bursts; this
+ * holds decoded frames and releases them on a steady 7.5 ms clock, each at
+ *
+ *     slot(seq) = base + seq * 7.5 ms
+ *
+ * where base is set from the first frame of a stream (arrival + target
+ * delay). A frame whose slot has passed by more than one interval is late
+ * and dropped; one arriving more than the max delay ahead of its slot is
+ * early. After a quiet spell (silence suppression, end of an utterance) the
+ * next frame starts a new stream. All times are latencyClockNs().
+ */
+class JitterBuffer {
+public:
+    struct Frame {
+        std::string deviceId;       // of the stream seq numbers
+        uint64_t seq = 0;           // stream sequence number
+        bool concealed = false;
+        uint64_t arrivalNs = 0;
+        std::vector<std::pair<int, std::vector<uint8_t>>> audio;   // sample rate -> PCM
+    };
+
+    // onPush is called after each push, outside the buffer lock
+    JitterBuffer(const JitterOptions& options, std::function<void()> onPush = nullptr);
+
+    // Input thread
+    void push(Frame&& frame);
+    void reset();                   // new session: forget the stream clock
+    void close();                   // device went away; playout drops the buffer
+
+    // Playout thread: pops the frame due at nowNs, false if none is due.
+    // *nextDueNs gets the slot of the next queued frame, 0 if empty.
+    bool pop(uint64_t nowNs, Frame* frame, uint64_t* nextDueNs);
+    bool isClosed() const { return closed; }
+
+    // {"targetDelayMs":..,"jitterMs":..,"depth":..,"played":..,"late":..,"early":..,"dropped":..}
+    std::string statsJson();
+
+private:
+    int64_t slotNs(uint64_t seq) const { return baseNs + (int64_t)seq * frameNs; }
+    void prime(const Frame& frame);
+
+    const JitterOptions options;
+    const int64_t frameNs;
+    std::function<void()> onPush;
+    std::mutex mutex;
+    std::deque<Frame> frames;
+    std::atomic<bool> closed{false};
+
+    bool primed = false;
+    int64_t baseNs = 0;
+    int64_t targetNs;
+    uint64_t lastPushNs = 0;
+    bool played = false;
+    uint64_t lastPlayedSeq = 0;
+    double jitterNs = 0;            // RFC 3550-style interarrival jitter
+    int64_t lastTransitNs = 0;
+    uint64_t ticksSinceLate = 0;
+
+    uint64_t playedCount = 0;
+    uint64_t lateCount = 0;
+    uint64_t earlyCount = 0;
+    uint64_t droppedCount = 0;
+};
+
+// One thread playing out every device's jitter buffer
+class JitterPlayout {
+public:
+    using SendFunction = std::function<void(const JitterBuffer::Frame&)>;
+
+    JitterPlayout(const JitterOptions& options, SendFunction send);
+    ~JitterPlayout();
+
+    void start();
+    void stop();
+    // New buffer for a device, played out until it is closed
+    std::shared_ptr<JitterBuffer> createBuffer();
+
+    const JitterOptions options;
+
+private:
+    void run();
+    void wake();
+
+    SendFunction send;
+    std::vector<std::shared_ptr<JitterBuffer>> buffers;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool woken = false;
+    std::atomic<bool> running{false};
+    std::thread thread;
+};
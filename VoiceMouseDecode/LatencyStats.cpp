@@ -0,0 +1,106 @@
+//
+//  LatencyStats.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "LatencyStats.h"
+#include "json.hpp"
+#include <cmath>
+
+using json = nlohmann::json;
+
+static const int SUB_BUCKETS = 1 << LatencyHistogram::SUB_BUCKET_BITS;
+static const int MAX_MSB = 40;     // ~36 minutes; longer durations land in the last bucket
+
+int LatencyHistogram::bucketIndex(uint64_t ns) {
+    if (ns < 2 * SUB_BUCKETS)
+        return (int)ns;
+    int msb = 63 - __builtin_clzll(ns);
+    if (msb > MAX_MSB) {
+        msb = MAX_MSB;
+        ns = (2ull << MAX_MSB) - 1;
+    }
+    int shift = msb - SUB_BUCKET_BITS;
+    int sub = (int)(ns >> shift) - SUB_BUCKETS;
+    return 2 * SUB_BUCKETS + (msb - SUB_BUCKET_BITS - 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketValue(int index) {
+    if (index < 2 * SUB_BUCKETS)
+        return index;
+    int octave = (index - 2 * SUB_BUCKETS) / SUB_BUCKETS;
+    int sub = (index - 2 * SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+    int shift = octave + 1;
+    return ((uint64_t)sub << shift) + (1ull << shift) / 2;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    counts[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t prev = maxNs.load(std::memory_order_relaxed);
+    while (ns > prev && !maxNs.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::count() const {
+    uint64_t total = 0;
+    for (const auto& c : counts) {
+        total += c.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    uint64_t total = count();
+    if (total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)std::ceil(p * total);
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(bucketValue(i), max());
+    }
+    return max();
+}
+
+void DeviceLatency::record(const FrameTiming& timing) {
+    for (int s = 0; s < LATENCY_STAGE_COUNT; ++s) {
+        stages[s].record(timing.stageNs[s]);
+    }
+}
+
+const char* latencyStageName(LatencyStage stage) {
+    switch (stage) {
+        case LATENCY_QUEUE: return "queue";
+        case LATENCY_DECODE: return "decode";
+        case LATENCY_DENOISE: return "denoise";
+        case LATENCY_ENCODE: return "encode";
+        case LATENCY_SEND: return "send";
+        case LATENCY_TOTAL: return "total";
+        default: return "unknown";
+    }
+}
+
+std::string DeviceLatency::toJson() const {
+    auto us = [](uint64_t ns) { return std::round(ns / 100.0) / 10.0; };
+
+    json stageJson = json::object();
+    for (int s = 0; s < LATENCY_STAGE_COUNT; ++s) {
+        const LatencyHistogram& h = stages[s];
+        stageJson[latencyStageName((LatencyStage)s)] = {
+            {"p50Us", us(h.percentile(0.50))},
+            {"p99Us", us(h.percentile(0.99))},
+            {"p999Us", us(h.percentile(0.999))},
+            {"maxUs", us(h.max())},
+        };
+    }
+    json j = {
+        {"frames", stages[LATENCY_TOTAL].count()},
+        {"stages", stageJson},
+    };
+    return j.dump();
+}
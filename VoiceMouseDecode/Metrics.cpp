@@ -0,0 +1,40 @@
+//
+//  Metrics.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "Metrics.h"
+
+MetricShard metricShards[METRIC_SHARDS];
+
+int metricShardIndex() {
+    static std::atomic<int> nextShard{0};
+    return nextShard.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+}
+
+uint64_t metricsTotal(MetricCounter counter) {
+    uint64_t total = 0;
+    for (auto& shard : metricShards) {
+        total += shard.values[counter].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+const char* metricName(MetricCounter counter) {
+    switch (counter) {
+        case METRIC_FRAMES_DECODED: return "framesDecoded";
+        case METRIC_FRAMES_PASSED_THROUGH: return "framesPassedThrough";
+        case METRIC_CRC_FAILURES: return "crcFailures";
+        case METRIC_SYNC_ERRORS: return "syncErrors";
+        case METRIC_DECODE_ERRORS: return "decodeErrors";
+        case METRIC_FRAMES_LOST: return "framesLost";
+        case METRIC_DUPLICATE_FRAMES: return "duplicateFrames";
+        case METRIC_CONCEALED_FRAMES: return "concealedFrames";
+        case METRIC_BYTES_SENT: return "bytesSent";
+        case METRIC_SEND_ERRORS: return "sendErrors";
+        case METRIC_QUEUE_DROPS: return "queueDrops";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,47 @@
+//
+//  Metrics.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+enum MetricCounter {
+    METRIC_FRAMES_DECODED,
+    METRIC_FRAMES_PASSED_THROUGH,   // sent as raw mSBC only, not decoded
+    METRIC_CRC_FAILURES,        // sbc_decode -3
+    METRIC_SYNC_ERRORS,         // sbc_decode -2
+    METRIC_DECODE_ERRORS,       // any other sbc_decode failure
+    METRIC_FRAMES_LOST,         // gaps in the H2 sequence
+    METRIC_DUPLICATE_FRAMES,
+    METRIC_CONCEALED_FRAMES,
+    METRIC_BYTES_SENT,
+    METRIC_SEND_ERRORS,
+    METRIC_QUEUE_DROPS,
+    METRIC_COUNTER_COUNT
+};
+
+#define METRIC_SHARDS 16
+
+/*
+ * Process-wide counters, sharded per thread: each thread increments its
+ * own cache line with a relaxed add, and readers sum the shards. Threads
+ * beyond METRIC_SHARDS share shards, which stays correct, only slower.
+ */
+struct alignas(64) MetricShard {
+    std::atomic<uint64_t> values[METRIC_COUNTER_COUNT];
+};
+
+extern MetricShard metricShards[METRIC_SHARDS];
+int metricShardIndex();
+
+inline void metricsAdd(MetricCounter counter, uint64_t n = 1) {
+    thread_local int shard = metricShardIndex();
+    metricShards[shard].values[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t metricsTotal(MetricCounter counter);
+const char* metricName(MetricCounter counter);
@@ -9,16 +9,24 @@
 #include <unistd.h>
 #include <string.h>
 #include <iostream>
+#include <sstream>
 #include "json.hpp"
 #include "base64.h"
+#include "Metrics.h"
 #include <sqlite3.h>
 #include <cstdlib>
+#include <algorithm>
+#include <sys/socket.h>
+#ifdef __APPLE__
 #include <ApplicationServices/ApplicationServices.h>
+#else
+#include <unistd.h>
+#endif
 
 
 using json = nlohmann::json;
 
-PCMServer::PCMServer(int port) : server_fd(-1), client_fd(-1), port(port), running(false) {}
+PCMServer::PCMServer(int port) : server_fd(-1), port(port), running(false) {}
 
 PCMServer::~PCMServer() {
     stop();
@@ -32,8 +40,15 @@ bool PCMServer::start() {
 
 void PCMServer::stop() {
     running = false;
-    if (server_fd != -1) close(server_fd);
-    if (client_fd != -1) close(client_fd);
+    if (server_fd != -1) {
+        shutdown(server_fd, SHUT_RDWR);   // wake up accept()
+        close(server_fd);
+        server_fd = -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (auto &client : clients) shutdown(client.fd, SHUT_RDWR);
+    }
     if (serverThread.joinable()) serverThread.join();
 }
 
@@ -49,6 +64,17 @@ void PCMServer::clientThread(int clientFd) {
     }
 
     // 客户端断开处理
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (auto it = clients.begin(); it != clients.end(); ++it) {
+            if (it->fd == clientFd) {
+                clients.erase(it);
+                break;
+            }
+        }
+        updateClientCounts();
+    }
+    std::cout << "Client disconnected\n";
     close(clientFd);
 }
 
@@ -74,154 +100,373 @@ void PCMServer::run() {
         return;
     }
 
-    if (listen(server_fd, 1) < 0) {
+    if (listen(server_fd, 8) < 0) {
         perror("listen failed");
         return;
     }
 
     std::cout << "Waiting for client to connect on port " << port << "...\n";
-    client_fd = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen);
-    if (client_fd < 0) {
-        perror("accept failed");
-        return;
+    while (running) {
+        int fd = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen);
+        if (fd < 0) {
+            if (!running) break;
+            perror("accept failed");
+            usleep(100000);
+            continue;
+        }
+#ifdef SO_NOSIGPIPE
+        // a client that goes away mid-send must not kill the process
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt));
+#endif
+
+        std::cout << "Client connected!\n";
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            ClientSession client;
+            client.fd = fd;
+            clients.push_back(client);
+            updateClientCounts();
+        }
+        
+        if (onClientConnected) {
+            onClientConnected();
+        }
+        
+        std::thread(&PCMServer::clientThread, this, fd).detach();
     }
+}
 
-    std::cout << "Client connected!\n";
-    
-    if (onClientConnected) {
-        onClientConnected();
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+void PCMServer::updateClientCounts() {
+    int encoded = 0;
+    for (auto &client : clients) {
+        if (client.encoded)
+            encoded++;
     }
-    
-    std::thread(&PCMServer::clientThread, this, client_fd).detach();
+    encodedClientCount = encoded;
+    clientCount = (int)clients.size();
+}
 
-    while (running) {
-        usleep(100000); // idle loop, real data is sent from sendPCM
+void PCMServer::sendToClient(int clientFd, const std::string& payload) {
+    ssize_t sent = send(clientFd, payload.c_str(), payload.size(), MSG_NOSIGNAL);
+    if (sent < 0) {
+        perror("send failed");
+        metricsAdd(METRIC_SEND_ERRORS);
+    } else {
+        metricsAdd(METRIC_BYTES_SENT, sent);
     }
 }
 
+void PCMServer::sendToSession(ClientSession& client, const std::string& payload) {
+    if (!client.resuming) {
+        sendToClient(client.fd, payload);
+    } else if (client.backlog.size() + payload.size() <= PCM_SERVER_RESUME_BACKLOG_MAX) {
+        client.backlog += payload;
+    } else {
+        metricsAdd(METRIC_QUEUE_DROPS);
+    }
+}
+
+PCMServer::ClientSession* PCMServer::findClient(int clientFd) {
+    for (auto &client : clients) {
+        if (client.fd == clientFd)
+            return &client;
+    }
+    return nullptr;
+}
+
+void PCMServer::broadcast(const std::string& payload) {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (auto &client : clients) {
+        sendToSession(client, payload);
+    }
+}
+
+std::vector<int> PCMServer::requestedSampleRates() {
+    std::vector<int> rates;
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (auto &client : clients) {
+        if (!client.encoded && std::find(rates.begin(), rates.end(), client.sampleRate) == rates.end())
+            rates.push_back(client.sampleRate);
+    }
+    return rates;
+}
+
 void PCMServer::sendStatusMessage(const std::string &msg) {
+    uint32_t len = htonl(msg.size());
+    std::string framed(reinterpret_cast<const char*>(&len), sizeof(len));
+    framed += msg;
     std::lock_guard<std::mutex> lock(clientsMutex);
-    for (int sock : clients) {
-        uint32_t len = htonl(msg.size());
-        send(sock, &len, sizeof(len), 0);
-        send(sock, msg.c_str(), msg.size(), 0);
+    for (auto &client : clients) {
+        sendToSession(client, framed);
     }
 }
 
-void PCMServer::sendAudioPCM(uint8_t* data, size_t length) {
-    if (client_fd == -1 || data == nullptr || length == 0)
+std::string PCMServer::buildAudioMessage(const std::string& deviceId, const uint8_t* data, size_t length, int sampleRate,
+                                         uint64_t seq, bool concealed) {
+    // Base64 编码
+    std::string base64_data = base64_encode(data, length);
+
+    // 构建 JSON 对象
+    json j = {
+        {"type", "ON_VOICE_DATA"},
+        {"status", "true"},
+        {"data", {
+            {"deviceId", deviceId},
+            {"length", length},
+            {"bytes", base64_data},
+            {"bytes_len", base64_data.length()},
+            {"sampleRate", sampleRate},
+            {"seq", seq},
+            {"concealed", concealed}
+        }}
+    };
+
+    // 序列化 JSON 并加上分隔符
+    return j.dump() + "|||";
+}
+
+void PCMServer::sendAudioPCM(const std::string& deviceId, uint8_t* data, size_t length, int sampleRate,
+                             FrameTiming* timing, uint64_t seq, bool concealed) {
+    if (clientCount == 0 || data == nullptr || length == 0)
         return;
 
     try {
-        // Base64 编码
-        std::string base64_data = base64_encode(data, length);
+        uint64_t start = timing ? latencyClockNs() : 0;
+        std::string response = buildAudioMessage(deviceId, data, length, sampleRate, seq, concealed);
+        uint64_t built = timing ? latencyClockNs() : 0;
+
+        // 发送数据: encoded once, fanned out to every client at this rate
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (auto &client : clients) {
+            if (client.sampleRate == sampleRate && !client.encoded)
+                sendToSession(client, response);
+        }
+        if (timing) {
+            timing->stageNs[LATENCY_ENCODE] += built - start;
+            timing->stageNs[LATENCY_SEND] += latencyClockNs() - built;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[PCMServer::sendAudioPCM] Exception: " << e.what() << std::endl;
+    }
+}
 
-        // 构建 JSON 对象
-        json j = {
-            {"type", "ON_VOICE_DATA"},
-            {"status", "true"},
-            {"data", {
-                {"length", length},
-                {"bytes", base64_data},
-                {"bytes_len", base64_data.length()}
-            }}
-        };
+std::string PCMServer::buildEncodedAudioMessage(const std::string& deviceId, const uint8_t* frame, size_t length,
+                                                uint64_t seq, uint64_t timestampNs) {
+    json j = {
+        {"type", "ON_VOICE_MSBC"},
+        {"status", "true"},
+        {"data", {
+            {"deviceId", deviceId},
+            {"length", length},
+            {"bytes", base64_encode(frame, length)},
+            {"seq", seq},
+            {"timestampNs", timestampNs},
+        }}
+    };
+    
+    return j.dump() + "|||";
+}
 
-        // 序列化 JSON 并加上分隔符
-        std::string response = j.dump() + "|||";
+void PCMServer::sendEncodedAudio(const std::string& deviceId, const uint8_t* frame, size_t length,
+                                 uint64_t seq, uint64_t timestampNs) {
+    if (encodedClientCount == 0 || frame == nullptr || length == 0)
+        return;
 
-        // 发送数据
-        ssize_t sent = send(client_fd, response.c_str(), response.size(), 0);
-        if (sent < 0) {
-            perror("send failed");
+    try {
+        std::string response = buildEncodedAudioMessage(deviceId, frame, length, seq, timestampNs);
+        
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (auto &client : clients) {
+            if (client.encoded)
+                sendToSession(client, response);
         }
     } catch (const std::exception& e) {
-        std::cerr << "[PCMServer::sendAudioPCM] Exception: " << e.what() << std::endl;
+        std::cerr << "[PCMServer::sendEncodedAudio] Exception: " << e.what() << std::endl;
     }
 }
 
+std::string PCMServer::buildKeyboardMessage(uint16_t key, uint8_t state, uint16_t action_type)
+{
+    json j = {
+            {"type", "ON_AI_BUTTON_EVENT"},
+            {"status", "true"},
+            {"data", {
+                {"key",key},
+                {"state",state},
+                {"action_type",action_type},
+             }}
+        };
+    
+    return j.dump() + "|||";
+}
+
 void PCMServer::sendKeyboard(uint16_t key, uint8_t state, uint16_t action_type)
 {
-    if (client_fd == -1)
+    if (clientCount == 0)
         return;
     try {
-        json j = {
-                {"type", "ON_AI_BUTTON_EVENT"},
-                {"status", "true"},
-                {"data", {
-                    {"key",key},
-                    {"state",state},
-                    {"action_type",action_type},
-                 }}
-            };
-        
-        std::string response = j.dump() + "|||";
+        std::string response = buildKeyboardMessage(key, state, action_type);
         
-        ssize_t sent = send(client_fd, response.c_str(), response.size(), 0);
-        if (sent < 0) {
-            perror("send failed");
-        }
+        broadcast(response);
     } catch (const std::exception& e) {
         std::cerr << "[PCMServer::sendKeyboard] Exception: " << e.what() << std::endl;
     }
 }
 
+std::string PCMServer::buildDeviceConnectMessage(const std::string& deviceInfo, uint8_t deviceType, uint8_t deviceMode, const std::string& deviceMACAddr)
+{
+    json j = {
+        {"type", "ON_HARDWARE_CONNECT"},
+        {"status", "true"},
+        {"data", {
+            {"deviceId",deviceInfo},
+            {"deviceType",deviceType},
+            {"deviceMode",deviceMode},
+            {"deviceMacAddress", deviceMACAddr},
+        }}
+    };
+    
+    return j.dump() + "|||";
+}
+
 void PCMServer::sendDeviceConnect(std::string deviceInfo, uint8_t deviceType, uint8_t deviceMode, std::string deviceMACAddr)
 {
-    if (client_fd == -1)
+    if (clientCount == 0)
+        return;
+    try {
+        std::string response = buildDeviceConnectMessage(deviceInfo, deviceType, deviceMode, deviceMACAddr);
+        broadcast(response);
+    } catch (const std::exception& e) {
+        std::cerr << "[PCMServer::sendDeviceConnect] Exception: " << e.what() << std::endl;
+    }
+}
+
+void PCMServer::sendDeviceDisconnect(std::string deviceInfo, uint8_t deviceType, uint8_t deviceMode)
+{
+    if (clientCount == 0)
         return;
     try {
         json j = {
-            {"type", "ON_HARDWARE_CONNECT"},
+            {"type", "ON_HARDWARE_DISCONNECT"},
             {"status", "true"},
             {"data", {
                 {"deviceId",deviceInfo},
                 {"deviceType",deviceType},
                 {"deviceMode",deviceMode},
-                {"deviceMacAddress", deviceMACAddr},
             }}
         };
         
         std::string response = j.dump() + "|||";
-        ssize_t sent = send(client_fd, response.c_str(), response.size(), 0);
-        if (sent < 0) {
-            perror("send failed");
-        }
+        broadcast(response);
     } catch (const std::exception& e) {
-        std::cerr << "[PCMServer::sendDeviceConnect] Exception: " << e.what() << std::endl;
+        std::cerr << "[PCMServer::sendDeviceDisconnect] Exception: " << e.what() << std::endl;
     }
 }
 
-void PCMServer::sendDeviceDisconnect(std::string deviceInfo, uint8_t deviceType, uint8_t deviceMode)
+std::string PCMServer::buildVadEventMessage(const std::string& deviceId, bool speechStart, uint64_t sampleOffset)
 {
-    if (client_fd == -1)
+    json j = {
+        {"type", "ON_VAD_EVENT"},
+        {"status", "true"},
+        {"data", {
+            {"deviceId", deviceId},
+            {"event", speechStart ? "SPEECH_START" : "SPEECH_END"},
+            {"sampleOffset", sampleOffset},
+            {"sampleRate", 16000},
+        }}
+    };
+    
+    return j.dump() + "|||";
+}
+
+void PCMServer::sendVadEvent(const std::string& deviceId, bool speechStart, uint64_t sampleOffset)
+{
+    if (clientCount == 0)
+        return;
+    try {
+        std::string response = buildVadEventMessage(deviceId, speechStart, sampleOffset);
+        broadcast(response);
+    } catch (const std::exception& e) {
+        std::cerr << "[PCMServer::sendVadEvent] Exception: " << e.what() << std::endl;
+    }
+}
+
+void PCMServer::sendAgcTelemetry(const std::string& deviceId, const std::vector<float>& gainDb,
+                                 const AgcSessionStats& stats)
+{
+    if (clientCount == 0 || stats.blocks == 0)
         return;
     try {
         json j = {
-            {"type", "ON_HARDWARE_DISCONNECT"},
+            {"type", "ON_AGC_TELEMETRY"},
             {"status", "true"},
             {"data", {
-                {"deviceId",deviceInfo},
-                {"deviceType",deviceType},
-                {"deviceMode",deviceMode},
+                {"deviceId", deviceId},
+                // The whole session, oldest first: each entry is the mean of
+                // framesPerEntry decoded frames (the last may have fewer)
+                {"gainDb", gainDb},
+                {"framesPerEntry", stats.blocks_per_entry},
+                {"frames", stats.blocks},
+                // Over every frame of the session
+                {"currentGainDb", stats.current_db},
+                {"minGainDb", stats.min_db},
+                {"maxGainDb", stats.max_db},
+                {"meanGainDb", stats.mean_db},
             }}
         };
         
         std::string response = j.dump() + "|||";
-        ssize_t sent = send(client_fd, response.c_str(), response.size(), 0);
-        if (sent < 0) {
-            perror("send failed");
-        }
+        broadcast(response);
     } catch (const std::exception& e) {
-        std::cerr << "[PCMServer::sendDeviceDisconnect] Exception: " << e.what() << std::endl;
+        std::cerr << "[PCMServer::sendAgcTelemetry] Exception: " << e.what() << std::endl;
     }
 }
 
+void PCMServer::sendAudioCodec(const std::string& deviceId, const std::string& codec, int sampleRate, int channels,
+                               int sourceSampleRate, int sourceChannels, size_t frameLength, bool supported)
+{
+    if (clientCount == 0)
+        return;
+    try {
+        json j = {
+            {"type", "ON_AUDIO_CODEC"},
+            {"status", "true"},
+            {"data", {
+                {"deviceId", deviceId},
+                {"codec", codec},
+                {"sampleRate", sampleRate},
+                {"channels", channels},
+                {"sourceSampleRate", sourceSampleRate},
+                {"sourceChannels", sourceChannels},
+                {"frameLength", frameLength},
+                {"supported", supported},
+            }}
+        };
+        
+        std::string response = j.dump() + "|||";
+        broadcast(response);
+    } catch (const std::exception& e) {
+        std::cerr << "[PCMServer::sendAudioCodec] Exception: " << e.what() << std::endl;
+    }
+}
+
+#ifdef __APPLE__
 CGEventRef nullEventTapCallback(CGEventTapProxy proxy, CGEventType type, CGEventRef event, void* refcon) {
     return event;
 }
+#endif
 
 bool PCMServer::checkPermission(int clientFd) {
+#ifndef __APPLE__
+    // No Input Monitoring on Linux: reading /dev/hidraw* is governed by file
+    // permissions, which the HID backend reports when it opens the devices
+    std::cout << "✅ Input Monitoring permission granted\n";
+    return true;
+#else
     /*bool allowed = AXIsProcessTrusted();
     if (allowed) {
         std::cout << "✅ Accessibility permission granted" << std::endl;
@@ -252,6 +497,61 @@ bool PCMServer::checkPermission(int clientFd) {
     }
 
     return allowed;
+#endif
+}
+
+// Live messages for the client are held back while the batch is built and
+// written, so only this thread writes to it and nobody else waits on it;
+// frames the client also got live repeat and can be dropped by seq
+void PCMServer::sendResumeBatch(int clientFd, uint64_t fromSeq, const std::string& deviceId) {
+    int sampleRate = 16000;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        ClientSession* client = findClient(clientFd);
+        if (!client)
+            return;
+        sampleRate = client->sampleRate;
+        client->resuming = true;
+    }
+    
+    std::string response;
+    try {
+        ResumeBatch batch;
+        bool found = resumeProvider && resumeProvider(fromSeq, deviceId, sampleRate, batch);
+        std::cout << "Client " << clientFd << " resume from seq " << fromSeq << ": " << batch.frames << " frames" << std::endl;
+        
+        json j = {
+            {"type", "ON_RESUME"},
+            {"status", found ? "true" : "false"},
+            {"data", {
+                {"deviceId", batch.deviceId},
+                {"fromSeq", fromSeq},
+                {"firstSeq", batch.firstSeq},
+                {"lastSeq", batch.lastSeq},
+                {"frames", batch.frames},
+                {"complete", batch.complete},
+            }}
+        };
+        response = j.dump() + "|||" + batch.messages;
+    } catch (const std::exception& e) {
+        std::cerr << "[PCMServer::sendResumeBatch] Exception: " << e.what() << std::endl;
+    }
+    
+    // Then whatever was held back meanwhile, until it stays empty
+    while (true) {
+        if (!response.empty())
+            sendToClient(clientFd, response);
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        ClientSession* client = findClient(clientFd);
+        if (!client)
+            return;
+        if (client->backlog.empty()) {
+            client->resuming = false;
+            return;
+        }
+        response.swap(client->backlog);
+        client->backlog.clear();
+    }
 }
 
 void PCMServer::onClientMessage(int clientFd, const std::string& msg) {
@@ -273,12 +573,134 @@ void PCMServer::onClientMessage(int clientFd, const std::string& msg) {
             };
             
             std::string response = j.dump() + "|||";
-            ssize_t sent = send(clientFd, response.c_str(), response.size(), 0);
-            if (sent < 0) {
-                perror("send failed");
-            }
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            sendToClient(clientFd, response);
         } catch (const std::exception& e) {
             std::cerr << "[PCMServer::sendCheckPermission] Exception: " << e.what() << std::endl;
         }
     }
+    else if (msg == "VAD_SUPPRESS_SILENCE_ON" || msg == "VAD_SUPPRESS_SILENCE_OFF") {
+        suppressSilence = (msg == "VAD_SUPPRESS_SILENCE_ON");
+        std::cout << "Silent frame suppression " << (suppressSilence ? "enabled" : "disabled") << std::endl;
+        
+        try {
+            json j = {
+                {"type", "ON_VAD_CONFIG"},
+                {"status", "true"},
+                {"data", {
+                    {"suppressSilence", suppressSilence.load()},
+                }}
+            };
+            
+            std::string response = j.dump() + "|||";
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            sendToClient(clientFd, response);
+        } catch (const std::exception& e) {
+            std::cerr << "[PCMServer::onClientMessage] Exception: " << e.what() << std::endl;
+        }
+    }
+    else if (msg == "GET_LATENCY_STATS") {
+        try {
+            // per device: frames, and p50/p99/p999/max in µs for each pipeline stage
+            json j = {
+                {"type", "ON_LATENCY_STATS"},
+                {"status", "true"},
+                {"data", {
+                    {"devices", latencyStatsProvider ? json::parse(latencyStatsProvider()) : json::array()},
+                }}
+            };
+            
+            std::string response = j.dump() + "|||";
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            sendToClient(clientFd, response);
+        } catch (const std::exception& e) {
+            std::cerr << "[PCMServer::onClientMessage] Exception: " << e.what() << std::endl;
+        }
+    }
+    else if (msg == "GET_STATS") {
+        try {
+            json counters = json::object();
+            for (int c = 0; c < METRIC_COUNTER_COUNT; ++c) {
+                counters[metricName((MetricCounter)c)] = metricsTotal((MetricCounter)c);
+            }
+            json j = {
+                {"type", "ON_STATS"},
+                {"status", "true"},
+                {"data", {
+                    {"counters", counters},
+                    {"clientsConnected", clientCount.load()},
+                    {"devices", deviceStatsProvider ? json::parse(deviceStatsProvider()) : json::array()},
+                }}
+            };
+            
+            std::string response = j.dump() + "|||";
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            sendToClient(clientFd, response);
+        } catch (const std::exception& e) {
+            std::cerr << "[PCMServer::onClientMessage] Exception: " << e.what() << std::endl;
+        }
+    }
+    else if (msg.rfind("RESUME_FROM ", 0) == 0) {
+        std::istringstream args(msg.substr(strlen("RESUME_FROM ")));
+        uint64_t fromSeq = 0;
+        std::string deviceId;
+        args >> fromSeq >> deviceId;
+        sendResumeBatch(clientFd, fromSeq, deviceId);
+    }
+    else if (msg == "SET_AUDIO_FORMAT MSBC" || msg == "SET_AUDIO_FORMAT PCM") {
+        bool encoded = (msg == "SET_AUDIO_FORMAT MSBC");
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            for (auto &client : clients) {
+                if (client.fd == clientFd)
+                    client.encoded = encoded;
+            }
+            updateClientCounts();
+        }
+        std::cout << "Client " << clientFd << " audio format " << (encoded ? "mSBC passthrough" : "PCM") << std::endl;
+        
+        try {
+            json j = {
+                {"type", "ON_AUDIO_FORMAT"},
+                {"status", "true"},
+                {"data", {
+                    {"format", encoded ? "MSBC" : "PCM"},
+                }}
+            };
+            
+            std::string response = j.dump() + "|||";
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            sendToClient(clientFd, response);
+        } catch (const std::exception& e) {
+            std::cerr << "[PCMServer::onClientMessage] Exception: " << e.what() << std::endl;
+        }
+    }
+    else if (msg.rfind("SET_SAMPLE_RATE ", 0) == 0) {
+        int rate = atoi(msg.c_str() + strlen("SET_SAMPLE_RATE "));
+        bool supported = (rate == 8000 || rate == 16000 || rate == 24000 || rate == 48000);
+        if (supported) {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            for (auto &client : clients) {
+                if (client.fd == clientFd)
+                    client.sampleRate = rate;
+            }
+        }
+        std::cout << "Client " << clientFd << " sample rate " << rate << (supported ? "" : " not supported") << std::endl;
+        
+        try {
+            json j = {
+                {"type", "ON_SAMPLE_RATE"},
+                {"status", supported ? "true" : "false"},
+                {"data", {
+                    {"sampleRate", rate},
+                }}
+            };
+            
+            std::string response = j.dump() + "|||";
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            sendToClient(clientFd, response);
+        } catch (const std::exception& e) {
+            std::cerr << "[PCMServer::onClientMessage] Exception: " << e.what() << std::endl;
+        }
+    }
 }
@@ -8,7 +8,18 @@
 #pragma once
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
 #include <netinet/in.h>
+#include "LatencyStats.h"
+#include "agc.h"
+
+// Live messages held back for a client while its RESUME_FROM batch is sent;
+// past this many bytes further ones are dropped (the client sees a seq gap)
+#define PCM_SERVER_RESUME_BACKLOG_MAX (4 << 20)
 
 class PCMServer {
 public:
@@ -17,28 +28,111 @@ public:
 
     bool start();
     void stop();
-    void sendAudioPCM(uint8_t* data, size_t length);
+    // Sends to the clients that asked for sampleRate (SET_SAMPLE_RATE, default 16000).
+    // Adds the time spent building and sending to the encode/send stages of timing.
+    // seq numbers the frames of deviceId, counting on from one voice stream
+    // to the next; a gap within a stream means frames were suppressed as silence, while lost frames are sent
+    // concealed instead.
+    void sendAudioPCM(const std::string& deviceId, uint8_t* data, size_t length, int sampleRate = 16000,
+                      FrameTiming* timing = nullptr, uint64_t seq = 0, bool concealed = false);
+    // Sends one raw mSBC frame to the clients in passthrough mode
+    // (SET_AUDIO_FORMAT MSBC); timestampNs is when the frame was captured on
+    // the HidBackend::now() clock (frames of one report are 7.5 ms apart)
+    void sendEncodedAudio(const std::string& deviceId, const uint8_t* frame, size_t length,
+                          uint64_t seq, uint64_t timestampNs);
     void sendKeyboard(uint16_t key, uint8_t state, uint16_t action_type);
     void sendDeviceConnect(std::string deviceInfo, uint8_t deviceType, uint8_t deviceMode, std::string deviceMACAddr);
     void sendDeviceDisconnect(std::string deviceInfo, uint8_t deviceType, uint8_t deviceMode);
+    void sendVadEvent(const std::string& deviceId, bool speechStart, uint64_t sampleOffset);
+    // gainDb is the session's AGC trajectory (agc_get_trajectory), stats its
+    // figures over every block of the session
+    void sendAgcTelemetry(const std::string& deviceId, const std::vector<float>& gainDb, const AgcSessionStats& stats);
+    // The codec a device's audio turned out to be in. sampleRate and channels
+    // are those of the PCM sent as ON_VOICE_DATA by default (clients may ask
+    // for other rates); sourceSampleRate and sourceChannels are the codec's,
+    // before the downmix and resampling. supported is false if the source
+    // rate can't be brought to sampleRate and the audio is dropped.
+    void sendAudioCodec(const std::string& deviceId, const std::string& codec, int sampleRate, int channels,
+                        int sourceSampleRate, int sourceChannels, size_t frameLength, bool supported);
     void setOnClientConnected(std::function<void()> callback) {
         onClientConnected = callback;
     }
+    // Returns the JSON array answered to GET_LATENCY_STATS
+    void setLatencyStatsProvider(std::function<std::string()> provider) {
+        latencyStatsProvider = provider;
+    }
+    // Returns the per-device JSON array answered to GET_STATS
+    void setDeviceStatsProvider(std::function<std::string()> provider) {
+        deviceStatsProvider = provider;
+    }
+    // Answer to RESUME_FROM <seq> [deviceId]: the device's recent frames from
+    // seq on, already built as ON_VOICE_DATA messages at the client's rate
+    struct ResumeBatch {
+        std::string deviceId;
+        uint64_t firstSeq = 0;
+        uint64_t lastSeq = 0;
+        size_t frames = 0;
+        bool complete = false;      // nothing between seq and firstSeq was overwritten
+        std::string messages;
+    };
+    // Fills batch; returns false if there is no such device
+    void setResumeProvider(std::function<bool(uint64_t, const std::string&, int, ResumeBatch&)> provider) {
+        resumeProvider = provider;
+    }
     void sendStatusMessage(const std::string &msg);
     void onClientMessage(int clientFd, const std::string& msg);
 
+    // Set by the client with VAD_SUPPRESS_SILENCE_ON / VAD_SUPPRESS_SILENCE_OFF
+    bool isSilenceSuppressed() const { return suppressSilence; }
+
+    // Whether decoding is needed: some client wants PCM, or none is connected
+    // (the local PCM dump still gets written then)
+    bool wantsPcm() const { return clientCount == 0 || clientCount > encodedClientCount; }
+    bool wantsEncoded() const { return encodedClientCount > 0; }
+
+    // Distinct sample rates the PCM clients want audio in
+    std::vector<int> requestedSampleRates();
+
+    // Wire messages ("{json}|||"), built separately from sending so the
+    // serialization cost can be measured on its own (tools/bench.cpp)
+    static std::string buildAudioMessage(const std::string& deviceId, const uint8_t* data, size_t length,
+                                         int sampleRate, uint64_t seq = 0, bool concealed = false);
+    static std::string buildEncodedAudioMessage(const std::string& deviceId, const uint8_t* frame, size_t length,
+                                                uint64_t seq, uint64_t timestampNs);
+    static std::string buildKeyboardMessage(uint16_t key, uint8_t state, uint16_t action_type);
+    static std::string buildDeviceConnectMessage(const std::string& deviceInfo, uint8_t deviceType, uint8_t deviceMode, const std::string& deviceMACAddr);
+    static std::string buildVadEventMessage(const std::string& deviceId, bool speechStart, uint64_t sampleOffset);
+
 private:
     void run();             // TCP监听线程
     void clientThread(int clientFd);
-    std::vector<int> clients;
+    void broadcast(const std::string& payload);
+    void sendToClient(int clientFd, const std::string& payload);
+    void updateClientCounts();      // with clientsMutex held
+
+    struct ClientSession {
+        int fd = -1;
+        int sampleRate = 16000;
+        bool encoded = false;       // raw mSBC passthrough instead of PCM
+        bool resuming = false;      // a RESUME_FROM batch is being sent to it
+        std::string backlog;        // live messages held back meanwhile
+    };
+    // With clientsMutex held: sends payload to client, or holds it back
+    // while the client is resuming
+    void sendToSession(ClientSession& client, const std::string& payload);
+    ClientSession* findClient(int clientFd);    // with clientsMutex held
+    void sendResumeBatch(int clientFd, uint64_t fromSeq, const std::string& deviceId);
+    std::vector<ClientSession> clients;
     std::mutex clientsMutex;
+    std::atomic<int> clientCount{0};
+    std::atomic<int> encodedClientCount{0};
 
     int server_fd{-1};      // 服务端 socket
-    int client_fd{-1};      // 唯一客户端 socket
     int port;
 
     std::thread serverThread;
     std::atomic<bool> running{false};
+    std::atomic<bool> suppressSilence{false};
 
     // 权限管理
     std::unordered_map<int, bool> clientPermissions;
@@ -48,4 +142,7 @@ private:
     bool checkPermission(int clientFd);
     
     std::function<void()> onClientConnected;
+    std::function<std::string()> latencyStatsProvider;
+    std::function<std::string()> deviceStatsProvider;
+    std::function<bool(uint64_t, const std::string&, int, ResumeBatch&)> resumeProvider;
 };
@@ -0,0 +1,284 @@
+//
+//  SessionCatalog.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "SessionCatalog.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+static const char* CREATE_SQL =
+    "CREATE TABLE IF NOT EXISTS sessions ("
+    " id INTEGER PRIMARY KEY,"
+    " device TEXT NOT NULL,"
+    " codec TEXT NOT NULL DEFAULT '',"
+    " start_mono_ns INTEGER NOT NULL,"
+    " stop_mono_ns INTEGER NOT NULL DEFAULT 0,"
+    " start_wall_ns INTEGER NOT NULL,"
+    " stop_wall_ns INTEGER NOT NULL DEFAULT 0,"
+    " frames INTEGER NOT NULL DEFAULT 0,"
+    " lost INTEGER NOT NULL DEFAULT 0,"
+    " duplicates INTEGER NOT NULL DEFAULT 0,"
+    " concealed INTEGER NOT NULL DEFAULT 0,"
+    " crc_errors INTEGER NOT NULL DEFAULT 0,"
+    " decode_errors INTEGER NOT NULL DEFAULT 0,"
+    " file TEXT NOT NULL DEFAULT '',"
+    " archive_session INTEGER NOT NULL DEFAULT 0);"
+    "CREATE INDEX IF NOT EXISTS sessions_by_start ON sessions(start_wall_ns);"
+    "CREATE INDEX IF NOT EXISTS sessions_by_device ON sessions(device, start_wall_ns);";
+
+static const char* UPSERT_SQL =
+    "INSERT OR REPLACE INTO sessions (id, device, codec, start_mono_ns, stop_mono_ns, start_wall_ns,"
+    " stop_wall_ns, frames, lost, duplicates, concealed, crc_errors, decode_errors, file, archive_session)"
+    " VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11, ?12, ?13, ?14, ?15)";
+
+#define SESSION_COLUMNS "id, device, codec, start_mono_ns, stop_mono_ns, start_wall_ns, stop_wall_ns," \
+    " frames, lost, duplicates, concealed, crc_errors, decode_errors, file, archive_session"
+
+// A session still running (stop 0) overlaps everything after its start
+static const char* RANGE_SQL =
+    "SELECT " SESSION_COLUMNS " FROM sessions"
+    " WHERE start_wall_ns < ?2 AND (stop_wall_ns = 0 OR stop_wall_ns >= ?1)"
+    " AND (?3 = '' OR device = ?3)"
+    " ORDER BY start_wall_ns LIMIT ?4";
+
+static const char* BY_ID_SQL = "SELECT " SESSION_COLUMNS " FROM sessions WHERE id = ?1";
+
+static const char* DEVICES_SQL = "SELECT device, COUNT(*) FROM sessions GROUP BY device ORDER BY device";
+
+// SQLite integers are signed; ns since the epoch fit until 2262
+static sqlite3_int64 toSql(uint64_t value) {
+    return (sqlite3_int64)std::min<uint64_t>(value, INT64_MAX);
+}
+
+static std::string columnText(sqlite3_stmt* statement, int column) {
+    const unsigned char* text = sqlite3_column_text(statement, column);
+    return text ? (const char*)text : "";
+}
+
+SessionCatalog::~SessionCatalog() {
+    close();
+}
+
+bool SessionCatalog::execute(sqlite3* db, const char* sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        std::cerr << "❌ Session catalog: " << (error ? error : sqlite3_errmsg(db)) << std::endl;
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+bool SessionCatalog::prepare(sqlite3* db, const char* sql, sqlite3_stmt** statement) {
+    if (sqlite3_prepare_v2(db, sql, -1, statement, nullptr) != SQLITE_OK) {
+        std::cerr << "❌ Session catalog: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SessionCatalog::open(const std::string& path, bool readOnly) {
+    if (!readOnly) {
+        if (sqlite3_open_v2(path.c_str(), &writeDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+            std::cerr << "❌ Can't open session catalog " << path << ": " << sqlite3_errmsg(writeDb) << std::endl;
+            return false;
+        }
+        // WAL: readers don't block the writer nor it them. NORMAL only syncs
+        // at checkpoints, which costs at most the last batches on power loss.
+        if (!execute(writeDb, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;") ||
+            !execute(writeDb, CREATE_SQL) || !prepare(writeDb, UPSERT_SQL, &upsertStatement))
+            return false;
+        sqlite3_busy_timeout(writeDb, 1000);
+
+        // IDs are handed out by begin() so the input thread never waits for a row
+        sqlite3_stmt* maxId = nullptr;
+        if (!prepare(writeDb, "SELECT COALESCE(MAX(id), 0) + 1 FROM sessions", &maxId))
+            return false;
+        if (sqlite3_step(maxId) == SQLITE_ROW)
+            nextId = sqlite3_column_int64(maxId, 0);
+        sqlite3_finalize(maxId);
+    }
+
+    if (sqlite3_open_v2(path.c_str(), &readDb, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        std::cerr << "❌ Can't open session catalog " << path << ": " << sqlite3_errmsg(readDb) << std::endl;
+        return false;
+    }
+    sqlite3_busy_timeout(readDb, 1000);
+    if (!prepare(readDb, RANGE_SQL, &rangeStatement) || !prepare(readDb, BY_ID_SQL, &byIdStatement) ||
+        !prepare(readDb, DEVICES_SQL, &devicesStatement))
+        return false;
+
+    if (!readOnly)
+        writer = std::thread(&SessionCatalog::writerLoop, this);
+    return true;
+}
+
+void SessionCatalog::close() {
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        writer.join();
+    }
+    for (sqlite3_stmt* statement : {upsertStatement, rangeStatement, byIdStatement, devicesStatement}) {
+        sqlite3_finalize(statement);
+    }
+    upsertStatement = rangeStatement = byIdStatement = devicesStatement = nullptr;
+    sqlite3_close(readDb);
+    sqlite3_close(writeDb);     // checkpoints the WAL into the database
+    readDb = writeDb = nullptr;
+}
+
+// ====== 写入 ======
+int64_t SessionCatalog::begin(const SessionRecord& session) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!writeDb)
+        return 0;
+    SessionRecord row = session;
+    row.id = nextId++;
+    queue.push_back(row);
+    queuedCount++;
+    wake.notify_one();
+    return row.id;
+}
+
+void SessionCatalog::end(const SessionRecord& session) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!writeDb || session.id <= 0)
+        return;
+    queue.push_back(session);
+    queuedCount++;
+    wake.notify_one();
+}
+
+void SessionCatalog::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!writer.joinable())
+        return;
+    uint64_t target = queuedCount;
+    flushing = true;
+    wake.notify_one();
+    committed.wait(lock, [&] { return committedCount >= target; });
+    flushing = false;
+}
+
+void SessionCatalog::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty())
+            break;  // stopping with nothing left
+        // Let a batch build up: sessions end in bursts (several devices, a
+        // begin right after an end), one transaction takes them all
+        wake.wait_for(lock, std::chrono::milliseconds(SESSION_CATALOG_BATCH_MS), [this] {
+            return stopping || flushing || queue.size() >= SESSION_CATALOG_BATCH_MAX;
+        });
+        std::deque<SessionRecord> batch;
+        batch.swap(queue);
+
+        lock.unlock();
+        commit(batch);
+        lock.lock();
+        committedCount += batch.size();
+        committed.notify_all();
+    }
+}
+
+void SessionCatalog::commit(const std::deque<SessionRecord>& batch) {
+    if (!execute(writeDb, "BEGIN"))
+        return;
+    for (auto& row : batch) {
+        sqlite3_stmt* s = upsertStatement;
+        sqlite3_bind_int64(s, 1, row.id);
+        sqlite3_bind_text(s, 2, row.deviceId.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(s, 3, row.codec.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(s, 4, toSql(row.startMonoNs));
+        sqlite3_bind_int64(s, 5, toSql(row.stopMonoNs));
+        sqlite3_bind_int64(s, 6, toSql(row.startWallNs));
+        sqlite3_bind_int64(s, 7, toSql(row.stopWallNs));
+        sqlite3_bind_int64(s, 8, toSql(row.frames));
+        sqlite3_bind_int64(s, 9, toSql(row.lost));
+        sqlite3_bind_int64(s, 10, toSql(row.duplicates));
+        sqlite3_bind_int64(s, 11, toSql(row.concealed));
+        sqlite3_bind_int64(s, 12, toSql(row.crcErrors));
+        sqlite3_bind_int64(s, 13, toSql(row.decodeErrors));
+        sqlite3_bind_text(s, 14, row.file.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(s, 15, row.archiveSession);
+        if (sqlite3_step(s) != SQLITE_DONE)
+            std::cerr << "❌ Session catalog: can't write session " << row.id << ": " << sqlite3_errmsg(writeDb) << std::endl;
+        sqlite3_reset(s);
+        sqlite3_clear_bindings(s);
+    }
+    if (!execute(writeDb, "COMMIT"))
+        execute(writeDb, "ROLLBACK");
+}
+
+// ====== 查询 ======
+std::vector<SessionRecord> SessionCatalog::readSessions(sqlite3_stmt* statement, size_t limit) {
+    std::vector<SessionRecord> rows;
+    while (rows.size() < limit && sqlite3_step(statement) == SQLITE_ROW) {
+        SessionRecord row;
+        row.id = sqlite3_column_int64(statement, 0);
+        row.deviceId = columnText(statement, 1);
+        row.codec = columnText(statement, 2);
+        row.startMonoNs = (uint64_t)sqlite3_column_int64(statement, 3);
+        row.stopMonoNs = (uint64_t)sqlite3_column_int64(statement, 4);
+        row.startWallNs = (uint64_t)sqlite3_column_int64(statement, 5);
+        row.stopWallNs = (uint64_t)sqlite3_column_int64(statement, 6);
+        row.frames = (uint64_t)sqlite3_column_int64(statement, 7);
+        row.lost = (uint64_t)sqlite3_column_int64(statement, 8);
+        row.duplicates = (uint64_t)sqlite3_column_int64(statement, 9);
+        row.concealed = (uint64_t)sqlite3_column_int64(statement, 10);
+        row.crcErrors = (uint64_t)sqlite3_column_int64(statement, 11);
+        row.decodeErrors = (uint64_t)sqlite3_column_int64(statement, 12);
+        row.file = columnText(statement, 13);
+        row.archiveSession = (uint32_t)sqlite3_column_int64(statement, 14);
+        rows.push_back(row);
+    }
+    sqlite3_reset(statement);
+    sqlite3_clear_bindings(statement);
+    return rows;
+}
+
+std::vector<SessionRecord> SessionCatalog::sessions(const std::string& deviceId, uint64_t fromWallNs,
+                                                    uint64_t toWallNs, size_t limit) {
+    std::lock_guard<std::mutex> lock(queryMutex);
+    if (!rangeStatement)
+        return {};
+    sqlite3_bind_int64(rangeStatement, 1, toSql(fromWallNs));
+    sqlite3_bind_int64(rangeStatement, 2, toSql(toWallNs));
+    sqlite3_bind_text(rangeStatement, 3, deviceId.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(rangeStatement, 4, toSql(limit));
+    return readSessions(rangeStatement, limit);
+}
+
+bool SessionCatalog::session(int64_t id, SessionRecord* session) {
+    std::lock_guard<std::mutex> lock(queryMutex);
+    if (!byIdStatement)
+        return false;
+    sqlite3_bind_int64(byIdStatement, 1, id);
+    auto rows = readSessions(byIdStatement, 1);
+    if (rows.empty())
+        return false;
+    *session = rows.front();
+    return true;
+}
+
+std::vector<std::pair<std::string, uint64_t>> SessionCatalog::devices() {
+    std::lock_guard<std::mutex> lock(queryMutex);
+    std::vector<std::pair<std::string, uint64_t>> found;
+    if (!devicesStatement)
+        return found;
+    while (sqlite3_step(devicesStatement) == SQLITE_ROW) {
+        found.emplace_back(columnText(devicesStatement, 0), (uint64_t)sqlite3_column_int64(devicesStatement, 1));
+    }
+    sqlite3_reset(devicesStatement);
+    return found;
+}
@@ -0,0 +1,109 @@
+//
+//  SessionCatalog.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+#define SESSION_CATALOG_BATCH_MS     250    // writes queued this long are committed together
+#define SESSION_CATALOG_BATCH_MAX    256    // or as soon as this many are queued
+#define SESSION_CATALOG_QUERY_LIMIT  1000
+
+// One voice session (long press to release) of one device
+struct SessionRecord {
+    int64_t id = 0;
+    std::string deviceId;
+    std::string codec;
+    uint64_t startMonoNs = 0;       // backend clock (HidBackend::now)
+    uint64_t stopMonoNs = 0;        // 0 while the session runs, or if it never ended
+    uint64_t startWallNs = 0;       // ns since the epoch
+    uint64_t stopWallNs = 0;
+    uint64_t frames = 0;            // received
+    uint64_t lost = 0;              // gaps in the H2 sequence
+    uint64_t duplicates = 0;
+    uint64_t concealed = 0;
+    uint64_t crcErrors = 0;
+    uint64_t decodeErrors = 0;      // sync and other decode failures
+    std::string file;               // audio kept for it (--archive), "" if none
+    uint32_t archiveSession = 0;    // its session in that file
+};
+
+/*
+ * SQLite catalog of voice sessions, so tools can find "device X yesterday
+ * afternoon" without opening any audio. The input thread only queues
+ * begin()/end(); a writer thread commits the queue in one transaction per
+ * SESSION_CATALOG_BATCH_MS through prepared statements, in WAL mode so
+ * queries on their own connection never wait for it.
+ *
+ *   sessions(id, device, codec, start_mono_ns, stop_mono_ns, start_wall_ns,
+ *            stop_wall_ns, frames, lost, duplicates, concealed, crc_errors,
+ *            decode_errors, file, archive_session)
+ */
+class SessionCatalog {
+public:
+    SessionCatalog() = default;
+    SessionCatalog(const SessionCatalog&) = delete;
+    SessionCatalog& operator=(const SessionCatalog&) = delete;
+    ~SessionCatalog();
+
+    // Creates the database if needed. readOnly catalogs only answer queries
+    // and start no writer.
+    bool open(const std::string& path, bool readOnly = false);
+    // Commits what is queued and stops the writer
+    void close();
+
+    // ====== 写入（输入线程，不阻塞）======
+    // Returns the session's ID; the row is inserted by the writer
+    int64_t begin(const SessionRecord& session);
+    // Stop times and counters of session.id
+    void end(const SessionRecord& session);
+    // Waits until everything queued so far is committed
+    void flush();
+
+    // ====== 查询 ======
+    // Sessions that overlap [fromWallNs, toWallNs), oldest first; deviceId "" for all
+    std::vector<SessionRecord> sessions(const std::string& deviceId, uint64_t fromWallNs, uint64_t toWallNs,
+                                        size_t limit = SESSION_CATALOG_QUERY_LIMIT);
+    bool session(int64_t id, SessionRecord* session);
+    // Every device with a session, and how many
+    std::vector<std::pair<std::string, uint64_t>> devices();
+
+private:
+    bool execute(sqlite3* db, const char* sql);
+    bool prepare(sqlite3* db, const char* sql, sqlite3_stmt** statement);
+    void writerLoop();
+    void commit(const std::deque<SessionRecord>& batch);
+    std::vector<SessionRecord> readSessions(sqlite3_stmt* statement, size_t limit);
+
+    sqlite3* writeDb = nullptr;
+    sqlite3_stmt* upsertStatement = nullptr;   // begin() and end() both write the whole row
+
+    std::mutex queryMutex;          // queries share one connection and its statements
+    sqlite3* readDb = nullptr;
+    sqlite3_stmt* rangeStatement = nullptr;
+    sqlite3_stmt* byIdStatement = nullptr;
+    sqlite3_stmt* devicesStatement = nullptr;
+
+    std::mutex mutex;
+    std::condition_variable wake;       // writer: something queued, or stopping
+    std::condition_variable committed;  // flush(): the writer caught up
+    std::deque<SessionRecord> queue;
+    uint64_t queuedCount = 0;
+    uint64_t committedCount = 0;
+    int64_t nextId = 1;
+    bool flushing = false;
+    bool stopping = false;
+    std::thread writer;
+};
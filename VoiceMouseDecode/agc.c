@@ -0,0 +1,162 @@
+//
+//  agc.c
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "agc.h"
+#include <string.h>
+#include <math.h>
+
+#define AGC_LEVEL_ATTACK    0.5f    // level estimate smoothing when the block is louder
+#define AGC_LEVEL_RELEASE   0.05f   // ... and when it is quieter
+#define AGC_LIMITER_RELEASE_S 0.05f
+#define AGC_DELAY_LEN       (AGC_LOOKAHEAD + 1)
+
+static inline float db_to_lin(float db) {
+    return powf(10.0f, db / 20.0f);
+}
+
+void agc_init(AgcState *state) {
+    memset(state, 0, sizeof(*state));
+    state->level_db = AGC_TARGET_DBFS;
+    state->applied_gain = 1.0f;
+    state->limiter_gain = 1.0f;
+    for (int i = 0; i < AGC_DELAY_LEN; ++i) {
+        state->required[i] = 1.0f;
+    }
+    agc_begin_session(state);
+}
+
+void agc_begin_session(AgcState *state) {
+    state->trajectory_len = 0;
+    state->trajectory_stride = 1;
+    state->pending_sum = 0.0f;
+    state->pending_count = 0;
+    state->session_blocks = 0;
+    state->session_min_db = 0.0f;
+    state->session_max_db = 0.0f;
+    state->session_sum_db = 0.0;
+    state->last_db = 0.0f;
+}
+
+static void record_gain(AgcState *state, float gain_db) {
+    if (state->session_blocks == 0 || gain_db < state->session_min_db) state->session_min_db = gain_db;
+    if (state->session_blocks == 0 || gain_db > state->session_max_db) state->session_max_db = gain_db;
+    state->session_sum_db += gain_db;
+    state->session_blocks++;
+    state->last_db = gain_db;
+
+    state->pending_sum += gain_db;
+    if (++state->pending_count < state->trajectory_stride) {
+        return;
+    }
+    state->trajectory[state->trajectory_len++] = state->pending_sum / state->pending_count;
+    state->pending_sum = 0.0f;
+    state->pending_count = 0;
+
+    // Full: merge neighbours so the same entries cover twice the time
+    if (state->trajectory_len == AGC_TRAJECTORY_LEN) {
+        for (uint32_t i = 0; i < AGC_TRAJECTORY_LEN / 2; ++i) {
+            state->trajectory[i] = 0.5f * (state->trajectory[2 * i] + state->trajectory[2 * i + 1]);
+        }
+        state->trajectory_len = AGC_TRAJECTORY_LEN / 2;
+        state->trajectory_stride *= 2;
+    }
+}
+
+static void update_gain(const int16_t *data, size_t length, AgcState *state) {
+    double power = 0.0;
+    for (size_t i = 0; i < length; ++i) {
+        power += (double)data[i] * data[i];
+    }
+    float block_db = 10.0f * log10f((float)(power / length) / (32768.0f * 32768.0f) + 1e-12f);
+
+    // Silence and background noise must not pull the gain up
+    if (block_db > AGC_GATE_DBFS) {
+        float k = block_db > state->level_db ? AGC_LEVEL_ATTACK : AGC_LEVEL_RELEASE;
+        state->level_db += k * (block_db - state->level_db);
+    }
+
+    float desired = AGC_TARGET_DBFS - state->level_db;
+    if (desired > AGC_MAX_GAIN_DB) desired = AGC_MAX_GAIN_DB;
+    if (desired < AGC_MIN_GAIN_DB) desired = AGC_MIN_GAIN_DB;
+
+    float dt = (float)length / SAMPLE_RATE;
+    float step = desired - state->gain_db;
+    if (step > AGC_RISE_DB_PER_S * dt) step = AGC_RISE_DB_PER_S * dt;
+    if (step < -AGC_FALL_DB_PER_S * dt) step = -AGC_FALL_DB_PER_S * dt;
+    state->gain_db += step;
+}
+
+void agc_process(int16_t *data, size_t length, AgcState *state) {
+    if (length == 0) {
+        return;
+    }
+
+    update_gain(data, length, state);
+
+    const float attack = 1.0f - expf(-3.0f / AGC_LOOKAHEAD);
+    const float release = 1.0f - expf(-1.0f / (AGC_LIMITER_RELEASE_S * SAMPLE_RATE));
+    const float g0 = state->applied_gain;
+    const float g1 = db_to_lin(state->gain_db);
+    const float dg = (g1 - g0) / length;
+    float min_limiter = state->limiter_gain;
+
+    for (size_t i = 0; i < length; ++i) {
+        // Gain ramps linearly across the block to avoid zipper noise
+        float s = data[i] * (g0 + dg * (i + 1));
+        float mag = fabsf(s);
+
+        state->delay[state->delay_pos] = s;
+        state->required[state->delay_pos] = mag > AGC_LIMIT ? AGC_LIMIT / mag : 1.0f;
+        state->delay_pos = (state->delay_pos + 1) % AGC_DELAY_LEN;
+
+        // The oldest sample leaves now; every peak still in the window must be
+        // covered by the time it gets here
+        float target = 1.0f;
+        for (int j = 0; j < AGC_DELAY_LEN; ++j) {
+            if (state->required[j] < target) target = state->required[j];
+        }
+        float lg = state->limiter_gain;
+        lg += (target - lg) * (target < lg ? attack : release);
+        state->limiter_gain = lg;
+
+        // Never let the smoothing overshoot the ceiling
+        if (state->required[state->delay_pos] < lg) lg = state->required[state->delay_pos];
+        if (lg < min_limiter) min_limiter = lg;
+
+        float y = state->delay[state->delay_pos] * lg;
+        if (y > 32767.0f) y = 32767.0f;
+        if (y < -32768.0f) y = -32768.0f;
+        data[i] = (int16_t)lrintf(y);
+    }
+    state->applied_gain = g1;
+
+    record_gain(state, state->gain_db + 20.0f * log10f(min_limiter));
+}
+
+size_t agc_get_trajectory(const AgcState *state, float *out, size_t max_entries) {
+    size_t n = 0;
+    for (uint32_t i = 0; i < state->trajectory_len && n < max_entries; ++i) {
+        out[n++] = state->trajectory[i];
+    }
+    if (state->pending_count > 0 && n < max_entries) {
+        out[n++] = state->pending_sum / state->pending_count;
+    }
+    return n;
+}
+
+void agc_get_session_stats(const AgcState *state, AgcSessionStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (state->session_blocks == 0) {
+        return;
+    }
+    stats->blocks = state->session_blocks;
+    stats->blocks_per_entry = state->trajectory_stride;
+    stats->current_db = state->last_db;
+    stats->min_db = state->session_min_db;
+    stats->max_db = state->session_max_db;
+    stats->mean_db = (float)(state->session_sum_db / state->session_blocks);
+}
@@ -0,0 +1,82 @@
+//
+//  agc.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#ifndef AGC_H
+#define AGC_H
+
+#include "denoise.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AGC_TARGET_DBFS     -20.0f  // speech level the AGC steers towards
+#define AGC_MAX_GAIN_DB     30.0f
+#define AGC_MIN_GAIN_DB     -10.0f
+#define AGC_GATE_DBFS       -55.0f  // blocks below this don't update the level estimate
+#define AGC_RISE_DB_PER_S   6.0f
+#define AGC_FALL_DB_PER_S   200.0f
+#define AGC_LIMIT           29205   // -1 dBFS limiter ceiling
+#define AGC_LOOKAHEAD       32      // limiter look-ahead in samples (2 ms), also the AGC latency
+#define AGC_TRAJECTORY_LEN  256     // gain history entries; halved (and doubled in span) when full
+
+typedef struct {
+    float level_db;             // smoothed speech level, dBFS
+    float gain_db;              // current AGC gain
+    float applied_gain;         // linear gain at the end of the last block, for interpolation
+    float limiter_gain;
+
+    // look-ahead delay line of gained samples and the limiter gain each one needs
+    float delay[AGC_LOOKAHEAD + 1];
+    float required[AGC_LOOKAHEAD + 1];
+    size_t delay_pos;
+
+    // effective gain (AGC + limiter) of the session, in dB: each entry is the
+    // mean of trajectory_stride blocks, so the whole session always fits
+    float trajectory[AGC_TRAJECTORY_LEN];
+    uint32_t trajectory_len;
+    uint32_t trajectory_stride;
+    float pending_sum;          // blocks not making up an entry yet
+    uint32_t pending_count;
+
+    // per block over the whole session, not just what the trajectory shows
+    uint32_t session_blocks;
+    float session_min_db;
+    float session_max_db;
+    double session_sum_db;
+    float last_db;
+} AgcState;
+
+typedef struct {
+    uint32_t blocks;            // processed this session
+    uint32_t blocks_per_entry;  // of the trajectory
+    float current_db;           // last block
+    float min_db;
+    float max_db;
+    float mean_db;
+} AgcSessionStats;
+
+void agc_init(AgcState *state);
+
+// Starts a new session's trajectory and stats; the gain carries over
+void agc_begin_session(AgcState *state);
+
+// Applies gain in place. The output is delayed by AGC_LOOKAHEAD samples.
+void agc_process(int16_t *data, size_t length, AgcState *state);
+
+// Copies the session's gain trajectory, oldest first, at most max_entries
+// (AGC_TRAJECTORY_LEN takes it all). Every entry but the last spans
+// blocks_per_entry blocks; the last may span fewer.
+size_t agc_get_trajectory(const AgcState *state, float *out, size_t max_entries);
+
+// Gain statistics of every block of the session; all zero before the first
+void agc_get_session_stats(const AgcState *state, AgcSessionStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -6,46 +6,300 @@
 //
 
 #include "denoise.h"
-#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DENOISE_USE_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DENOISE_USE_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DENOISE_USE_NEON
+#endif
+
 #define PI 3.141592653589793
 
-static float high_pass_filter(float x, HighPassFilterState *state) {
-    float rc = 1.0f / (2 * PI * 100.0f);  // cutoff 100Hz
-    float dt = 1.0f / SAMPLE_RATE;
-    float alpha = rc / (rc + dt);
+// Samples processed per pass; bounds the scratch buffer on the stack
+#define DENOISE_BLOCK 128
+#define SMOOTH_TAPS (2 * SMOOTH_WINDOW + 1)
+#define SMOOTH_SCALE (1.0f / SMOOTH_TAPS)
+
+/*
+ * All paths work on float samples. The gate output is an integer value held in
+ * a float, so the smoother sums are exact and multiplying by 1/7 followed by a
+ * truncation gives the same result as the original integer division.
+ */
 
-    float y = alpha * (state->y_prev + x - state->x_prev);
+static inline float hp_gate_sample(float x, HighPassFilterState *state) {
+    float y = state->alpha * (state->y_prev + x - state->x_prev);
     state->x_prev = x;
     state->y_prev = y;
-    return y;
+
+    if (y > 32767.0f) y = 32767.0f;
+    if (y < -32768.0f) y = -32768.0f;
+    float t = truncf(y);
+    return (fabsf(t) < ENERGY_THRESHOLD) ? 0.0f : t;
+}
+
+static inline int16_t smooth_sample(const float *ext) {
+    float sum = ext[0];
+    for (int j = 1; j < SMOOTH_TAPS; ++j) {
+        sum += ext[j];
+    }
+    return (int16_t)(sum * SMOOTH_SCALE);
+}
+
+/*
+ * The high-pass is y[n] = a * y[n-1] + a * (x[n] - x[n-1]). The SIMD paths
+ * compute a * (x[n] - x[n-1]) for a whole vector, run a log-step prefix scan
+ * (v += a * shift1(v); v += a^2 * shift2(v); ...) and add the carried-in
+ * y_prev scaled by a, a^2, ... per lane.
+ */
+#if defined(DENOISE_USE_AVX2)
+
+static void hp_gate_block(const int16_t *in, float *out, size_t n, HighPassFilterState *state) {
+    const float a = state->alpha;
+    const float a2 = a * a, a4 = a2 * a2;
+    const __m256 va = _mm256_set1_ps(a);
+    const __m256 va2 = _mm256_set1_ps(a2);
+    const __m256 va4 = _mm256_set1_ps(a4);
+    const __m256 carry = _mm256_set_ps(a4 * a4, a4 * a2 * a, a4 * a2, a4 * a, a4, a2 * a, a2, a);
+    const __m256i sh1 = _mm256_set_epi32(6, 5, 4, 3, 2, 1, 0, 0);
+    const __m256i sh2 = _mm256_set_epi32(5, 4, 3, 2, 1, 0, 0, 0);
+    const __m256i sh4 = _mm256_set_epi32(3, 2, 1, 0, 0, 0, 0, 0);
+    const __m256i last = _mm256_set1_epi32(7);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 lo = _mm256_set1_ps(-32768.0f);
+    const __m256 hi = _mm256_set1_ps(32767.0f);
+    const __m256 thr = _mm256_set1_ps((float)ENERGY_THRESHOLD);
+    const __m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+    __m256 xprev = _mm256_set1_ps(state->x_prev);
+    __m256 yprev = _mm256_set1_ps(state->y_prev);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + i))));
+        __m256 xs = _mm256_blend_ps(_mm256_permutevar8x32_ps(x, sh1), xprev, 0x01);
+        __m256 v = _mm256_mul_ps(va, _mm256_sub_ps(x, xs));
+        v = _mm256_add_ps(v, _mm256_mul_ps(va, _mm256_blend_ps(_mm256_permutevar8x32_ps(v, sh1), zero, 0x01)));
+        v = _mm256_add_ps(v, _mm256_mul_ps(va2, _mm256_blend_ps(_mm256_permutevar8x32_ps(v, sh2), zero, 0x03)));
+        v = _mm256_add_ps(v, _mm256_mul_ps(va4, _mm256_blend_ps(_mm256_permutevar8x32_ps(v, sh4), zero, 0x0F)));
+        __m256 y = _mm256_add_ps(v, _mm256_mul_ps(carry, yprev));
+
+        xprev = _mm256_permutevar8x32_ps(x, last);
+        yprev = _mm256_permutevar8x32_ps(y, last);
+
+        __m256 t = _mm256_round_ps(_mm256_min_ps(_mm256_max_ps(y, lo), hi), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        __m256 keep = _mm256_cmp_ps(_mm256_and_ps(t, absmask), thr, _CMP_GE_OQ);
+        _mm256_storeu_ps(out + i, _mm256_and_ps(t, keep));
+    }
+
+    state->x_prev = _mm256_cvtss_f32(xprev);
+    state->y_prev = _mm256_cvtss_f32(yprev);
+
+    for (; i < n; ++i) {
+        out[i] = hp_gate_sample(in[i], state);
+    }
+}
+
+static void smooth_block(const float *ext, int16_t *out, size_t n) {
+    const __m256 scale = _mm256_set1_ps(SMOOTH_SCALE);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 sum = _mm256_loadu_ps(ext + i);
+        for (int j = 1; j < SMOOTH_TAPS; ++j) {
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(ext + i + j));
+        }
+        __m256i q = _mm256_cvttps_epi32(_mm256_mul_ps(sum, scale));
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+        _mm_storeu_si128((__m128i *)(out + i), packed);
+    }
+
+    for (; i < n; ++i) {
+        out[i] = smooth_sample(ext + i);
+    }
+}
+
+const char *denoise_get_implementation_info(void) {
+    return "avx2";
+}
+
+#elif defined(DENOISE_USE_SSE2)
+
+#define SHIFT_LANES(v, n) _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4 * (n)))
+
+static void hp_gate_block(const int16_t *in, float *out, size_t n, HighPassFilterState *state) {
+    const float a = state->alpha;
+    const __m128 va = _mm_set1_ps(a);
+    const __m128 va2 = _mm_set1_ps(a * a);
+    const __m128 carry = _mm_set_ps(a * a * a * a, a * a * a, a * a, a);
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    const __m128 thr = _mm_set1_ps((float)ENERGY_THRESHOLD);
+    const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    __m128 xprev = _mm_set1_ps(state->x_prev);
+    __m128 yprev = _mm_set1_ps(state->y_prev);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i w = _mm_loadl_epi64((const __m128i *)(in + i));
+        __m128 x = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16));
+        __m128 xs = _mm_move_ss(SHIFT_LANES(x, 1), xprev);
+        __m128 v = _mm_mul_ps(va, _mm_sub_ps(x, xs));
+        v = _mm_add_ps(v, _mm_mul_ps(va, SHIFT_LANES(v, 1)));
+        v = _mm_add_ps(v, _mm_mul_ps(va2, SHIFT_LANES(v, 2)));
+        __m128 y = _mm_add_ps(v, _mm_mul_ps(carry, yprev));
+
+        xprev = _mm_shuffle_ps(x, x, 0xFF);
+        yprev = _mm_shuffle_ps(y, y, 0xFF);
+
+        // clamp, then truncate toward zero like the (int16_t) cast did
+        __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(y, lo), hi)));
+        __m128 keep = _mm_cmpge_ps(_mm_and_ps(t, absmask), thr);
+        _mm_storeu_ps(out + i, _mm_and_ps(t, keep));
+    }
+
+    state->x_prev = _mm_cvtss_f32(xprev);
+    state->y_prev = _mm_cvtss_f32(yprev);
+
+    for (; i < n; ++i) {
+        out[i] = hp_gate_sample(in[i], state);
+    }
 }
 
-static int16_t energy_gate(int16_t sample) {
-    return (abs(sample) < ENERGY_THRESHOLD) ? 0 : sample;
+static void smooth_block(const float *ext, int16_t *out, size_t n) {
+    const __m128 scale = _mm_set1_ps(SMOOTH_SCALE);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 sum = _mm_loadu_ps(ext + i);
+        for (int j = 1; j < SMOOTH_TAPS; ++j) {
+            sum = _mm_add_ps(sum, _mm_loadu_ps(ext + i + j));
+        }
+        __m128i q = _mm_cvttps_epi32(_mm_mul_ps(sum, scale));
+        _mm_storel_epi64((__m128i *)(out + i), _mm_packs_epi32(q, q));
+    }
+
+    for (; i < n; ++i) {
+        out[i] = smooth_sample(ext + i);
+    }
+}
+
+const char *denoise_get_implementation_info(void) {
+    return "sse2";
+}
+
+#elif defined(DENOISE_USE_NEON)
+
+static void hp_gate_block(const int16_t *in, float *out, size_t n, HighPassFilterState *state) {
+    const float a = state->alpha;
+    const float32x4_t va = vdupq_n_f32(a);
+    const float32x4_t va2 = vdupq_n_f32(a * a);
+    const float carry_lanes[4] = { a, a * a, a * a * a, a * a * a * a };
+    const float32x4_t carry = vld1q_f32(carry_lanes);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t lo = vdupq_n_f32(-32768.0f);
+    const float32x4_t hi = vdupq_n_f32(32767.0f);
+    const float32x4_t thr = vdupq_n_f32((float)ENERGY_THRESHOLD);
+
+    float32x4_t xprev = vdupq_n_f32(state->x_prev);
+    float32x4_t yprev = vdupq_n_f32(state->y_prev);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t x = vcvtq_f32_s32(vmovl_s16(vld1_s16(in + i)));
+        float32x4_t xs = vextq_f32(xprev, x, 3);
+        float32x4_t v = vmulq_f32(va, vsubq_f32(x, xs));
+        v = vmlaq_f32(v, va, vextq_f32(zero, v, 3));
+        v = vmlaq_f32(v, va2, vextq_f32(zero, v, 2));
+        float32x4_t y = vmlaq_f32(v, carry, yprev);
+
+        xprev = vdupq_n_f32(vgetq_lane_f32(x, 3));
+        yprev = vdupq_n_f32(vgetq_lane_f32(y, 3));
+
+        float32x4_t t = vcvtq_f32_s32(vcvtq_s32_f32(vminq_f32(vmaxq_f32(y, lo), hi)));
+        uint32x4_t keep = vcgeq_f32(vabsq_f32(t), thr);
+        vst1q_f32(out + i, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(t), keep)));
+    }
+
+    state->x_prev = vgetq_lane_f32(xprev, 0);
+    state->y_prev = vgetq_lane_f32(yprev, 0);
+
+    for (; i < n; ++i) {
+        out[i] = hp_gate_sample(in[i], state);
+    }
 }
 
-static void smooth_samples(int16_t *data, size_t length) {
-    for (size_t i = SMOOTH_WINDOW; i < length - SMOOTH_WINDOW; ++i) {
-        int32_t sum = 0;
-        for (int j = -SMOOTH_WINDOW; j <= SMOOTH_WINDOW; ++j) {
-            sum += data[i + j];
+static void smooth_block(const float *ext, int16_t *out, size_t n) {
+    const float32x4_t scale = vdupq_n_f32(SMOOTH_SCALE);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t sum = vld1q_f32(ext + i);
+        for (int j = 1; j < SMOOTH_TAPS; ++j) {
+            sum = vaddq_f32(sum, vld1q_f32(ext + i + j));
         }
-        data[i] = sum / (2 * SMOOTH_WINDOW + 1);
+        vst1_s16(out + i, vqmovn_s32(vcvtq_s32_f32(vmulq_f32(sum, scale))));
+    }
+
+    for (; i < n; ++i) {
+        out[i] = smooth_sample(ext + i);
+    }
+}
+
+const char *denoise_get_implementation_info(void) {
+    return "neon";
+}
+
+#else
+
+static void hp_gate_block(const int16_t *in, float *out, size_t n, HighPassFilterState *state) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = hp_gate_sample(in[i], state);
+    }
+}
+
+static void smooth_block(const float *ext, int16_t *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = smooth_sample(ext + i);
     }
 }
 
+const char *denoise_get_implementation_info(void) {
+    return "scalar";
+}
+
+#endif
+
 void denoise_init(HighPassFilterState *state) {
+    float rc = 1.0f / (2 * PI * HIGH_PASS_CUTOFF);
+    float dt = 1.0f / SAMPLE_RATE;
+
+    state->alpha = rc / (rc + dt);
     state->x_prev = 0.0f;
     state->y_prev = 0.0f;
+    memset(state->history, 0, sizeof(state->history));
 }
 
 void denoise_buffer(int16_t *data, size_t length, HighPassFilterState *state) {
-    for (size_t i = 0; i < length; ++i) {
-        float hp = high_pass_filter((float)data[i], state);
-        data[i] = energy_gate((int16_t)hp);
+    // [ history (2 * SMOOTH_WINDOW) | gated samples of this pass ]
+    float ext[2 * SMOOTH_WINDOW + DENOISE_BLOCK];
+
+    while (length > 0) {
+        size_t n = length < DENOISE_BLOCK ? length : DENOISE_BLOCK;
+
+        memcpy(ext, state->history, sizeof(state->history));
+        hp_gate_block(data, ext + 2 * SMOOTH_WINDOW, n, state);
+        smooth_block(ext, data, n);
+        memcpy(state->history, ext + n, sizeof(state->history));
+
+        data += n;
+        length -= n;
     }
-    smooth_samples(data, length);
 }
-
@@ -18,15 +18,30 @@ extern "C" {
 #define SAMPLE_RATE     16000
 #define ENERGY_THRESHOLD 500
 #define SMOOTH_WINDOW 3
+#define HIGH_PASS_CUTOFF 100.0f
+
+// The smoother is centred, so each output sample needs SMOOTH_WINDOW samples
+// of look-ahead: the stream comes out delayed by DENOISE_LATENCY samples.
+#define DENOISE_LATENCY SMOOTH_WINDOW
 
 typedef struct {
+    float alpha;        // high-pass coefficient, computed once in denoise_init
     float x_prev;
     float y_prev;
+    // Last 2 * SMOOTH_WINDOW gated samples of the previous buffer, so the
+    // smoothing window spans buffer boundaries
+    float history[2 * SMOOTH_WINDOW];
 } HighPassFilterState;
 
 void denoise_init(HighPassFilterState *state);
+
+// Streaming high-pass + energy gate + box smoother, in place. Buffers may have
+// any length; consecutive calls behave like one continuous stream.
 void denoise_buffer(int16_t *data, size_t length, HighPassFilterState *state);
 
+// Name of the kernel variant selected at compile time ("scalar", "sse2", ...)
+const char *denoise_get_implementation_info(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,194 @@
+//
+//  lc3dec.c
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "lc3dec.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef LC3DEC_WITH_LIBLC3
+#include <lc3.h>
+#else
+#include <dlfcn.h>
+#include <pthread.h>
+#endif
+
+static int config_valid(int sample_rate, int frame_us) {
+	if (frame_us != 7500 && frame_us != 10000)
+		return 0;
+	switch (sample_rate) {
+	case 8000: case 16000: case 24000: case 32000: case 48000:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+size_t lc3dec_get_codesize(lc3dec_t *dec) {
+	return dec->frame_samples * sizeof(int16_t);
+}
+
+#ifdef LC3DEC_WITH_LIBLC3
+
+static int liblc3_available(void) {
+	return 1;
+}
+
+const char *lc3dec_get_implementation_info(void) {
+	return "liblc3";
+}
+
+#else
+
+/*
+ * Default build: liblc3 is looked up at run time, so LC3 works wherever the
+ * library is installed (liblc3 packages on Linux, Homebrew lc3 on macOS)
+ * without a build flag. LC3DEC_LIBRARY names a library to use instead.
+ * These match the liblc3 API (lc3.h).
+ */
+typedef void *lc3_decoder_t;
+enum lc3_pcm_format { LC3_PCM_FORMAT_S16 };
+
+static unsigned (*lc3_decoder_size)(int dt_us, int sr_hz);
+static lc3_decoder_t (*lc3_setup_decoder)(int dt_us, int sr_hz, int sr_pcm_hz, void *mem);
+static int (*lc3_decode)(lc3_decoder_t decoder, const void *in, int nbytes,
+			enum lc3_pcm_format fmt, void *pcm, int stride);
+static int (*lc3_frame_samples)(int dt_us, int sr_hz);
+
+static pthread_once_t liblc3_once = PTHREAD_ONCE_INIT;
+static int liblc3_loaded;
+
+static void liblc3_load(void) {
+	static const char *const names[] = {
+#ifdef __APPLE__
+		"liblc3.dylib", "/opt/homebrew/lib/liblc3.dylib", "/usr/local/lib/liblc3.dylib",
+#else
+		"liblc3.so.1", "liblc3.so",
+#endif
+	};
+	void *lib = NULL;
+	const char *path = getenv("LC3DEC_LIBRARY");
+	if (path && *path) {
+		lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	} else {
+		for (size_t i = 0; i < sizeof(names) / sizeof(names[0]) && !lib; i++)
+			lib = dlopen(names[i], RTLD_NOW | RTLD_LOCAL);
+	}
+	if (!lib)
+		return;
+
+	*(void **)&lc3_decoder_size = dlsym(lib, "lc3_decoder_size");
+	*(void **)&lc3_setup_decoder = dlsym(lib, "lc3_setup_decoder");
+	*(void **)&lc3_decode = dlsym(lib, "lc3_decode");
+	*(void **)&lc3_frame_samples = dlsym(lib, "lc3_frame_samples");
+	if (lc3_decoder_size && lc3_setup_decoder && lc3_decode && lc3_frame_samples)
+		liblc3_loaded = 1;
+	else
+		dlclose(lib);
+}
+
+static int liblc3_available(void) {
+	pthread_once(&liblc3_once, liblc3_load);
+	return liblc3_loaded;
+}
+
+const char *lc3dec_get_implementation_info(void) {
+	return liblc3_available() ? "liblc3 (loaded)" : "none";
+}
+
+#endif
+
+int lc3dec_init(lc3dec_t *dec, int sample_rate, int frame_us) {
+	memset(dec, 0, sizeof(lc3dec_t));
+	if (!config_valid(sample_rate, frame_us))
+		return -EINVAL;
+	if (!liblc3_available())
+		return -ENOTSUP;
+
+	unsigned size = lc3_decoder_size(frame_us, sample_rate);
+	if (size == 0)
+		return -EINVAL;
+	dec->priv_alloc_base = malloc(size);
+	if (!dec->priv_alloc_base)
+		return -ENOMEM;
+	dec->priv = lc3_setup_decoder(frame_us, sample_rate, sample_rate, dec->priv_alloc_base);
+	if (!dec->priv) {
+		lc3dec_finish(dec);
+		return -EINVAL;
+	}
+
+	dec->sample_rate = sample_rate;
+	dec->frame_us = frame_us;
+	dec->frame_samples = (size_t)lc3_frame_samples(frame_us, sample_rate);
+	return 0;
+}
+
+// input NULL asks liblc3 for a concealed frame
+static ssize_t decode_one(lc3dec_t *dec, const void *input, size_t input_len, int16_t *output) {
+	int ret = lc3_decode((lc3_decoder_t)dec->priv, input, (int)input_len,
+			LC3_PCM_FORMAT_S16, output, 1);
+	if (ret < 0)
+		return -EINVAL;
+	return ret == 1 && input ? -EIO : (ssize_t)input_len;
+}
+
+ssize_t lc3dec_decode(lc3dec_t *dec, const void *input, size_t input_len,
+			void *output, size_t output_len, size_t *written) {
+	if (written)
+		*written = 0;
+	if (!dec->priv || !input || input_len < LC3DEC_MIN_FRAME_BYTES || input_len > LC3DEC_MAX_FRAME_BYTES ||
+	    output_len < lc3dec_get_codesize(dec))
+		return -EINVAL;
+
+	ssize_t ret = decode_one(dec, input, input_len, (int16_t *)output);
+	if (ret != -EINVAL && written)
+		*written = lc3dec_get_codesize(dec);
+	return ret;
+}
+
+ssize_t lc3dec_decode_batch(lc3dec_t *dec, const void *input, size_t frame_len,
+			size_t frames, void *output, size_t output_len, size_t *written) {
+	const uint8_t *in = (const uint8_t *)input;
+	int16_t *out = (int16_t *)output;
+	size_t codesize = lc3dec_get_codesize(dec);
+	size_t n;
+
+	if (written)
+		*written = 0;
+	if (!dec->priv || frame_len < LC3DEC_MIN_FRAME_BYTES || frame_len > LC3DEC_MAX_FRAME_BYTES ||
+	    output_len < frames * codesize)
+		return -EINVAL;
+
+	for (n = 0; n < frames; n++) {
+		if (decode_one(dec, in + n * frame_len, frame_len, out + n * dec->frame_samples) < 0)
+			break;
+		if (written)
+			*written += codesize;
+	}
+	return (ssize_t)n;
+}
+
+ssize_t lc3dec_conceal(lc3dec_t *dec, void *output, size_t output_len, size_t *written) {
+	if (written)
+		*written = 0;
+	if (!dec->priv || output_len < lc3dec_get_codesize(dec))
+		return -EINVAL;
+
+	ssize_t ret = decode_one(dec, NULL, 0, (int16_t *)output);
+	if (ret < 0)
+		return ret;
+	if (written)
+		*written = lc3dec_get_codesize(dec);
+	return 0;
+}
+
+void lc3dec_finish(lc3dec_t *dec) {
+	if (!dec)
+		return;
+	free(dec->priv_alloc_base);
+	memset(dec, 0, sizeof(lc3dec_t));
+}
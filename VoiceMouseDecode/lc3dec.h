@@ -0,0 +1,77 @@
+//
+//  lc3dec.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#ifndef LC3DEC_H
+#define LC3DEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest decoded LC3 frame: 10 ms at 48 kHz, mono
+#define LC3DEC_MAX_FRAME_SAMPLES 480
+// Encoded frame sizes the LC3 spec allows
+#define LC3DEC_MIN_FRAME_BYTES   20
+#define LC3DEC_MAX_FRAME_BYTES   400
+
+/*
+ * LE Audio LC3 frame decoder, mono, 16-bit native-endian output, with the
+ * same call pattern as sbc.h. LC3 frames carry no header: rate and frame
+ * duration come from the device's configuration (sample_rate 8000, 16000,
+ * 24000, 32000 or 48000 Hz; frame_us 7500 or 10000), and every frame's
+ * length is whatever the transport says it is.
+ *
+ * The codec core is liblc3 (MDCT, LTPF and PLC are its vectorized ones).
+ * Every build looks it up at run time (LC3DEC_LIBRARY overrides the path);
+ * -DLC3DEC_WITH_LIBLC3 -llc3 links it instead. Without the library
+ * lc3dec_init() returns -ENOTSUP and the device is reported unsupported.
+ */
+struct lc3dec_struct {
+	int sample_rate;
+	int frame_us;
+	size_t frame_samples;
+
+	void *priv;
+	void *priv_alloc_base;
+};
+
+typedef struct lc3dec_struct lc3dec_t;
+
+// 0, -EINVAL for a rate/duration LC3 doesn't have, -ENOTSUP if liblc3
+// can't be found, -ENOMEM
+int lc3dec_init(lc3dec_t *dec, int sample_rate, int frame_us);
+
+/* Decodes ONE frame of input_len bytes into ONE output block. Returns
+ * input_len, or -EINVAL (bad length or output too small), -EIO (corrupted
+ * frame: output then holds the decoder's own concealment). */
+ssize_t lc3dec_decode(lc3dec_t *dec, const void *input, size_t input_len,
+			void *output, size_t output_len, size_t *written);
+
+/* Decodes frames packed back to back, frame_len bytes each, into
+ * consecutive output blocks. Stops at the first corrupted frame; returns
+ * how many frames were decoded, -EINVAL if output can't hold them all. */
+ssize_t lc3dec_decode_batch(lc3dec_t *dec, const void *input, size_t frame_len,
+			size_t frames, void *output, size_t output_len, size_t *written);
+
+/* Packet loss concealment: ONE output block standing in for a lost frame */
+ssize_t lc3dec_conceal(lc3dec_t *dec, void *output, size_t output_len, size_t *written);
+
+/* Returns the uncompressed block size in bytes */
+size_t lc3dec_get_codesize(lc3dec_t *dec);
+
+const char *lc3dec_get_implementation_info(void);
+void lc3dec_finish(lc3dec_t *dec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LC3DEC_H
@@ -1,36 +1,177 @@
-#include <CoreFoundation/CoreFoundation.h>
-#include <IOKit/hid/IOHIDManager.h>
-#include <IOBluetooth/IOBluetooth.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <csignal>
 #include <map>
 #include <set>
 #include <vector>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include "sbc.h"
 #include "PCMServer.h"
 #include <time.h>
 #include "denoise.h"
-#include "hidapi.h"
+#include "vad.h"
+#include "DecoderPool.h"
+#include "HidBackend.h"
+#include "JitterBuffer.h"
+#include "AiButton.h"
+#include "AudioReportLayout.h"
+#include "AudioArchive.h"
+#include "SessionCatalog.h"
+#include "AudioPipeline.h"
+#include <chrono>
 #include <regex>
 
 
-std::map<IOHIDDeviceRef, uint32_t> deviceUsagePage; // 保存设备和usagePage映射
+// Per-device state handed back by the backend with every report, so the
+// input path needs no map lookups. Created in DeviceConnectedCallback.
+struct DeviceContext {
+    uint16_t productId = 0;
+    uint32_t audioUsagePage = 0;        // usagePage of the audio element, 0 if none
+    AudioReportLayout audioLayout;      // where the mSBC frames are in its reports
+    DeviceDecoder* decoder = nullptr;   // acquired on first use, released on removal
+    std::unique_ptr<AiButton> aiButton; // created on the first press
+    bool recording = false;             // voice session: from the long press to the release
+    uint32_t archiveSession = 0;        // --archive session being written, 0 if none
+    SessionRecord catalogSession;       // --catalog: the voice session under way, id 0 if none
+    SessionRecord catalogBaseline;      // the device's counters when it began
+};
+std::map<HidDeviceRef, std::unique_ptr<DeviceContext>> deviceContexts;
+// Callbacks of different devices may run concurrently (Linux); this guards
+// what they share: deviceContexts, deviceMap, devicePid and usbMouse
+static std::mutex deviceMapMutex;
 
 std::ofstream pcmFile;
-bool recording;
+static std::mutex pcmFileMutex;     // every device's frames go to the one dump
 
-static struct timespec pressTime;
-static bool aiKeyPressed = false;
-static bool transKeyPressed = false;
+static std::atomic<bool> transKeyPressed{false};
 
 PCMServer pcmServer;
+DecoderPool decoderPool;   // per-device decoder + DSP state
+static AudioPipeline audioPipeline(pcmServer, decoderPool);
+static std::unique_ptr<JitterPlayout> jitterPlayout;   // --jitter-buffer
+static std::unique_ptr<AudioArchiveWriter> audioArchive; // --archive
+static std::string archivePath;
+static std::unique_ptr<SessionCatalog> sessionCatalog;  // --catalog
 static sbc_t sbc_context;
 static bool sbc_initialized = false;
 
 uint32_t audioUsagePage;
 
-std::string getBluetoothMouseMac();
+std::unique_ptr<HidBackend> hidBackend;
+
+// Wall clock time (ns since the epoch) of backendNs on the backend clock
+static uint64_t wallClockNs(uint64_t backendNs) {
+    uint64_t wallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    uint64_t now = hidBackend->now();
+    return wallNs - (now > backendNs ? now - backendNs : 0);
+}
+
+static void endArchiveSession(DeviceContext* context) {
+    if (!audioArchive || !context->archiveSession)
+        return;
+    audioArchive->endSession(context->archiveSession, wallClockNs(hidBackend->now()));
+    context->archiveSession = 0;
+}
+
+static void beginCatalogSession(DeviceContext* context, DeviceDecoder& decoder) {
+    if (!sessionCatalog)
+        return;
+    SessionRecord& baseline = context->catalogBaseline;
+    baseline.lost = decoder.sequence.lost;
+    baseline.duplicates = decoder.sequence.duplicates;
+    baseline.concealed = decoder.concealed;
+    baseline.crcErrors = decoder.crcErrors;
+    baseline.decodeErrors = decoder.decodeErrors;
+
+    SessionRecord& session = context->catalogSession;
+    session = SessionRecord();
+    session.deviceId = decoder.label;
+    session.startMonoNs = hidBackend->now();
+    session.startWallNs = wallClockNs(session.startMonoNs);
+    session.id = sessionCatalog->begin(session);
+}
+
+// Queues the stop time and counters of the session; call before
+// endArchiveSession, which forgets the archive session
+static void endCatalogSession(DeviceContext* context) {
+    SessionRecord& session = context->catalogSession;
+    if (!sessionCatalog || !session.id || !context->decoder)
+        return;
+    DeviceDecoder& decoder = *context->decoder;
+    const SessionRecord& baseline = context->catalogBaseline;
+    session.codec = audioCodecName(decoder.format.codec);
+    session.stopMonoNs = hidBackend->now();
+    session.stopWallNs = wallClockNs(session.stopMonoNs);
+    session.lost = decoder.sequence.lost - baseline.lost;
+    session.duplicates = decoder.sequence.duplicates - baseline.duplicates;
+    session.concealed = decoder.concealed - baseline.concealed;
+    session.crcErrors = decoder.crcErrors - baseline.crcErrors;
+    session.decodeErrors = decoder.decodeErrors - baseline.decodeErrors;
+    if (context->archiveSession) {
+        session.file = archivePath;
+        session.archiveSession = context->archiveSession;
+    }
+    sessionCatalog->end(session);
+    session = SessionRecord();
+}
+
+// Appends one encoded frame to the device's archive session, opening one on
+// the first frame of a voice session or after the codec changed
+static void archiveFrame(DeviceContext* context, DeviceDecoder& decoder, bool formatChanged,
+                         const uint8_t* frame, size_t length, int lostFrames, uint64_t capturedNs) {
+    if (formatChanged)
+        endArchiveSession(context);
+    uint64_t timestampNs = wallClockNs(capturedNs);
+    if (!context->archiveSession) {
+        AudioArchiveSession session;
+        session.deviceId = decoder.label;
+        session.codec = (uint8_t)decoder.format.codec;
+        session.sampleRate = decoder.format.sampleRate;
+        session.channels = decoder.format.channels;
+        session.frameSamples = decoder.format.frameSamples;
+        session.frameUs = decoder.format.frameUs;
+        context->archiveSession = audioArchive->beginSession(session, timestampNs);
+        lostFrames = 0;     // nothing before the first frame to stand in for
+    }
+    audioArchive->writeFrame(context->archiveSession, timestampNs, frame, length, lostFrames);
+}
+
+// The catalog's frame count and the --archive copy of every frame the audio
+// pipeline accepts
+static void recordEncodedFrame(void* context, DeviceDecoder& decoder, bool formatChanged, bool supported,
+                               const uint8_t* frame, size_t length, int lostFrames, uint64_t capturedNs) {
+    auto* deviceContext = static_cast<DeviceContext*>(context);
+    if (deviceContext->catalogSession.id)
+        deviceContext->catalogSession.frames++;
+    if (audioArchive && supported)
+        archiveFrame(deviceContext, decoder, formatChanged, frame, length, lostFrames, capturedNs);
+}
+
+// Every decoded frame, of every device, goes to the debug PCM file
+static bool dumpDecodedFrame(const int16_t* pcm, size_t len) {
+    std::lock_guard<std::mutex> lock(pcmFileMutex);
+    if (!pcmFile.is_open())
+    {
+        pcmFile.open("audio_data_decoded.pcm", std::ios::binary | std::ios::trunc);
+        if (!pcmFile)
+        {
+            std::cerr << "❌ Can't open PCM file to write\n";
+            return false;
+        }
+    }
+    
+    pcmFile.write(reinterpret_cast<const char*>(pcm), len);
+    pcmFile.flush();
+    // Can run "ffmpeg -f s16le -ar 16000 -ac 1 -i audio_data_decoded.pcm output.wav" to convert from pcm to wav
+    return true;
+}
 
 // self-defined AI key map
 std::map<uint16_t, std::string> aiKeyMap = {
@@ -60,7 +201,12 @@ std::string getCacheFilePath() {
     const char* home = std::getenv("HOME");
     if (!home) home = "/tmp"; // fallback
 
+#ifdef __APPLE__
     std::string path = std::string(home) + "/Library/Application Support/voicemousedecode";
+#else
+    const char* dataHome = std::getenv("XDG_DATA_HOME");
+    std::string path = (dataHome && *dataHome ? std::string(dataHome) : std::string(home) + "/.local/share") + "/voicemousedecode";
+#endif
     std::filesystem::create_directories(path); // 确保目录存在
     return path + "/device_id.txt";
 }
@@ -94,20 +240,32 @@ void deleteMacStrFile() {
     }
 }
 
-std::map<IOHIDDeviceRef, std::string> deviceMap;
+std::map<HidDeviceRef, std::string> deviceMap;
+std::map<HidDeviceRef, uint16_t> devicePid;
 // device connect
-IOHIDDeviceRef usbMouse = nullptr;
-void DeviceConnectedCallback(void* context, IOReturn result, void* sender, IOHIDDeviceRef device) {
-    CFTypeRef pidRef = IOHIDDeviceGetProperty(device, CFSTR(kIOHIDProductIDKey));
-    int pid = 0;
-    if (pidRef) CFNumberGetValue((CFNumberRef)pidRef, kCFNumberIntType, &pid);
+HidDeviceRef usbMouse = nullptr;
+void* DeviceConnectedCallback(HidDeviceRef device, const HidDeviceInfo& info) {
+    int pid = info.productId;
+    DeviceContext* context;
+    {
+        std::lock_guard<std::mutex> lock(deviceMapMutex);
+        devicePid[device] = info.productId;
+        auto& slot = deviceContexts[device];
+        slot = std::make_unique<DeviceContext>();
+        context = slot.get();
+    }
+    context->productId = info.productId;
+    context->audioLayout = audioReportLayoutForProduct(info.productId);
 
     if (pid == 0x8266) {
         std::cout << "✅ Bluetooth mouse connected" << std::endl;
-        deviceUsagePage[device] = 0xFF12;
-        std::string mac = getBluetoothMouseMac();
+        context->audioUsagePage = 0xFF12;
+        std::string mac = hidBackend->bluetoothAddress(device);
         if (!mac.empty()) {
-            deviceMap[device] = mac;   // 只在有值时插入
+            {
+                std::lock_guard<std::mutex> lock(deviceMapMutex);
+                deviceMap[device] = mac;   // 只在有值时插入
+            }
             pcmServer.sendDeviceConnect(mac, 0, 5, mac);
         } else {
             std::cout << "⚠️ Could not find MAC for Bluetooth mouse" << std::endl;
@@ -115,50 +273,48 @@ void DeviceConnectedCallback(void* context, IOReturn result, void* sender, IOHID
     }
     else if (pid == 0xCA10) {
         std::cout << "✅ 2.4G device connected" << std::endl;
-        deviceUsagePage[device] = 0xFF02;
+        context->audioUsagePage = 0xFF02;
         
         //deviceMap[device] = "2.4G";
         // 保存 2.4G 鼠标设备引用
-        usbMouse = device;
+        std::string cachedMac = loadMacStrFromFile();   // 先尝试从缓存读取 MAC
+        {
+            std::lock_guard<std::mutex> lock(deviceMapMutex);
+            usbMouse = device;
+            if (!cachedMac.empty())
+                deviceMap[device] = cachedMac;
+        }
         
-        // 先尝试从缓存读取 MAC
-        std::string cachedMac = loadMacStrFromFile();
         if (!cachedMac.empty()) {
             std::cout << "📂 Loaded cached MAC: " << cachedMac << std::endl;
-            deviceMap[device] = cachedMac;
             pcmServer.sendDeviceConnect(cachedMac, 0, 2, cachedMac);
-            return;
+            return context;
         }
         
         // 发送初始化命令
         uint8_t command[4] = {5, 1, 0, 0}; // 第一个字节是 Report ID = 5
-        IOReturn ret = IOHIDDeviceSetReport(device,
-                                            kIOHIDReportTypeOutput,
-                                            command[0],  // reportID
-                                            command,
-                                            sizeof(command)); // 包含 reportID
-
-        if (ret == kIOReturnSuccess) {
+        if (hidBackend->sendOutputReport(device, command, sizeof(command))) {
             std::cout << "📤 Sent {5,1,0,0} to 2.4G mouse" << std::endl;
-        } else {
-            std::cerr << "❌ Failed to send command, IOReturn = 0x"
-                      << std::hex << ret << std::endl;
         }
     }
     else if (pid == 0x8208) {
         std::cout << "✅ Bluetooth keyboard connected" << std::endl;
         // 键盘不处理音频，不放入 map
     }
+    return context;
 }
 
+// Called on the server's accept thread
 void sendCurrentDevices() {
-    for (auto &entry : deviceMap) {
-        IOHIDDeviceRef device = entry.first;
-        std::string name = entry.second;
-
-        CFTypeRef pidRef = IOHIDDeviceGetProperty(device, CFSTR(kIOHIDProductIDKey));
-        int pid = 0;
-        if (pidRef) CFNumberGetValue((CFNumberRef)pidRef, kCFNumberIntType, &pid);
+    std::vector<std::pair<std::string, int>> devices;
+    {
+        std::lock_guard<std::mutex> lock(deviceMapMutex);
+        for (auto &entry : deviceMap)
+            devices.emplace_back(entry.second, devicePid[entry.first]);
+    }
+    for (auto &entry : devices) {
+        std::string name = entry.first;
+        int pid = entry.second;
 
         if (pid == 0x8266) {
             pcmServer.sendDeviceConnect(name, 0, 5, name);   // 蓝牙鼠标
@@ -171,27 +327,32 @@ void sendCurrentDevices() {
 }
 
 // device removal
-void DeviceRemovedCallback(void* context, IOReturn result, void* sender, IOHIDDeviceRef device) {
-    CFTypeRef pidRef = IOHIDDeviceGetProperty(device, CFSTR(kIOHIDProductIDKey));
-    int pid = 0;
-    if (pidRef) CFNumberGetValue((CFNumberRef)pidRef, kCFNumberIntType, &pid);
-
-    if (pid == 0x8266) {
-        std::cout << "✅ Bluetooth mouse disconnected" << std::endl;
+void DeviceRemovedCallback(HidDeviceRef device, const HidDeviceInfo& info) {
+    int pid = info.productId;
+    std::string mac;
+    bool hasMac = false;
+    {
+        std::lock_guard<std::mutex> lock(deviceMapMutex);
         auto it = deviceMap.find(device);
         if (it != deviceMap.end()) {
-            pcmServer.sendDeviceDisconnect(it->second, 0, 5);
+            mac = it->second;
+            hasMac = true;
             deviceMap.erase(it);
+        }
+    }
+
+    if (pid == 0x8266) {
+        std::cout << "✅ Bluetooth mouse disconnected" << std::endl;
+        if (hasMac) {
+            pcmServer.sendDeviceDisconnect(mac, 0, 5);
         } else {
             std::cout << "⚠️ MAC not found for disconnected device" << std::endl;
         }
     }
     else if (pid == 0xCA10) {
         std::cout << "✅ 2.4G device disconnected" << std::endl;
-        auto it = deviceMap.find(device);
-        if (it != deviceMap.end()) {
-            pcmServer.sendDeviceDisconnect(it->second, 0, 2);
-            deviceMap.erase(it);
+        if (hasMac) {
+            pcmServer.sendDeviceDisconnect(mac, 0, 2);
             deleteMacStrFile();
         } else {
             std::cout << "⚠️ MAC not found for disconnected device" << std::endl;
@@ -202,7 +363,23 @@ void DeviceRemovedCallback(void* context, IOReturn result, void* sender, IOHIDDe
         // 键盘不处理音频，不放入 map
     }
 
-    deviceUsagePage.erase(device); // 移除映射
+    std::unique_ptr<DeviceContext> context;
+    {
+        std::lock_guard<std::mutex> lock(deviceMapMutex);
+        auto it = deviceContexts.find(device);
+        if (it != deviceContexts.end()) {
+            context = std::move(it->second);
+            deviceContexts.erase(it); // 移除映射
+        }
+        devicePid.erase(device);
+        if (usbMouse == device) usbMouse = nullptr;
+    }
+    if (context) {
+        endCatalogSession(context.get());
+        endArchiveSession(context.get());
+    }
+    context.reset();
+    decoderPool.release(device);
 }
 
 size_t sbc_decode(const uint8_t* input, size_t input_len, uint8_t* output, size_t output_max_len) {
@@ -224,23 +401,109 @@ size_t sbc_decode(const uint8_t* input, size_t input_len, uint8_t* output, size_
     return written;
 }
 
-void HandleInput(void* context, IOReturn result, void* sender, IOHIDValueRef value) {
-    IOHIDElementRef element = IOHIDValueGetElement(value);
-    IOHIDDeviceRef dev = IOHIDElementGetDevice(element);
-    
-    uint32_t usagePage = IOHIDElementGetUsagePage(element);
-    uint32_t usage = IOHIDElementGetUsage(element);
-    CFIndex length = IOHIDValueGetLength(value);
-    uint8_t* data = (uint8_t*)IOHIDValueGetBytePtr(value);
+static DeviceDecoder& deviceDecoder(HidDeviceRef dev, DeviceContext* context) {
+    if (!context->decoder) {
+        context->decoder = &decoderPool.acquire(dev);
+        // LC3 can't be told from its frames: the product's --lc3 configuration says
+        AudioFormat lc3Format;
+        if (lc3FormatForProduct(context->productId, &lc3Format))
+            audioPipeline.announceCodec(*context->decoder, context->decoder->setFormat(lc3Format));
+    }
+    return *context->decoder;
+}
+
+// Press, long press and release of the AI key. The long press comes from the
+// AiButton timer, not from an input report.
+static void HandleAiButtonEvent(HidDeviceRef dev, DeviceContext* context, AiButton::Event event) {
+    switch (event) {
+        case AiButton::PRESS:
+            pcmServer.sendKeyboard(32, 1, 0);
+            std::cout << "🔘 Press AI key, send it to client" << std::endl;
+            break;
+        case AiButton::LONG_PRESS: {
+            if (context->recording || transKeyPressed)
+                break;
+            std::cout << "⏱️ Long press AI key, start to receive audio..." << std::endl;
+            pcmServer.sendKeyboard(32, 1, 2);
+            context->recording = true;
+            DeviceDecoder& decoder = deviceDecoder(dev, context);
+            decoder.beginStream();
+            std::string label;
+            {
+                std::lock_guard<std::mutex> lock(deviceMapMutex);
+                auto it = deviceMap.find(dev);
+                if (it != deviceMap.end())
+                    label = it->second;
+            }
+            decoderPool.setLabel(decoder, label);
+            decoder.sessions++;
+            beginCatalogSession(context, decoder);
+            break;
+        }
+        case AiButton::CLICK:
+            std::cout << "🖱️ Click AI key, send it to client" << std::endl;
+            pcmServer.sendKeyboard(32, 0, 0);
+            // A release between the long press and the click timeout still
+            // ends the voice session the long press began
+            if (context->recording) {
+                endCatalogSession(context);
+                endArchiveSession(context);
+                audioPipeline.flush(deviceDecoder(dev, context));
+            }
+            context->recording = false;
+            break;
+        case AiButton::SESSION_END: {
+            std::cout << "🎤 audio data ends" << std::endl;
+            context->recording = false;
+            endCatalogSession(context);
+            endArchiveSession(context);
+            DeviceDecoder& decoder = deviceDecoder(dev, context);
+            audioPipeline.flush(decoder);
+            VadEvent end;
+            if (vad_flush(&decoder.vad, &end)) {
+                pcmServer.sendVadEvent(decoder.label, false, end.sample_offset);
+            }
+            decoder.vadPreRoll.clear();
+            
+            float gains[AGC_TRAJECTORY_LEN];
+            size_t gainCount = agc_get_trajectory(&decoder.agc, gains, AGC_TRAJECTORY_LEN);
+            AgcSessionStats agcStats;
+            agc_get_session_stats(&decoder.agc, &agcStats);
+            pcmServer.sendAgcTelemetry(decoder.label, std::vector<float>(gains, gains + gainCount), agcStats);
+            pcmServer.sendKeyboard(32, 0, 2);  // Send release AI key event to client
+            break;
+        }
+    }
+}
+
+static AiButton& aiButton(HidDeviceRef dev, DeviceContext* context) {
+    if (!context->aiButton) {
+        context->aiButton = std::make_unique<AiButton>(*hidBackend, deviceDecoder(dev, context).button,
+                                                       [dev, context](AiButton::Event event) {
+            HandleAiButtonEvent(dev, context, event);
+        });
+    }
+    return *context->aiButton;
+}
+
+// The frames of one audio report, oldest first, through the audio pipeline
+static void HandleAudioFrames(HidDeviceRef dev, DeviceContext* context, const uint8_t* const* frames, size_t count,
+                              const uint8_t* reportEnd) {
+    audioPipeline.handleFrames(deviceDecoder(dev, context), context, frames, count, reportEnd, hidBackend->now(),
+                               hidBackend->reportArrivalNs());
+}
+
+// One element value of an input report
+static void HandleInput(HidDeviceRef dev, DeviceContext* context, uint32_t usagePage, uint32_t usage, const uint8_t* data, size_t length) {
     
     /*std::cout << "usagePage = 0x" << std::hex << usagePage << ", usage = 0x" << std::hex << usage << std::endl;
      std::cout << "Input data (len=" << std::dec << length << "): ";
-     for (CFIndex i = 0; i < length; ++i) {
+     for (size_t i = 0; i < length; ++i) {
      std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)data[i] << " ";
      }
      std::cout << std::endl;*/
     
-    if (data[0] == 0x81 && data[1] == 0x1 && data[2] == 0x10)
+    if (length >= 9 && data[0] == 0x81 && data[1] == 0x1 && data[2] == 0x10)
     {
         //receive device info from 2.4G mouse
         std::ostringstream oss;
@@ -253,8 +516,10 @@ void HandleInput(void* context, IOReturn result, void* sender, IOHIDValueRef val
         std::string macStr = oss.str();
         std::cout << "DeviceID string: " << macStr << std::endl;
         
-        if (usbMouse) {
-            deviceMap[usbMouse] = macStr;  // usbMouse 在 DeviceConnectedCallback 中保存
+        {
+            std::lock_guard<std::mutex> lock(deviceMapMutex);
+            if (usbMouse)
+                deviceMap[usbMouse] = macStr;  // usbMouse 在 DeviceConnectedCallback 中保存
         }
         
         // ✅ 保存到文件
@@ -289,126 +554,153 @@ void HandleInput(void* context, IOReturn result, void* sender, IOHIDValueRef val
     {
         /*std::cout << "usagePage = 0x" << std::hex << usagePage << ", usage = 0x" << std::hex << usage << std::endl;
          std::cout << "Input data (len=" << std::dec << length << "): ";
-         for (CFIndex i = 0; i < length; ++i) {
+         for (size_t i = 0; i < length; ++i) {
          std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)data[i] << " ";
          }
          std::cout << std::endl;*/
         
-        if (data[0] == 0x01 && !transKeyPressed)
+        if (data[0] == 0x01 && !transKeyPressed.exchange(true))
         {
             std::cout << "Press Mouse multi-media key Translate, send it to client" << std::endl;
-            transKeyPressed = true;
             pcmServer.sendKeyboard(526, 1, 0);
         }
-        else if (data[0] == 0x0 && transKeyPressed)
+        else if (data[0] == 0x0 && transKeyPressed.exchange(false))
         {
             std::cout << "Release Mouse multi-media key Translate, send it to client" << std::endl;
             pcmServer.sendKeyboard(526, 0, 0);
-            transKeyPressed = false;
         }
     }
     
     
     // Handle audio data
-    auto it = deviceUsagePage.find(dev);
-    if (it != deviceUsagePage.end()) {
-        uint32_t expectedUsagePage = it->second;
+    if (context->audioUsagePage != 0) {
+        uint32_t expectedUsagePage = context->audioUsagePage;
         
-        if (usagePage == expectedUsagePage && length >= 3 && data[0] == 0x01)
+        if (usagePage == expectedUsagePage)
         {
-            if (!aiKeyPressed && !transKeyPressed)
+            const uint8_t* frames[AUDIO_REPORT_MAX_FRAMES];
+            size_t frameCount = locateAudioFrames(context->audioLayout, data, length, frames, AUDIO_REPORT_MAX_FRAMES);
+            if (frameCount > 0)
             {
-                // Press AI key first time
-                aiKeyPressed = true;
-                clock_gettime(CLOCK_MONOTONIC, &pressTime);
-                pcmServer.sendKeyboard(32, 1, 0);
-                std::cout << "🔘 Press AI key, send it to client" << std::endl;
-            }
-            else {
-                struct timespec currentTime;
-                clock_gettime(CLOCK_MONOTONIC, &currentTime);
-                double duration = (currentTime.tv_sec - pressTime.tv_sec) + (currentTime.tv_nsec - pressTime.tv_nsec) / 1e9;
-                //std::cout << "duration = " << duration << "s" << std::endl;
-                if (duration > 0.5)
-                {
-                    if (recording == false && !transKeyPressed)
-                    {
-                        std::cout << "⏱️ Long press AI key, start to receive audio..." << std::endl;
-                        pcmServer.sendKeyboard(32, 1, 2);
-                        recording = true;
-                    }
-                    
-                    // Handle audio decode
-                    static sbc_t sbc;
-                    static bool initialized = false;
-                    if (!initialized) {
-                        sbc_init_msbc(&sbc, 0);
-                        sbc.endian = SBC_LE;
-                        initialized = true;
-                    }
-                    
-                    const size_t msbc_data_len = 57;
-                    const uint8_t* msbc_data = data + 2;
-                    
-                    int16_t pcm_output[240] = {0};
-                    size_t pcm_len = 0;
-                    
-                    ssize_t result = sbc_decode(&sbc, msbc_data, msbc_data_len, (uint8_t *)pcm_output, sizeof(pcm_output), &pcm_len);
-                    
-                    if (result > 0 && pcm_len > 0)
-                    {
-                        if (!pcmFile.is_open())
-                        {
-                            pcmFile.open("audio_data_decoded.pcm", std::ios::binary | std::ios::trunc);
-                            if (!pcmFile)
-                            {
-                                std::cerr << "❌ Can't open PCM file to write\n";
-                                return;
-                            }
-                        }
-                        
-                        pcmFile.write(reinterpret_cast<const char*>(pcm_output), pcm_len);
-                        pcmFile.flush();
-                        // Can run "ffmpeg -f s16le -ar 16000 -ac 1 -i audio_data_decoded.pcm output.wav" to convert from pcm to wav
-                        //std::cout << "✅ Write PCM: " << pcm_len << " bytes\n";
-                        // Send audio data to client
-                        pcmServer.sendAudioPCM((uint8_t*)pcm_output, pcm_len);
-                    }
-                    else
-                    {
-                        std::cerr << "❌ mSBC decode failed, error code: " << result << std::endl;
-                    }
-                }
+                // Audio only flows while the AI key is held; the first report is the press
+                AiButton& button = aiButton(dev, context);
+                if (button.pressed() || !transKeyPressed)
+                    button.keyDown();
+                
+                // Decoded from the long press until the release
+                if (context->recording)
+                    HandleAudioFrames(dev, context, frames, frameCount, data + length);
             }
         }
         else if (usagePage == 0x0c && length == 1 && data[0] == 0x00 && !transKeyPressed)
         {
             // Release AI key
-            if (aiKeyPressed)
-            {
-                struct timespec releaseTime;
-                clock_gettime(CLOCK_MONOTONIC, &releaseTime);
-                double duration = (releaseTime.tv_sec - pressTime.tv_sec) + (releaseTime.tv_nsec - pressTime.tv_nsec) / 1e9;
-                //std::cout << "duration = " << duration << "s" << std::endl;
-                if (duration >= 1)
-                {
-                    std::cout << "🎤 audio data ends" << std::endl;
-                    recording = false;
-                    pcmServer.sendKeyboard(32, 0, 2);  // Send release AI key event to client
-                }
-                else
-                {
-                    std::cout << "🖱️ Click AI key, send it to client" << std::endl;
-                    pcmServer.sendKeyboard(32, 0, 0);
-                }
-                aiKeyPressed = false;
-            }
+            if (context->aiButton)
+                context->aiButton->keyUp();
         }
     }
 }
 
-int main()
+// Whole input report: the backend has already split it into the element
+// values that changed, so each report is walked once
+void HandleReport(HidDeviceRef dev, void* context, const HidInputValue* values, size_t count) {
+    auto* deviceContext = static_cast<DeviceContext*>(context);
+    if (!deviceContext)
+        return;
+    for (size_t i = 0; i < count; ++i) {
+        HandleInput(dev, deviceContext, values[i].usagePage, values[i].usage, values[i].data, values[i].length);
+    }
+}
+
+static void printUsage(const char* argv0) {
+    std::cout << "Usage: " << argv0 << " [--record <capture>] [--replay <capture> [--speed <x>|max]]\n"
+              << "       [--archive <file>] [--catalog <db>]\n"
+              << "       [--jitter-buffer <ms> [--jitter-max <ms>] [--jitter-fixed]]\n"
+              << "       [--report-layout <pid>:<frames>[:<offset>[:<stride>]]]...\n"
+              << "       [--lc3 <pid>:<rate>:<frame_us>:<bytes>]...\n"
+              << "  --record         write all HID input to a capture file while running\n"
+              << "  --archive        keep the encoded audio of every voice session in an indexed\n"
+              << "                   archive, see tools/archive.cpp to list and extract it\n"
+              << "  --catalog        record every voice session (device, times, loss and CRC counts,\n"
+              << "                   archive file) in a SQLite catalog, see tools/catalog.cpp\n"
+              << "  --replay         feed a capture file through the pipeline instead of live HID\n"
+              << "  --speed          replay speed, 1 = real time (default), max = as fast as possible\n"
+              << "  --jitter-buffer  re-time audio onto a steady 7.5 ms clock, starting <ms> behind\n"
+              << "  --jitter-max     most delay the adaptive jitter buffer may add (default 120)\n"
+              << "  --jitter-fixed   keep the jitter buffer delay at --jitter-buffer\n"
+              << "  --report-layout  mSBC frames per audio report of product <pid> (hex), first H2\n"
+              << "                   header at <offset>, one every <stride> bytes (default 59);\n"
+              << "                   0 frames scans every report for frames\n"
+              << "  --lc3            product <pid> (hex) sends LC3 at <rate> Hz, 7500 or 10000 us\n"
+              << "                   frames of <bytes> each, after the same 0x01/H2 header as mSBC;\n"
+              << "                   give it after --report-layout to keep its frames and offset\n";
+}
+
+int main(int argc, char* argv[])
 {
+    std::string recordPath, replayPath, catalogPath;
+    double replaySpeed = 1.0;
+    bool jitterBuffer = false;
+    JitterOptions jitterOptions;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (arg == "--archive" && i + 1 < argc) {
+            archivePath = argv[++i];
+        } else if (arg == "--catalog" && i + 1 < argc) {
+            catalogPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--speed" && i + 1 < argc) {
+            std::string speed = argv[++i];
+            replaySpeed = speed == "max" ? 0.0 : std::atof(speed.c_str());
+            if (replaySpeed < 0) replaySpeed = 1.0;
+        } else if (arg == "--jitter-buffer" && i + 1 < argc) {
+            jitterBuffer = true;
+            jitterOptions.targetDelayMs = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--jitter-max" && i + 1 < argc) {
+            jitterOptions.maxDelayMs = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--jitter-fixed") {
+            jitterOptions.adaptive = false;
+        } else if (arg == "--report-layout" && i + 1 < argc) {
+            uint16_t productId = 0;
+            AudioReportLayout layout;
+            if (!parseAudioReportLayout(argv[++i], &productId, &layout)) {
+                std::cerr << "❌ Bad --report-layout: " << argv[i] << std::endl;
+                return -1;
+            }
+            setAudioReportLayout(productId, layout);
+        } else if (arg == "--lc3" && i + 1 < argc) {
+            uint16_t productId = 0;
+            AudioFormat format;
+            if (!parseLc3Format(argv[++i], &productId, &format)) {
+                std::cerr << "❌ Bad --lc3: " << argv[i] << std::endl;
+                return -1;
+            }
+            setLc3Format(productId, format);
+            // No syncword to scan for: slots are exactly the H2 header and the frame
+            AudioReportLayout layout = audioReportLayoutForProduct(productId);
+            layout.frameCount = std::max<size_t>(layout.frameCount, 1);
+            layout.frameStride = 2 + format.frameLength;
+            layout.scannable = false;
+            setAudioReportLayout(productId, layout);
+        } else {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : -1;
+        }
+    }
+
+#ifdef __linux__
+    // Headless service: SIGINT/SIGTERM stop the HID loop so the server shuts
+    // down cleanly. Blocked before any thread starts so only sigwait sees them.
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+#endif
+
     // === start TCP server ===
     if (!pcmServer.start()) {
         std::cerr << "Failed to start PCM TCP server.\n";
@@ -421,92 +713,133 @@ int main()
         std::cout << "📡 New TCP client connected, send current devices..." << std::endl;
         sendCurrentDevices();
     });
+    pcmServer.setLatencyStatsProvider([]() {
+        return decoderPool.latencyStatsJson();
+    });
+    pcmServer.setDeviceStatsProvider([]() {
+        return decoderPool.deviceStatsJson();
+    });
+    pcmServer.setResumeProvider([](uint64_t fromSeq, const std::string& deviceId, int sampleRate, PCMServer::ResumeBatch& batch) {
+        std::vector<AudioHistory::Frame> frames;
+        if (!decoderPool.resumeFrames(deviceId, fromSeq, &batch.deviceId, frames, &batch.complete))
+            return false;
+        
+        // History is 16 kHz; other rates get a resampler of their own for the batch
+        ResamplerState resampler;
+        if (sampleRate != SAMPLE_RATE && resample_init(&resampler, SAMPLE_RATE, sampleRate) != 0)
+            return false;
+        std::vector<int16_t> resampled;
+        for (auto &frame : frames) {
+            const uint8_t* data = (const uint8_t*)frame.pcm;
+            size_t length = frame.length;
+            if (sampleRate != SAMPLE_RATE) {
+                size_t samples = frame.length / sizeof(int16_t);
+                resampled.resize(resample_max_output(&resampler, samples));
+                size_t n = resample_process(&resampler, frame.pcm, samples, resampled.data(), resampled.size());
+                data = (const uint8_t*)resampled.data();
+                length = n * sizeof(int16_t);
+            }
+            batch.messages += PCMServer::buildAudioMessage(batch.deviceId, data, length, sampleRate, frame.seq, frame.concealed);
+        }
+        if (!frames.empty()) {
+            batch.firstSeq = frames.front().seq;
+            batch.lastSeq = frames.back().seq;
+        }
+        batch.frames = frames.size();
+        return true;
+    });
     
-    // === initialize HID Manager ===
-    IOHIDManagerRef hidManager = IOHIDManagerCreate(kCFAllocatorDefault, kIOHIDOptionsTypeNone);
-    if (!hidManager)
-    {
-        std::cerr << "Failed to create IOHIDManager\n";
-        pcmServer.sendStatusMessage("HID_MANAGER_ERROR: Failed to create HID Manager");
+    if (!archivePath.empty()) {
+        audioArchive = std::make_unique<AudioArchiveWriter>();
+        if (!audioArchive->open(archivePath)) {
+            pcmServer.stop();
+            return -1;
+        }
+        std::cout << "🗄️ Archiving voice sessions to " << archivePath << std::endl;
     }
-    else
-    {
-        IOReturn ret = IOHIDManagerOpen(hidManager, kIOHIDOptionsTypeNone);
-        if (ret != kIOReturnSuccess)
-        {
-            std::cerr << "❌ Failed to open HID Manager: Input Monitoring permission required\n";
-            pcmServer.sendStatusMessage("HID_MANAGER_ERROR: Input Monitoring permission denied");
+    if (!catalogPath.empty()) {
+        sessionCatalog = std::make_unique<SessionCatalog>();
+        if (!sessionCatalog->open(catalogPath)) {
+            pcmServer.stop();
+            return -1;
         }
-        else
-        {
-            std::cout << "HID Manager opened successfully\n";
-            
-            int vendorID = 0x248A;
-            int productID_BT_Mouse = 0x8266;  // Bluetooth Mouse PID
-            int productID_BT_KB = 0x8208;  // Bluetooth Keyboard PID
-            int productID_USB = 0xCA10; // 2.4G PID
-            
-            CFNumberRef vidRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &vendorID);
-            
-            CFMutableDictionaryRef dictBTMouse = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
-            CFNumberRef pidRefBTMouse = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &productID_BT_Mouse);
-            CFDictionarySetValue(dictBTMouse, CFSTR(kIOHIDVendorIDKey), vidRef);
-            CFDictionarySetValue(dictBTMouse, CFSTR(kIOHIDProductIDKey), pidRefBTMouse);
-            
-            CFMutableDictionaryRef dictBTKB = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
-            CFNumberRef pidRefBTKB = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &productID_BT_KB);
-            CFDictionarySetValue(dictBTKB, CFSTR(kIOHIDVendorIDKey), vidRef);
-            CFDictionarySetValue(dictBTKB, CFSTR(kIOHIDProductIDKey), pidRefBTKB);
-            
-            CFMutableDictionaryRef dictUSB = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
-            CFNumberRef pidRefUSB = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &productID_USB);
-            CFDictionarySetValue(dictUSB, CFSTR(kIOHIDVendorIDKey), vidRef);
-            CFDictionarySetValue(dictUSB, CFSTR(kIOHIDProductIDKey), pidRefUSB);
-            
-            // 放到数组里
-            const void* dicts[3] = { dictBTMouse, dictBTKB, dictUSB };
-            CFArrayRef matchingArray = CFArrayCreate(kCFAllocatorDefault, dicts, 3, &kCFTypeArrayCallBacks);
-            
-            // 设置匹配多个设备
-            IOHIDManagerSetDeviceMatchingMultiple(hidManager, matchingArray);
-            
-            // 清理
-            CFRelease(vidRef);
-            CFRelease(pidRefBTMouse);
-            CFRelease(pidRefBTKB);
-            CFRelease(pidRefUSB);
-            CFRelease(dictBTMouse);
-            CFRelease(dictBTKB);
-            CFRelease(dictUSB);
-            
-            // register device connect/remove callbacks
-            IOHIDManagerRegisterDeviceMatchingCallback(hidManager, DeviceConnectedCallback, nullptr);
-            IOHIDManagerRegisterDeviceRemovalCallback(hidManager, DeviceRemovedCallback, nullptr);
-            CFRelease(matchingArray);
-            
-            IOHIDManagerRegisterInputValueCallback(hidManager, HandleInput, nullptr);
-            IOHIDManagerScheduleWithRunLoop(hidManager, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
+        std::cout << "🗂️ Cataloguing voice sessions in " << catalogPath << std::endl;
+    }
+
+    audioPipeline.onEncodedFrame = recordEncodedFrame;
+    audioPipeline.onDecodedFrame = dumpDecodedFrame;
+
+    if (jitterBuffer) {
+        jitterOptions.maxDelayMs = std::max(jitterOptions.maxDelayMs, jitterOptions.targetDelayMs);
+        jitterPlayout = std::make_unique<JitterPlayout>(jitterOptions, [](const JitterBuffer::Frame& frame) {
+            audioPipeline.playout(frame);
+        });
+        jitterPlayout->start();
+        decoderPool.jitterPlayout = jitterPlayout.get();
+    }
+    
+    // === initialize HID backend ===
+    const uint16_t vendorID = 0x248A;
+    const uint16_t productID_BT_Mouse = 0x8266;  // Bluetooth Mouse PID
+    const uint16_t productID_BT_KB = 0x8208;  // Bluetooth Keyboard PID
+    const uint16_t productID_USB = 0xCA10; // 2.4G PID
+    
+    HidBackend::Callbacks callbacks;
+    callbacks.deviceConnected = DeviceConnectedCallback;
+    callbacks.deviceRemoved = DeviceRemovedCallback;
+    callbacks.inputReport = HandleReport;
+    
+    if (!replayPath.empty()) {
+        std::cout << "▶️ Replaying " << replayPath << " at " << (replaySpeed > 0 ? std::to_string(replaySpeed) + "x" : std::string("max speed")) << std::endl;
+        hidBackend = createReplayHidBackend(replayPath, replaySpeed);
+    } else {
+        hidBackend = createHidBackend();
+    }
+    if (!recordPath.empty()) {
+        hidBackend = createRecordingHidBackend(std::move(hidBackend), recordPath);
+    }
+    if (!hidBackend->open(vendorID, {productID_BT_Mouse, productID_BT_KB, productID_USB}, callbacks))
+    {
+        pcmServer.sendStatusMessage("HID_MANAGER_ERROR: Input Monitoring permission denied");
+        if (!replayPath.empty()) {
+            pcmServer.stop();
+            return -1;
         }
     }
 
-    /*IOReturn ret = IOHIDManagerOpen(hidManager, kIOHIDOptionsTypeNone);
-    if (ret != kIOReturnSuccess) {
-        std::cerr << "Failed to open HID Manager\n";
-        return -1;
-    }*/
+#ifdef __linux__
+    std::thread signalThread([&stopSignals]() {
+        int sig = 0;
+        sigwait(&stopSignals, &sig);
+        std::cout << "Received signal " << sig << ", stopping..." << std::endl;
+        hidBackend->stop();
+    });
+    signalThread.detach();
+#endif
 
     std::cout << "Listening for HID input and BLE audio...\n";
     
-    CFRunLoopRun();
+    hidBackend->run();
 
     // ==== Terminate and cleanup ===
     /*if (pcmFile.is_open()) {
         pcmFile.close();
     }*/
     
+    if (jitterPlayout)
+        jitterPlayout->stop();
     pcmServer.stop(); // stop TCP server
 
-    CFRelease(hidManager);
+    for (auto& entry : deviceContexts) {
+        endCatalogSession(entry.second.get());
+        endArchiveSession(entry.second.get());
+    }
+    if (audioArchive)
+        audioArchive->close();
+    if (sessionCatalog)
+        sessionCatalog->close();
+    deviceContexts.clear();     // AiButton timers belong to the backend
+    hidBackend.reset();
     
     return 0;
 }
@@ -0,0 +1,111 @@
+//
+//  msbc_scan.c
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "msbc_scan.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MSBC_SCAN_USE_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MSBC_SCAN_USE_NEON
+#endif
+
+// Same test as h2SequenceNumber() in DecoderPool.h: SN0 and SN1 each sent twice
+static int h2_valid(uint8_t h2) {
+    uint8_t sn0 = (h2 >> 4) & 0x3, sn1 = (h2 >> 6) & 0x3;
+    return (h2 & 0x0F) == 0x08 && (sn0 == 0 || sn0 == 0x3) && (sn1 == 0 || sn1 == 0x3);
+}
+
+// data[sync] is 0xAD; is it the start of a whole H2-framed mSBC frame?
+static int frame_at(const uint8_t *data, size_t length, size_t sync) {
+    return sync >= 2 && sync - 2 + MSBC_H2_FRAME_LEN <= length &&
+           data[sync - 2] == 0x01 && h2_valid(data[sync - 1]) &&
+           data[sync + 1] == 0x00 && data[sync + 2] == 0x00;
+}
+
+#if defined(MSBC_SCAN_USE_SSE2)
+
+// Bit i set if data[i] is the syncword, for 16 bytes
+static inline uint32_t sync_mask16(const uint8_t *data) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)data);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)MSBC_SYNCWORD)));
+}
+
+const char *msbc_scan_get_implementation_info(void) {
+    return "sse2";
+}
+
+#elif defined(MSBC_SCAN_USE_NEON)
+
+static inline uint32_t sync_mask16(const uint8_t *data) {
+    uint8x16_t eq = vceqq_u8(vld1q_u8(data), vdupq_n_u8(MSBC_SYNCWORD));
+    // Narrow to 4 bits per byte, then keep one bit of each nibble
+    uint64_t nibbles = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    uint32_t mask = 0;
+    for (int i = 0; i < 16; ++i) {
+        mask |= (uint32_t)((nibbles >> (4 * i)) & 1) << i;
+    }
+    return mask;
+}
+
+const char *msbc_scan_get_implementation_info(void) {
+    return "neon";
+}
+
+#else
+
+static inline uint32_t sync_mask16(const uint8_t *data) {
+    uint32_t mask = 0;
+    for (int i = 0; i < 16; ++i) {
+        if (data[i] == MSBC_SYNCWORD) mask |= 1u << i;
+    }
+    return mask;
+}
+
+const char *msbc_scan_get_implementation_info(void) {
+    return "scalar";
+}
+
+#endif
+
+size_t msbc_scan_frames(const uint8_t *data, size_t length, size_t *offsets, size_t max_offsets) {
+    size_t found = 0;
+    size_t pos = 2;         // the syncword is never in the first two bytes
+    while (found < max_offsets && pos + MSBC_H2_FRAME_LEN - 2 <= length) {
+        size_t hit = 0;
+        int have_hit = 0;
+
+        // 16 bytes at a time while they're all in the buffer, the tail one by one
+        while (pos + 16 <= length) {
+            uint32_t mask = sync_mask16(data + pos);
+            while (mask) {
+                int bit = __builtin_ctz(mask);
+                if (frame_at(data, length, pos + bit)) {
+                    hit = pos + bit;
+                    have_hit = 1;
+                    break;
+                }
+                mask &= mask - 1;
+            }
+            if (have_hit) break;
+            pos += 16;
+        }
+        for (; !have_hit && pos < length; ++pos) {
+            if (data[pos] == MSBC_SYNCWORD && frame_at(data, length, pos)) {
+                hit = pos;
+                have_hit = 1;
+            }
+        }
+        if (!have_hit)
+            break;
+
+        offsets[found++] = hit - 2;
+        pos = hit + MSBC_H2_FRAME_LEN;      // next frame's syncword at the earliest
+    }
+    return found;
+}
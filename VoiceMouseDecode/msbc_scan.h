@@ -0,0 +1,38 @@
+//
+//  msbc_scan.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#ifndef MSBC_SCAN_H
+#define MSBC_SCAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MSBC_FRAME_LEN      57      // encoded mSBC frame
+#define MSBC_H2_FRAME_LEN   59      // with the 2-byte HFP H2 header in front
+#define MSBC_SYNCWORD       0xAD
+
+/*
+ * Finds H2-framed mSBC frames in a buffer of unknown layout: 0x01, a valid
+ * H2 sequence byte (0x08/0x38/0xC8/0xF8), then the mSBC header 0xAD 0x00
+ * 0x00. The syncword search is vectorized; each hit is checked in scalar
+ * code and the next search starts after the frame it found. Writes the
+ * offsets of the H2 headers, in order, and returns how many were found
+ * (at most max_offsets). Only frames that fit entirely are returned.
+ */
+size_t msbc_scan_frames(const uint8_t *data, size_t length, size_t *offsets, size_t max_offsets);
+
+const char *msbc_scan_get_implementation_info(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MSBC_SCAN_H
@@ -0,0 +1,298 @@
+//
+//  noise_suppress.c
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "noise_suppress.h"
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define NS_USE_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NS_USE_NEON
+#endif
+
+#define PI 3.141592653589793
+
+#define NS_FFT_HALF     NS_HOP          // complex FFT length after packing real input
+#define NS_PSD_SMOOTH   0.85f           // periodogram smoothing
+#define NS_MIN_BIAS     1.5f            // minimum statistics bias compensation
+#define NS_DD_ALPHA     0.98f           // decision-directed a-priori SNR smoothing
+#define NS_GAIN_FLOOR   0.178f          // -15 dB, limits musical noise
+
+/*
+ * Radix-2 butterflies on split re/im arrays. Within a stage of half-size h the
+ * butterflies j = 0..h-1 are independent and contiguous, so stages with h >= 4
+ * run four of them per vector.
+ */
+#if defined(NS_USE_SSE)
+
+static void fft_stage_vec(float *re, float *im, const float *wr, const float *wi, size_t h) {
+    for (size_t j = 0; j < h; j += 4) {
+        __m128 ar = _mm_loadu_ps(re + j), ai = _mm_loadu_ps(im + j);
+        __m128 br = _mm_loadu_ps(re + j + h), bi = _mm_loadu_ps(im + j + h);
+        __m128 cr = _mm_loadu_ps(wr + j), ci = _mm_loadu_ps(wi + j);
+        __m128 tr = _mm_sub_ps(_mm_mul_ps(br, cr), _mm_mul_ps(bi, ci));
+        __m128 ti = _mm_add_ps(_mm_mul_ps(br, ci), _mm_mul_ps(bi, cr));
+        _mm_storeu_ps(re + j, _mm_add_ps(ar, tr));
+        _mm_storeu_ps(im + j, _mm_add_ps(ai, ti));
+        _mm_storeu_ps(re + j + h, _mm_sub_ps(ar, tr));
+        _mm_storeu_ps(im + j + h, _mm_sub_ps(ai, ti));
+    }
+}
+
+const char *noise_suppress_get_implementation_info(void) {
+    return "sse";
+}
+
+#elif defined(NS_USE_NEON)
+
+static void fft_stage_vec(float *re, float *im, const float *wr, const float *wi, size_t h) {
+    for (size_t j = 0; j < h; j += 4) {
+        float32x4_t ar = vld1q_f32(re + j), ai = vld1q_f32(im + j);
+        float32x4_t br = vld1q_f32(re + j + h), bi = vld1q_f32(im + j + h);
+        float32x4_t cr = vld1q_f32(wr + j), ci = vld1q_f32(wi + j);
+        float32x4_t tr = vmlsq_f32(vmulq_f32(br, cr), bi, ci);
+        float32x4_t ti = vmlaq_f32(vmulq_f32(br, ci), bi, cr);
+        vst1q_f32(re + j, vaddq_f32(ar, tr));
+        vst1q_f32(im + j, vaddq_f32(ai, ti));
+        vst1q_f32(re + j + h, vsubq_f32(ar, tr));
+        vst1q_f32(im + j + h, vsubq_f32(ai, ti));
+    }
+}
+
+const char *noise_suppress_get_implementation_info(void) {
+    return "neon";
+}
+
+#else
+
+static void fft_stage_vec(float *re, float *im, const float *wr, const float *wi, size_t h) {
+    for (size_t j = 0; j < h; ++j) {
+        float tr = re[j + h] * wr[j] - im[j + h] * wi[j];
+        float ti = re[j + h] * wi[j] + im[j + h] * wr[j];
+        re[j + h] = re[j] - tr;
+        im[j + h] = im[j] - ti;
+        re[j] += tr;
+        im[j] += ti;
+    }
+}
+
+const char *noise_suppress_get_implementation_info(void) {
+    return "scalar";
+}
+
+#endif
+
+// In-place forward FFT of NS_FFT_HALF points; input must be in bit-reversed order
+static void fft_half(float *re, float *im, const NoiseSuppressorState *state) {
+    // h = 1: twiddle is 1
+    for (size_t k = 0; k < NS_FFT_HALF; k += 2) {
+        float tr = re[k + 1], ti = im[k + 1];
+        re[k + 1] = re[k] - tr;
+        im[k + 1] = im[k] - ti;
+        re[k] += tr;
+        im[k] += ti;
+    }
+    // h = 2: twiddles 1 and -i
+    for (size_t k = 0; k < NS_FFT_HALF; k += 4) {
+        float tr = re[k + 2], ti = im[k + 2];
+        re[k + 2] = re[k] - tr;
+        im[k + 2] = im[k] - ti;
+        re[k] += tr;
+        im[k] += ti;
+
+        tr = im[k + 3];
+        ti = -re[k + 3];
+        re[k + 3] = re[k + 1] - tr;
+        im[k + 3] = im[k + 1] - ti;
+        re[k + 1] += tr;
+        im[k + 1] += ti;
+    }
+    for (size_t h = 4; h < NS_FFT_HALF; h <<= 1) {
+        for (size_t k = 0; k < NS_FFT_HALF; k += 2 * h) {
+            fft_stage_vec(re + k, im + k, state->tw_re + h - 1, state->tw_im + h - 1, h);
+        }
+    }
+}
+
+static void update_noise_estimate(NoiseSuppressorState *state) {
+    for (int k = 0; k < NS_BINS; ++k) {
+        float p = state->x_re[k] * state->x_re[k] + state->x_im[k] * state->x_im[k];
+        state->psd[k] = (state->frames == 0) ? p : NS_PSD_SMOOTH * state->psd[k] + (1.0f - NS_PSD_SMOOTH) * p;
+        if (state->psd[k] < state->act_min[k]) state->act_min[k] = state->psd[k];
+    }
+
+    // Close a sub-window: store its minimum and start the next one
+    if (++state->sub_frame == NS_MIN_SUBFRAMES) {
+        memcpy(state->sub_min[state->sub_index], state->act_min, sizeof(state->act_min));
+        state->sub_index = (state->sub_index + 1) % NS_MIN_SUBWINDOWS;
+        state->sub_frame = 0;
+        for (int k = 0; k < NS_BINS; ++k) state->act_min[k] = FLT_MAX;
+    }
+
+    for (int k = 0; k < NS_BINS; ++k) {
+        float m = state->act_min[k];
+        for (int u = 0; u < NS_MIN_SUBWINDOWS; ++u) {
+            if (state->sub_min[u][k] < m) m = state->sub_min[u][k];
+        }
+        // act_min is FLT_MAX right after a sub-window closes; fall back to the psd
+        if (m == FLT_MAX) m = state->psd[k];
+        state->noise[k] = NS_MIN_BIAS * m;
+    }
+}
+
+static void apply_wiener_gain(NoiseSuppressorState *state) {
+    for (int k = 0; k < NS_BINS; ++k) {
+        float p = state->x_re[k] * state->x_re[k] + state->x_im[k] * state->x_im[k];
+        float n = state->noise[k] + 1e-3f;
+        float gamma = p / n;
+        float ml = gamma > 1.0f ? gamma - 1.0f : 0.0f;
+        float xi = NS_DD_ALPHA * state->prev_clean[k] / n + (1.0f - NS_DD_ALPHA) * ml;
+        float g = xi / (1.0f + xi);
+        if (g < NS_GAIN_FLOOR) g = NS_GAIN_FLOOR;
+
+        state->gain[k] = g;
+        state->prev_clean[k] = g * g * p;
+        state->x_re[k] *= g;
+        state->x_im[k] *= g;
+    }
+}
+
+static void process_frame(NoiseSuppressorState *state, int update_noise) {
+    float *zr = state->z_re, *zi = state->z_im;
+    const float *w = state->window;
+
+    // Pack the windowed real frame as NS_FFT_HALF complex points, bit-reversed
+    for (int n = 0; n < NS_FFT_HALF; ++n) {
+        int r = state->bitrev[n];
+        zr[r] = state->in_buf[2 * n] * w[2 * n];
+        zi[r] = state->in_buf[2 * n + 1] * w[2 * n + 1];
+    }
+    fft_half(zr, zi, state);
+
+    // Split into the NS_BINS bins of the real spectrum
+    for (int k = 0; k < NS_BINS; ++k) {
+        int a = k % NS_FFT_HALF, b = (NS_FFT_HALF - k) % NS_FFT_HALF;
+        float fer = 0.5f * (zr[a] + zr[b]), fei = 0.5f * (zi[a] - zi[b]);
+        float for_ = 0.5f * (zi[a] + zi[b]), foi = -0.5f * (zr[a] - zr[b]);
+        state->x_re[k] = fer + state->pw_re[k] * for_ - state->pw_im[k] * foi;
+        state->x_im[k] = fei + state->pw_re[k] * foi + state->pw_im[k] * for_;
+    }
+
+    // Silence pushed in by noise_suppress_flush would drag the minimum to zero
+    if (update_noise)
+        update_noise_estimate(state);
+    apply_wiener_gain(state);
+    state->frames++;
+
+    // Merge back into NS_FFT_HALF complex points; conjugate for the inverse
+    for (int k = 0; k < NS_FFT_HALF; ++k) {
+        int c = NS_FFT_HALF - k;
+        float xr = state->x_re[k], xi = state->x_im[k];
+        float cr = state->x_re[c], ci = -state->x_im[c];
+        float fer = 0.5f * (xr + cr), fei = 0.5f * (xi + ci);
+        float dr = 0.5f * (xr - cr), di = 0.5f * (xi - ci);
+        // Fo = d * conj(W^k)
+        float for_ = dr * state->pw_re[k] + di * state->pw_im[k];
+        float foi = di * state->pw_re[k] - dr * state->pw_im[k];
+        int r = state->bitrev[k];
+        zr[r] = fer - foi;
+        zi[r] = -(fei + for_);
+    }
+    fft_half(zr, zi, state);
+
+    const float scale = 1.0f / NS_FFT_HALF;
+    for (int n = 0; n < NS_FFT_HALF; ++n) {
+        state->ola[2 * n] += zr[n] * scale * w[2 * n];
+        state->ola[2 * n + 1] += -zi[n] * scale * w[2 * n + 1];
+    }
+
+    for (int n = 0; n < NS_HOP; ++n) {
+        float y = state->ola[n];
+        if (y > 32767.0f) y = 32767.0f;
+        if (y < -32768.0f) y = -32768.0f;
+        state->out_buf[n] = (int16_t)lrintf(y);
+    }
+    memmove(state->ola, state->ola + NS_HOP, (NS_FFT_SIZE - NS_HOP) * sizeof(float));
+    memset(state->ola + NS_FFT_SIZE - NS_HOP, 0, NS_HOP * sizeof(float));
+    memmove(state->in_buf, state->in_buf + NS_HOP, (NS_FFT_SIZE - NS_HOP) * sizeof(float));
+}
+
+void noise_suppress_init(NoiseSuppressorState *state) {
+    memset(state, 0, sizeof(*state));
+
+    for (int n = 0; n < NS_FFT_SIZE; ++n) {
+        state->window[n] = (float)sqrt(0.5 - 0.5 * cos(2 * PI * n / NS_FFT_SIZE));
+    }
+    for (int h = 1; h < NS_FFT_HALF; h <<= 1) {
+        for (int j = 0; j < h; ++j) {
+            state->tw_re[h - 1 + j] = (float)cos(-PI * j / h);
+            state->tw_im[h - 1 + j] = (float)sin(-PI * j / h);
+        }
+    }
+    for (int k = 0; k < NS_BINS; ++k) {
+        state->pw_re[k] = (float)cos(-2 * PI * k / NS_FFT_SIZE);
+        state->pw_im[k] = (float)sin(-2 * PI * k / NS_FFT_SIZE);
+    }
+    for (int n = 0; n < NS_FFT_HALF; ++n) {
+        int r = 0;
+        for (int b = 1, m = n; b < NS_FFT_HALF; b <<= 1, m >>= 1) {
+            r = (r << 1) | (m & 1);
+        }
+        state->bitrev[n] = (uint8_t)r;
+    }
+
+    for (int k = 0; k < NS_BINS; ++k) {
+        state->act_min[k] = FLT_MAX;
+        for (int u = 0; u < NS_MIN_SUBWINDOWS; ++u) {
+            state->sub_min[u][k] = FLT_MAX;
+        }
+        state->gain[k] = 1.0f;
+    }
+}
+
+void noise_suppress_reset(NoiseSuppressorState *state) {
+    memset(state->in_buf, 0, sizeof(state->in_buf));
+    memset(state->ola, 0, sizeof(state->ola));
+    memset(state->out_buf, 0, sizeof(state->out_buf));
+    state->pos = 0;
+    // The previous stream's last frame says nothing about this one's first
+    memset(state->prev_clean, 0, sizeof(state->prev_clean));
+}
+
+// Without update_noise the input is replaced by silence (flush)
+static void run_stream(int16_t *data, size_t length, NoiseSuppressorState *state, int update_noise) {
+    while (length > 0) {
+        size_t n = NS_HOP - state->pos;
+        if (n > length) n = length;
+
+        float *in = state->in_buf + (NS_FFT_SIZE - NS_HOP) + state->pos;
+        for (size_t i = 0; i < n; ++i) {
+            in[i] = update_noise ? data[i] : 0.0f;
+        }
+        memcpy(data, state->out_buf + state->pos, n * sizeof(int16_t));
+
+        state->pos += n;
+        if (state->pos == NS_HOP) {
+            process_frame(state, update_noise);
+            state->pos = 0;
+        }
+        data += n;
+        length -= n;
+    }
+}
+
+void noise_suppress_buffer(int16_t *data, size_t length, NoiseSuppressorState *state) {
+    run_stream(data, length, state, 1);
+}
+
+void noise_suppress_flush(int16_t *data, size_t length, NoiseSuppressorState *state) {
+    run_stream(data, length, state, 0);
+}
@@ -0,0 +1,85 @@
+//
+//  noise_suppress.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#ifndef NOISE_SUPPRESS_H
+#define NOISE_SUPPRESS_H
+
+#include "denoise.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 256-point STFT at SAMPLE_RATE, 50% overlap (8 ms hop at 16 kHz)
+#define NS_FFT_SIZE     256
+#define NS_HOP          (NS_FFT_SIZE / 2)
+#define NS_BINS         (NS_FFT_SIZE / 2 + 1)
+
+// Output is delayed by one full analysis window
+#define NS_LATENCY      NS_FFT_SIZE
+
+// Minimum statistics search window: NS_MIN_SUBWINDOWS * NS_MIN_SUBFRAMES hops (~1.5 s)
+#define NS_MIN_SUBWINDOWS 8
+#define NS_MIN_SUBFRAMES  24
+
+/*
+ * Frame-synchronous spectral noise suppressor: minimum statistics noise
+ * estimate and a decision-directed Wiener gain. All memory, including the
+ * FFT tables, lives in the state struct, so one instance per device needs no
+ * allocation and no shared globals.
+ */
+typedef struct {
+    // streaming buffers
+    float in_buf[NS_FFT_SIZE];          // last NS_FFT_SIZE input samples
+    float ola[NS_FFT_SIZE];             // overlap-add accumulator
+    int16_t out_buf[NS_HOP];            // finished samples, read out while the next hop fills
+    size_t pos;                         // samples of the current hop already exchanged
+
+    // noise estimate (minimum statistics)
+    float psd[NS_BINS];                 // smoothed periodogram
+    float act_min[NS_BINS];             // minimum of the running sub-window
+    float sub_min[NS_MIN_SUBWINDOWS][NS_BINS];
+    int sub_frame;
+    int sub_index;
+    float noise[NS_BINS];
+
+    // Wiener gain
+    float prev_clean[NS_BINS];          // |S|^2 of the previous frame for the decision-directed SNR
+    float gain[NS_BINS];
+    uint32_t frames;
+
+    // tables, filled by noise_suppress_init
+    float window[NS_FFT_SIZE];          // sqrt-Hann, used for analysis and synthesis
+    float tw_re[NS_HOP], tw_im[NS_HOP]; // complex FFT twiddles, stage h at offset h - 1
+    float pw_re[NS_BINS], pw_im[NS_BINS]; // real-FFT split twiddles e^(-2*pi*i*k/NS_FFT_SIZE)
+    uint8_t bitrev[NS_HOP];
+
+    // scratch
+    float z_re[NS_HOP], z_im[NS_HOP];
+    float x_re[NS_BINS], x_im[NS_BINS];
+} NoiseSuppressorState;
+
+void noise_suppress_init(NoiseSuppressorState *state);
+
+// Starts a new stream: empties the delay line but keeps the noise estimate,
+// so it needn't settle again (~1.5 s) every time the stream restarts.
+void noise_suppress_reset(NoiseSuppressorState *state);
+
+// Suppresses stationary noise in place. Any block length is accepted; the
+// output is the input delayed by NS_LATENCY samples.
+void noise_suppress_buffer(int16_t *data, size_t length, NoiseSuppressorState *state);
+
+// Drains the delay line at the end of a stream: data gets the next length
+// delayed samples, as if silence followed, with the noise estimate left as is.
+void noise_suppress_flush(int16_t *data, size_t length, NoiseSuppressorState *state);
+
+const char *noise_suppress_get_implementation_info(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,182 @@
+//
+//  resample.c
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "resample.h"
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define RESAMPLE_USE_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RESAMPLE_USE_NEON
+#endif
+
+#define PI 3.141592653589793
+#define RESAMPLE_KAISER_BETA 7.0
+#define RESAMPLE_PASSBAND    0.9    // fraction of the lower Nyquist frequency kept
+
+#define HISTORY (RESAMPLE_TAPS - 1)
+
+#if defined(RESAMPLE_USE_SSE)
+
+static inline float dot(const float *c, const float *x) {
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for (int j = 0; j < RESAMPLE_TAPS; j += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(c + j), _mm_loadu_ps(x + j)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(c + j + 4), _mm_loadu_ps(x + j + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 0x55));
+    return _mm_cvtss_f32(acc0);
+}
+
+const char *resample_get_implementation_info(void) {
+    return "sse";
+}
+
+#elif defined(RESAMPLE_USE_NEON)
+
+static inline float dot(const float *c, const float *x) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    for (int j = 0; j < RESAMPLE_TAPS; j += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(c + j), vld1q_f32(x + j));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(c + j + 4), vld1q_f32(x + j + 4));
+    }
+    acc0 = vaddq_f32(acc0, acc1);
+    float32x2_t sum = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+    return vget_lane_f32(vpadd_f32(sum, sum), 0);
+}
+
+const char *resample_get_implementation_info(void) {
+    return "neon";
+}
+
+#else
+
+static inline float dot(const float *c, const float *x) {
+    float acc = 0.0f;
+    for (int j = 0; j < RESAMPLE_TAPS; ++j) {
+        acc += c[j] * x[j];
+    }
+    return acc;
+}
+
+const char *resample_get_implementation_info(void) {
+    return "scalar";
+}
+
+#endif
+
+_Static_assert(RESAMPLE_TAPS % 8 == 0, "dot() consumes 8 taps per iteration");
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static int gcd(int a, int b) {
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+int resample_init(ResamplerState *state, int in_rate, int out_rate) {
+    if (in_rate <= 0 || out_rate <= 0)
+        return -1;
+
+    int g = gcd(in_rate, out_rate);
+    int up = out_rate / g, down = in_rate / g;
+    if (up > RESAMPLE_MAX_PHASES || down > RESAMPLE_MAX_PHASES)
+        return -1;
+
+    memset(state, 0, sizeof(*state));
+    state->in_rate = in_rate;
+    state->out_rate = out_rate;
+    state->up = up;
+    state->down = down;
+    state->next = HISTORY;
+
+    // Prototype at the upsampled rate: cutoff below the lower of the two
+    // Nyquist frequencies, gain L to make up for the zero stuffing
+    int len = up * RESAMPLE_TAPS;
+    double fc = RESAMPLE_PASSBAND * 0.5 / (up > down ? up : down);
+    double center = (len - 1) / 2.0;
+    double i0_beta = bessel_i0(RESAMPLE_KAISER_BETA);
+
+    for (int i = 0; i < len; ++i) {
+        double t = i - center;
+        double sinc = (t == 0.0) ? 2 * fc : sin(2 * PI * fc * t) / (PI * t);
+        double r = t / center;
+        double w = bessel_i0(RESAMPLE_KAISER_BETA * sqrt(1.0 - r * r)) / i0_beta;
+        int phase = i % up, k = i / up;
+        state->coeffs[phase][RESAMPLE_TAPS - 1 - k] = (float)(up * sinc * w);
+    }
+    return 0;
+}
+
+size_t resample_max_output(const ResamplerState *state, size_t length) {
+    return (length * state->up) / state->down + 1;
+}
+
+static size_t process_chunk(ResamplerState *state, size_t filled, int16_t *out, size_t max_out) {
+    size_t count = 0;
+    size_t end = HISTORY + filled;
+
+    while (state->next < end && count < max_out) {
+        float y = dot(state->coeffs[state->phase], state->buf + state->next - HISTORY);
+        if (y > 32767.0f) y = 32767.0f;
+        if (y < -32768.0f) y = -32768.0f;
+        out[count++] = (int16_t)lrintf(y);
+
+        state->phase += state->down;
+        while (state->phase >= state->up) {
+            state->phase -= state->up;
+            state->next++;
+        }
+    }
+
+    // out was too small: drop the rest of this chunk rather than lose sync
+    if (state->next < end)
+        state->next = end;
+
+    memmove(state->buf, state->buf + filled, HISTORY * sizeof(float));
+    state->next -= filled;
+    return count;
+}
+
+size_t resample_process(ResamplerState *state, const int16_t *in, size_t length,
+                        int16_t *out, size_t max_out) {
+    size_t written = 0;
+
+    if (state->up == state->down) {
+        written = length < max_out ? length : max_out;
+        memcpy(out, in, written * sizeof(int16_t));
+        return written;
+    }
+
+    while (length > 0) {
+        size_t n = length < RESAMPLE_CHUNK ? length : RESAMPLE_CHUNK;
+        for (size_t i = 0; i < n; ++i) {
+            state->buf[HISTORY + i] = in[i];
+        }
+        written += process_chunk(state, n, out + written, max_out - written);
+        in += n;
+        length -= n;
+    }
+    return written;
+}
@@ -0,0 +1,53 @@
+//
+//  resample.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RESAMPLE_TAPS       24      // FIR taps per polyphase branch
+#define RESAMPLE_MAX_PHASES 3       // largest interpolation factor (16 kHz -> 48 kHz)
+#define RESAMPLE_CHUNK      256     // input samples buffered per pass
+
+/*
+ * Streaming rational (L/M) polyphase resampler for int16 mono PCM. Supports
+ * 16 kHz -> 8, 24 and 48 kHz (and 16 -> 16 as a copy). The prototype is a
+ * Kaiser-windowed sinc designed in resample_init.
+ */
+typedef struct {
+    int in_rate;
+    int out_rate;
+    int up;                     // L
+    int down;                   // M
+    int phase;                  // position of the next output between input samples, 0..L-1
+    size_t next;                // buffer index of the newest input the next output needs
+    float coeffs[RESAMPLE_MAX_PHASES][RESAMPLE_TAPS];   // per phase, reversed for a forward dot product
+    float buf[RESAMPLE_TAPS - 1 + RESAMPLE_CHUNK];      // [ history | current chunk ]
+} ResamplerState;
+
+// Returns 0, or -1 if the rate pair isn't supported
+int resample_init(ResamplerState *state, int in_rate, int out_rate);
+
+// Upper bound of output samples for length input samples
+size_t resample_max_output(const ResamplerState *state, size_t length);
+
+// Returns the number of samples written to out
+size_t resample_process(ResamplerState *state, const int16_t *in, size_t length,
+                        int16_t *out, size_t max_out);
+
+const char *resample_get_implementation_info(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -165,7 +165,7 @@ static const uint8_t crc_table[256] = {
 	0x97, 0x8A, 0xAD, 0xB0, 0xE3, 0xFE, 0xD9, 0xC4
 };
 
-static uint8_t sbc_crc8(const uint8_t *data, size_t len)
+SBC_EXPORT uint8_t sbc_crc8(const uint8_t *data, size_t len)
 {
 	uint8_t crc = 0x0f;
 	size_t i;
@@ -397,7 +397,9 @@ static void sbc_calculate_bits(const struct sbc_frame *frame, int (*bits)[8])
  * Unpacks a SBC frame at the beginning of the stream in data,
  * which has at most len bytes into frame.
  * Returns the length in bytes of the packed frame, or a negative
- * value on error. The error codes are:
+ * value on error. With header_only set (sbc_parse) it stops after the
+ * CRC check: the bit allocation alone gives the length, the samples are
+ * neither read nor dequantized. The error codes are:
  *
  *  -1   Data stream too short
  *  -2   Sync byte incorrect
@@ -405,7 +407,7 @@ static void sbc_calculate_bits(const struct sbc_frame *frame, int (*bits)[8])
  *  -4   Bitpool value out of bounds
  */
 static int sbc_unpack_frame_internal(const uint8_t *data,
-		struct sbc_frame *frame, size_t len)
+		struct sbc_frame *frame, size_t len, int header_only)
 {
 	unsigned int consumed;
 	/* Will copy the parts of the header that are relevant to crc
@@ -463,6 +465,23 @@ static int sbc_unpack_frame_internal(const uint8_t *data,
 
 	sbc_calculate_bits(frame, bits);
 
+	if (header_only) {
+		unsigned int sample_bits = 0;
+
+		for (ch = 0; ch < frame->channels; ch++) {
+			for (sb = 0; sb < frame->subbands; sb++)
+				sample_bits += bits[ch][sb];
+		}
+		sample_bits *= frame->blocks;
+
+		/* Same bound as the bit reader below checks before each bit */
+		if (sample_bits > 0 && consumed + sample_bits - 1 > len * 8)
+			return -1;
+
+		consumed += sample_bits;
+		goto done;
+	}
+
 	for (ch = 0; ch < frame->channels; ch++) {
 		for (sb = 0; sb < frame->subbands; sb++)
 			levels[ch][sb] = (1 << bits[ch][sb]) - 1;
@@ -514,6 +533,7 @@ static int sbc_unpack_frame_internal(const uint8_t *data,
 		}
 	}
 
+done:
 	if ((consumed & 0x7) != 0)
 		consumed += 8 - (consumed & 0x7);
 
@@ -521,7 +541,7 @@ static int sbc_unpack_frame_internal(const uint8_t *data,
 }
 
 static int sbc_unpack_frame(const uint8_t *data,
-		struct sbc_frame *frame, size_t len)
+		struct sbc_frame *frame, size_t len, int header_only)
 {
 	if (len < 4)
 		return -1;
@@ -575,11 +595,11 @@ static int sbc_unpack_frame(const uint8_t *data,
 			frame->bitpool > 32 * frame->subbands)
 		return -4;
 
-	return sbc_unpack_frame_internal(data, frame, len);
+	return sbc_unpack_frame_internal(data, frame, len, header_only);
 }
 
 static int msbc_unpack_frame(const uint8_t *data,
-		struct sbc_frame *frame, size_t len)
+		struct sbc_frame *frame, size_t len, int header_only)
 {
 	if (len < 4)
 		return -1;
@@ -601,7 +621,7 @@ static int msbc_unpack_frame(const uint8_t *data,
 	frame->subbands = 8;
 	frame->bitpool = 26;
 
-	return sbc_unpack_frame_internal(data, frame, len);
+	return sbc_unpack_frame_internal(data, frame, len, header_only);
 }
 
 static void sbc_decoder_init(struct sbc_decoder_state *state,
@@ -985,7 +1005,7 @@ struct sbc_priv {
 	struct SBC_ALIGNED sbc_decoder_state dec_state;
 	struct SBC_ALIGNED sbc_encoder_state enc_state;
 	int (*unpack_frame)(const uint8_t *data, struct sbc_frame *frame,
-			size_t len);
+			size_t len, int header_only);
 	ssize_t (*pack_frame)(uint8_t *data, struct sbc_frame *frame,
 			size_t len, int joint);
 };
@@ -1073,12 +1093,17 @@ SBC_EXPORT int sbc_init_msbc(sbc_t *sbc, unsigned long flags)
 
 SBC_EXPORT int sbc_reinit_msbc(sbc_t *sbc, unsigned long flags)
 {
+	struct sbc_priv *priv;
 	int err;
 
 	err = sbc_reinit(sbc, flags);
 	if (err < 0)
 		return err;
 
+	/* sbc_reinit() wiped priv, including the mSBC flag */
+	priv = sbc->priv;
+	priv->msbc = true;
+
 	sbc->frequency = SBC_FREQ_16000;
 	sbc->blocks = MSBC_BLOCKS;
 	sbc->subbands = SBC_SB_8;
@@ -1210,6 +1235,88 @@ SBC_EXPORT ssize_t sbc_parse(sbc_t *sbc, const void *input, size_t input_len)
 	return sbc_decode(sbc, input, input_len, NULL, 0, NULL);
 }
 
+/* Bytes an encoder spends on a frame with this header, as in
+ * sbc_get_frame_length() */
+static size_t sbc_frame_bytes(const struct sbc_frame *frame)
+{
+	size_t ret = 4 + (4 * frame->subbands * frame->channels) / 8;
+
+	if (frame->mode == MONO || frame->mode == DUAL_CHANNEL)
+		ret += ((frame->blocks * frame->channels * frame->bitpool) + 7) / 8;
+	else
+		ret += (((frame->mode == JOINT_STEREO ? frame->subbands : 0) +
+				frame->blocks * frame->bitpool) + 7) / 8;
+
+	return ret;
+}
+
+SBC_EXPORT ssize_t sbc_validate(sbc_t *sbc, const void *input, size_t input_len,
+			struct sbc_frame_error *errors, size_t max_errors,
+			struct sbc_validate_result *result)
+{
+	struct sbc_priv *priv;
+	struct SBC_ALIGNED sbc_frame frame;
+	const uint8_t *data = input;
+	uint8_t syncword;
+	size_t pos = 0, count = 0;
+	int framelen;
+
+	if (!sbc || !input || !result)
+		return -EIO;
+
+	priv = sbc->priv;
+	syncword = priv->msbc ? MSBC_SYNCWORD : SBC_SYNCWORD;
+	memset(result, 0, sizeof(*result));
+
+	while (pos < input_len) {
+		if (data[pos] != syncword) {
+			const uint8_t *next = memchr(data + pos, syncword,
+							input_len - pos);
+			size_t skip = next ? (size_t)(next - data) - pos :
+							input_len - pos;
+
+			result->skipped += skip;
+			pos += skip;
+			continue;
+		}
+
+		framelen = priv->unpack_frame(data + pos, &frame,
+						input_len - pos, 1);
+		if (framelen > 0) {
+			result->frames++;
+			pos += sbc_frame_bytes(&frame);
+			continue;
+		}
+
+		result->bad_frames++;
+		if (count < max_errors) {
+			errors[count].offset = pos;
+			errors[count].error = framelen;
+			count++;
+		}
+
+		/* Nothing after a truncated frame can hold another one */
+		if (framelen == -1)
+			break;
+
+		/* Only the CRC failed: the header parsed, so skip the whole
+		 * frame rather than take syncword bytes in its payload for
+		 * frames. The CRC covers the header too, so trust its length
+		 * only if the next frame starts where it says. */
+		if (framelen == -3) {
+			size_t next = pos + sbc_frame_bytes(&frame);
+
+			if (next >= input_len || data[next] == syncword) {
+				pos = next;
+				continue;
+			}
+		}
+		pos++;
+	}
+
+	return count;
+}
+
 SBC_EXPORT ssize_t sbc_decode(sbc_t *sbc, const void *input, size_t input_len,
 			void *output, size_t output_len, size_t *written)
 {
@@ -1222,7 +1329,7 @@ SBC_EXPORT ssize_t sbc_decode(sbc_t *sbc, const void *input, size_t input_len,
 
 	priv = sbc->priv;
 
-	framelen = priv->unpack_frame(input, &priv->frame, input_len);
+	framelen = priv->unpack_frame(input, &priv->frame, input_len, !output);
 
 	if (!priv->init) {
 		sbc_decoder_init(&priv->dec_state, &priv->frame);
@@ -75,8 +75,32 @@ int sbc_init_a2dp(sbc_t *sbc, unsigned long flags,
 int sbc_reinit_a2dp(sbc_t *sbc, unsigned long flags,
 					const void *conf, size_t conf_len);
 
+/* Checks ONE input block: header, scale factors and CRC, returning its
+ * length like sbc_decode() would; the samples are not unpacked */
 ssize_t sbc_parse(sbc_t *sbc, const void *input, size_t input_len);
 
+/* A frame sbc_validate() found bad: where it starts in the input and the
+ * sbc_parse() error (-1 truncated, -2 sync, -3 CRC, -4 bitpool) */
+struct sbc_frame_error {
+	size_t offset;
+	int error;
+};
+
+struct sbc_validate_result {
+	size_t frames;		/* good frames */
+	size_t bad_frames;	/* all bad frames, also those past max_errors */
+	size_t skipped;		/* bytes between frames (H2 headers, garbage) */
+};
+
+/* Walks a buffer of back-to-back frames with the sbc_parse() check, without
+ * touching the decoder state. A frame that only fails its CRC is skipped
+ * whole; after an unusable header or bytes that aren't a syncword it
+ * resyncs on the next syncword. Writes the first max_errors
+ * bad frames to errors and returns how many it wrote. */
+ssize_t sbc_validate(sbc_t *sbc, const void *input, size_t input_len,
+			struct sbc_frame_error *errors, size_t max_errors,
+			struct sbc_validate_result *result);
+
 /* Decodes ONE input block into ONE output block */
 ssize_t sbc_decode(sbc_t *sbc, const void *input, size_t input_len,
 			void *output, size_t output_len, size_t *written);
@@ -97,6 +121,9 @@ size_t sbc_get_codesize(sbc_t *sbc);
 const char *sbc_get_implementation_info(sbc_t *sbc);
 void sbc_finish(sbc_t *sbc);
 
+/* CRC-8 of the frame header bits the spec protects; len is in bits */
+uint8_t sbc_crc8(const uint8_t *data, size_t len);
+
 #ifdef __cplusplus
 }
 #endif
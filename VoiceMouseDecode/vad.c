@@ -0,0 +1,108 @@
+//
+//  vad.c
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#include "vad.h"
+#include <string.h>
+#include <math.h>
+
+#define VAD_FLOOR_FALL  0.5f    // fraction of the gap closed per frame when energy drops below the floor
+#define VAD_FLOOR_RISE  0.05f   // dB per frame the floor may creep up outside speech
+
+static int classify_frame(VadState *state, float energy_db) {
+    if (!state->initialized) {
+        state->noise_db = energy_db;
+        state->initialized = 1;
+    }
+
+    int candidate = energy_db > state->noise_db + VAD_MARGIN_DB && energy_db > VAD_MIN_DB;
+
+    if (energy_db < state->noise_db) {
+        state->noise_db += VAD_FLOOR_FALL * (energy_db - state->noise_db);
+    } else if (!state->speech && !candidate) {
+        state->noise_db += VAD_FLOOR_RISE;
+    }
+    return candidate;
+}
+
+static int end_frame(VadState *state, VadEvent *event) {
+    uint64_t frame_start = state->samples - VAD_FRAME_SAMPLES;
+    float energy_db = 10.0f * log10f((float)state->acc_energy / VAD_FRAME_SAMPLES + 1.0f);
+    int candidate = classify_frame(state, energy_db);
+
+    state->acc_energy = 0;
+    state->acc_count = 0;
+
+    if (!state->speech) {
+        if (!candidate) {
+            state->run = 0;
+            return 0;
+        }
+        if (state->run++ == 0) {
+            state->candidate_start = frame_start;
+        }
+        if (state->run < VAD_ONSET_FRAMES) {
+            return 0;
+        }
+        state->speech = 1;
+        state->run = 0;
+        state->last_speech_end = state->samples;
+        event->type = VAD_EVENT_SPEECH_START;
+        event->sample_offset = state->candidate_start;
+        return 1;
+    }
+
+    if (candidate) {
+        state->run = 0;
+        state->last_speech_end = state->samples;
+        return 0;
+    }
+    if (++state->run < VAD_HANGOVER_FRAMES) {
+        return 0;
+    }
+    state->speech = 0;
+    state->run = 0;
+    event->type = VAD_EVENT_SPEECH_END;
+    event->sample_offset = state->last_speech_end;
+    return 1;
+}
+
+void vad_init(VadState *state) {
+    memset(state, 0, sizeof(*state));
+}
+
+size_t vad_process(VadState *state, const int16_t *data, size_t length,
+                   VadEvent *events, size_t max_events) {
+    size_t count = 0;
+
+    for (size_t i = 0; i < length; ++i) {
+        state->acc_energy += (int32_t)data[i] * data[i];
+        state->samples++;
+
+        if (++state->acc_count == VAD_FRAME_SAMPLES) {
+            VadEvent event;
+            if (end_frame(state, &event) && count < max_events) {
+                events[count++] = event;
+            }
+        }
+    }
+    return count;
+}
+
+int vad_flush(VadState *state, VadEvent *event) {
+    if (!state->speech) {
+        return 0;
+    }
+    state->speech = 0;
+    state->run = 0;
+    event->type = VAD_EVENT_SPEECH_END;
+    event->sample_offset = state->samples;
+    return 1;
+}
+
+int vad_is_speech(const VadState *state) {
+    return state->speech;
+}
@@ -0,0 +1,61 @@
+//
+//  vad.h
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+
+#ifndef VAD_H
+#define VAD_H
+
+#include "denoise.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VAD_FRAME_SAMPLES   (SAMPLE_RATE / 100)    // 10 ms analysis frames
+#define VAD_MARGIN_DB       9.0f    // energy above the noise floor that counts as speech
+#define VAD_MIN_DB          30.0f   // absolute floor, ~-60 dBFS
+#define VAD_ONSET_FRAMES    3       // consecutive speech frames before SPEECH_START
+#define VAD_HANGOVER_FRAMES 30      // consecutive silent frames before SPEECH_END
+
+typedef enum {
+    VAD_EVENT_SPEECH_START = 1,
+    VAD_EVENT_SPEECH_END = 2,
+} VadEventType;
+
+typedef struct {
+    VadEventType type;
+    uint64_t sample_offset;     // samples since vad_init
+} VadEvent;
+
+typedef struct {
+    float noise_db;
+    int speech;
+    int run;                    // onset or hangover frame counter
+    uint64_t samples;           // samples consumed since vad_init
+    uint64_t candidate_start;   // first sample of the current onset run
+    uint64_t last_speech_end;   // end of the last frame classified as speech
+    int64_t acc_energy;
+    int acc_count;
+    int initialized;
+} VadState;
+
+void vad_init(VadState *state);
+
+// Feeds a block of 16 kHz PCM. Writes at most max_events events and returns
+// how many were written.
+size_t vad_process(VadState *state, const int16_t *data, size_t length,
+                   VadEvent *events, size_t max_events);
+
+// Closes an open speech segment at the current position (e.g. on key release).
+// Returns 1 and fills event if a SPEECH_END was emitted.
+int vad_flush(VadState *state, VadEvent *event);
+
+int vad_is_speech(const VadState *state);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
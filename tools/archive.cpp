@@ -0,0 +1,274 @@
+//
+//  archive.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+//  Looks into audio archives written with --archive: lists the sessions,
+//  extracts "device X from 14:03:20 for ten seconds" to WAV straight from
+//  the seek index, and checks that seeking decodes the same samples as
+//  a decode from each session's start.
+//
+//  Build (from the repo root; the codec sources are C):
+//  for f in VoiceMouseDecode/*.c; do gcc -O2 -msse2 -c $f -o build/$(basename ${f%.c}).o; done
+//  g++ -std=c++17 -O2 -msse2 -IVoiceMouseDecode -o archive tools/archive.cpp VoiceMouseDecode/AudioArchive.cpp build/*.o
+//
+//  ./archive list sessions.vma
+//  ./archive extract sessions.vma --device aa:bb:cc:dd:ee:ff --from "2026-10-19 14:03:20" --seconds 10 -o clip.wav
+//  ./archive extract sessions.vma --from +30 --to +45 -o clip.wav     # seconds after the first session
+//  ./archive verify sessions.vma --seeks 64
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <time.h>
+#include <vector>
+#include "AudioArchive.h"
+
+#define WAV_HEADER_SIZE 44
+#define VERIFY_SEEKS    32
+
+static const char* codecName(uint8_t codec) {
+    switch (codec) {
+        case AUDIO_ARCHIVE_MSBC: return "mSBC";
+        case AUDIO_ARCHIVE_SBC:  return "SBC";
+        case AUDIO_ARCHIVE_LC3:  return "LC3";
+        default:                 return "unknown";
+    }
+}
+
+// ====== 时间 ======
+// Local time with milliseconds, as the times are given on the command line
+static std::string formatTime(uint64_t ns) {
+    time_t seconds = (time_t)(ns / 1000000000ull);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+    char millis[8];
+    snprintf(millis, sizeof(millis), ".%03u", (unsigned)(ns / 1000000 % 1000));
+    return std::string(text) + millis;
+}
+
+// "YYYY-MM-DD HH:MM:SS[.fff]" (local time, 'T' works too) or "+S[.fff]",
+// seconds after baseNs
+static bool parseTime(const std::string& text, uint64_t baseNs, uint64_t* ns) {
+    if (!text.empty() && text[0] == '+') {
+        char* end = nullptr;
+        double seconds = strtod(text.c_str() + 1, &end);
+        if (*end || seconds < 0) return false;
+        *ns = baseNs + (uint64_t)(seconds * 1e9);
+        return true;
+    }
+    std::string value = text;
+    std::replace(value.begin(), value.end(), 'T', ' ');
+    struct tm local = {};
+    local.tm_isdst = -1;
+    const char* rest = strptime(value.c_str(), "%Y-%m-%d %H:%M:%S", &local);
+    if (!rest) return false;
+    double fraction = 0;
+    if (*rest == '.') {
+        char* end = nullptr;
+        fraction = strtod(rest, &end);
+        rest = end;
+    }
+    if (*rest) return false;
+    time_t seconds = mktime(&local);
+    if (seconds < 0) return false;
+    *ns = (uint64_t)seconds * 1000000000ull + (uint64_t)(fraction * 1e9);
+    return true;
+}
+
+// ====== 输出 ======
+static void putLe16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void putLe32(uint8_t* p, uint32_t v) { putLe16(p, (uint16_t)v); putLe16(p + 2, (uint16_t)(v >> 16)); }
+
+static bool writeWav(const std::string& path, const std::vector<int16_t>& pcm, int sampleRate, int channels) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    uint32_t dataBytes = (uint32_t)(pcm.size() * sizeof(int16_t));
+    uint8_t header[WAV_HEADER_SIZE];
+    memcpy(header, "RIFF", 4);
+    putLe32(header + 4, 36 + dataBytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putLe32(header + 16, 16);
+    putLe16(header + 20, 1);                        // PCM
+    putLe16(header + 22, (uint16_t)channels);
+    putLe32(header + 24, (uint32_t)sampleRate);
+    putLe32(header + 28, (uint32_t)(sampleRate * channels * sizeof(int16_t)));
+    putLe16(header + 32, (uint16_t)(channels * sizeof(int16_t)));
+    putLe16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    putLe32(header + 40, dataBytes);
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)pcm.data(), dataBytes);
+    return (bool)file;
+}
+
+// ====== 命令 ======
+static int listSessions(const AudioArchiveReader& reader) {
+    std::cout << reader.sessions().size() << " session(s)" << (reader.indexed() ? "" : ", index rebuilt") << std::endl;
+    for (auto& session : reader.sessions()) {
+        double seconds = (session.endNs - session.startNs) / 1e9;
+        std::cout << "  #" << session.id << "  " << (session.deviceId.empty() ? "(no device ID)" : session.deviceId)
+                  << "  " << formatTime(session.startNs) << "  " << std::fixed << std::setprecision(2) << seconds << " s"
+                  << "  " << session.frames << " frames  " << codecName(session.codec) << " " << session.sampleRate
+                  << " Hz x" << session.channels << std::endl;
+    }
+    return 0;
+}
+
+static int extractSessions(const AudioArchiveReader& reader, const std::string& deviceId, uint64_t fromNs,
+                           uint64_t toNs, const std::string& output) {
+    auto sessions = reader.sessionsInRange(deviceId, fromNs, toNs);
+    if (sessions.empty()) {
+        std::cerr << "❌ No session" << (deviceId.empty() ? "" : " of " + deviceId) << " between "
+                  << formatTime(fromNs) << " and " << formatTime(toNs) << std::endl;
+        return -1;
+    }
+
+    // One WAV per session: they can differ in format, and a gap between two
+    // sessions is not silence anybody recorded
+    std::string stem = output, extension;
+    size_t dot = output.rfind('.');
+    if (dot != std::string::npos && output.find('/', dot) == std::string::npos) {
+        stem = output.substr(0, dot);
+        extension = output.substr(dot);
+    }
+    int failed = 0;
+    for (auto* session : sessions) {
+        std::vector<int16_t> pcm;
+        uint64_t firstFrame = 0;
+        auto start = std::chrono::steady_clock::now();
+        if (!reader.decode(session->id, fromNs, toNs, pcm, AUDIO_ARCHIVE_WARMUP_FRAMES, &firstFrame)) {
+            failed++;
+            continue;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::string path = sessions.size() == 1 ? output : stem + "." + std::to_string(session->id) + extension;
+        if (!writeWav(path, pcm, session->sampleRate, session->channels)) {
+            std::cerr << "❌ Can't write " << path << std::endl;
+            failed++;
+            continue;
+        }
+        std::cout << "✅ #" << session->id << " " << session->deviceId << " from frame " << firstFrame << ": "
+                  << std::fixed << std::setprecision(2)
+                  << (double)pcm.size() / session->channels / session->sampleRate << " s -> " << path
+                  << " (decoded in " << ms << " ms)" << std::endl;
+    }
+    return failed ? -1 : 0;
+}
+
+// Seeks to random frames of every session and compares what decode() gives
+// with the same samples of a decode from the start
+static int verifySessions(const AudioArchiveReader& reader, size_t seeks) {
+    std::mt19937_64 random(1);
+    size_t checked = 0, mismatched = 0;
+    for (auto& session : reader.sessions()) {
+        std::vector<int16_t> whole;
+        if (session.frames == 0 || !reader.decode(session.id, 0, UINT64_MAX, whole))
+            continue;
+
+        // Where every frame starts in the whole decode: lost frames are silence in front of it
+        const size_t blockSamples = session.frameSamples * session.channels;
+        std::vector<uint64_t> timestamps;
+        std::vector<size_t> positions;
+        size_t position = 0;
+        AudioArchiveFrame frame;
+        auto it = reader.frames(session.id, 0, UINT64_MAX);
+        while (it.next(frame)) {
+            timestamps.push_back(frame.timestampNs);
+            positions.push_back(position);
+            position += (frame.lost + 1) * blockSamples;
+        }
+
+        for (size_t n = 0; n < seeks; ++n) {
+            size_t target = random() % timestamps.size();
+            // Frames can share a timestamp (one report); the seek lands on the first of them
+            while (target > 0 && timestamps[target - 1] == timestamps[target])
+                target--;
+            std::vector<int16_t> pcm;
+            uint64_t firstFrame = 0;
+            reader.decode(session.id, timestamps[target], UINT64_MAX, pcm, AUDIO_ARCHIVE_WARMUP_FRAMES, &firstFrame);
+            checked++;
+            size_t start = positions[target];
+            bool same = firstFrame == target && start + pcm.size() == whole.size() &&
+                        std::equal(pcm.begin(), pcm.end(), whole.begin() + start);
+            if (!same) {
+                mismatched++;
+                std::cerr << "❌ #" << session.id << " seek to frame " << target << " (" << formatTime(timestamps[target])
+                          << ") decodes differently" << std::endl;
+            }
+        }
+    }
+    std::cout << (mismatched ? "❌ " : "✅ ") << checked - mismatched << "/" << checked
+              << " seeks match a decode from the session start" << std::endl;
+    return mismatched ? -1 : 0;
+}
+
+static void printUsage(const char* argv0) {
+    std::cout << "Usage: " << argv0 << " list <archive>\n"
+              << "       " << argv0 << " extract <archive> [--device ID] [--from TIME] [--to TIME | --seconds S] [-o out.wav]\n"
+              << "       " << argv0 << " verify <archive> [--seeks N]\n"
+              << "  TIME       \"YYYY-MM-DD HH:MM:SS[.fff]\" local time, or +S seconds after the first session\n"
+              << "  --device   only sessions of this device (Bluetooth address as the clients see it)\n"
+              << "  -o         output WAV (default clip.wav); <name>.<session>.wav when several sessions match\n"
+              << "  --seeks    random seeks checked per session (default " << VERIFY_SEEKS << ")\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    std::string command = argv[1];
+    AudioArchiveReader reader;
+    if (!reader.open(argv[2]))
+        return -1;
+    uint64_t baseNs = reader.sessions().empty() ? 0 : reader.sessions().front().startNs;
+
+    std::string deviceId, output = "clip.wav";
+    uint64_t fromNs = 0, toNs = UINT64_MAX;
+    double seconds = -1;
+    size_t seeks = VERIFY_SEEKS;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--device" && i + 1 < argc) {
+            deviceId = argv[++i];
+        } else if ((arg == "--from" || arg == "--to") && i + 1 < argc) {
+            if (!parseTime(argv[++i], baseNs, arg == "--from" ? &fromNs : &toNs)) {
+                std::cerr << "❌ Bad time: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            seconds = std::atof(argv[++i]);
+        } else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--seeks" && i + 1 < argc) {
+            seeks = (size_t)std::max(1, std::atoi(argv[++i]));
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    if (seconds >= 0)
+        toNs = fromNs + (uint64_t)(seconds * 1e9);
+
+    if (command == "list")
+        return listSessions(reader);
+    if (command == "extract")
+        return extractSessions(reader, deviceId, fromNs, toNs, output);
+    if (command == "verify")
+        return verifySessions(reader, seeks);
+    printUsage(argv[0]);
+    return -1;
+}
@@ -0,0 +1,171 @@
+//
+//  catalog.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+//  Finds voice sessions in the SQLite catalog written with --catalog,
+//  without opening any audio: who talked when, for how long, with how
+//  much loss, and where the audio is (--archive file and session, ready
+//  for tools/archive.cpp). Safe to run while the service is writing.
+//
+//  Build (from the repo root):
+//  g++ -std=c++17 -O2 -pthread -IVoiceMouseDecode -o catalog tools/catalog.cpp VoiceMouseDecode/SessionCatalog.cpp -lsqlite3
+//
+//  ./catalog sessions.db devices
+//  ./catalog sessions.db sessions --device aa:bb:cc:dd:ee:ff --from "2026-10-19 14:00:00" --to "2026-10-19 15:00:00"
+//  ./catalog sessions.db sessions --lossy        # only sessions that lost or failed frames
+//  ./catalog sessions.db show 42
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <time.h>
+#include <vector>
+#include "SessionCatalog.h"
+
+// ====== 时间 ======
+static std::string formatTime(uint64_t ns) {
+    if (ns == 0) return "-";
+    time_t seconds = (time_t)(ns / 1000000000ull);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+    char millis[8];
+    snprintf(millis, sizeof(millis), ".%03u", (unsigned)(ns / 1000000 % 1000));
+    return std::string(text) + millis;
+}
+
+// "YYYY-MM-DD HH:MM:SS[.fff]", local time ('T' works too)
+static bool parseTime(const std::string& text, uint64_t* ns) {
+    std::string value = text;
+    std::replace(value.begin(), value.end(), 'T', ' ');
+    struct tm local = {};
+    local.tm_isdst = -1;
+    const char* rest = strptime(value.c_str(), "%Y-%m-%d %H:%M:%S", &local);
+    if (!rest) return false;
+    double fraction = 0;
+    if (*rest == '.') {
+        char* end = nullptr;
+        fraction = strtod(rest, &end);
+        rest = end;
+    }
+    if (*rest) return false;
+    time_t seconds = mktime(&local);
+    if (seconds < 0) return false;
+    *ns = (uint64_t)seconds * 1000000000ull + (uint64_t)(fraction * 1e9);
+    return true;
+}
+
+static std::string duration(const SessionRecord& session) {
+    if (session.stopMonoNs == 0) return "running";
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2) << (session.stopMonoNs - session.startMonoNs) / 1e9 << " s";
+    return text.str();
+}
+
+// ====== 命令 ======
+static void printSession(const SessionRecord& session) {
+    std::cout << "  #" << session.id << "  " << (session.deviceId.empty() ? "(no device ID)" : session.deviceId)
+              << "  " << formatTime(session.startWallNs) << "  " << duration(session) << "  " << session.frames
+              << " frames " << session.codec << "  lost " << session.lost << ", concealed " << session.concealed
+              << ", CRC " << session.crcErrors << ", decode " << session.decodeErrors;
+    if (!session.file.empty())
+        std::cout << "  -> " << session.file << " #" << session.archiveSession;
+    std::cout << std::endl;
+}
+
+static void printUsage(const char* argv0) {
+    std::cout << "Usage: " << argv0 << " <catalog> devices\n"
+              << "       " << argv0 << " <catalog> sessions [--device ID] [--from TIME] [--to TIME] [--lossy] [--limit N]\n"
+              << "       " << argv0 << " <catalog> show <id>\n"
+              << "  TIME     \"YYYY-MM-DD HH:MM:SS[.fff]\" local time\n"
+              << "  --lossy  only sessions with lost, concealed or undecodable frames\n"
+              << "  --limit  most sessions listed (default " << SESSION_CATALOG_QUERY_LIMIT << ")\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    SessionCatalog catalog;
+    if (!catalog.open(argv[1], true))
+        return -1;
+    std::string command = argv[2];
+
+    if (command == "devices") {
+        for (auto& device : catalog.devices()) {
+            std::cout << "  " << (device.first.empty() ? "(no device ID)" : device.first) << "  "
+                      << device.second << " session(s)" << std::endl;
+        }
+        return 0;
+    }
+
+    if (command == "show" && argc == 4) {
+        SessionRecord session;
+        if (!catalog.session(std::atoll(argv[3]), &session)) {
+            std::cerr << "❌ No session " << argv[3] << std::endl;
+            return -1;
+        }
+        std::cout << "session        #" << session.id << "\n"
+                  << "device         " << session.deviceId << "\n"
+                  << "codec          " << session.codec << "\n"
+                  << "start          " << formatTime(session.startWallNs) << " (monotonic " << session.startMonoNs << ")\n"
+                  << "stop           " << formatTime(session.stopWallNs) << " (monotonic " << session.stopMonoNs << ")\n"
+                  << "duration       " << duration(session) << "\n"
+                  << "frames         " << session.frames << "\n"
+                  << "lost           " << session.lost << "\n"
+                  << "duplicates     " << session.duplicates << "\n"
+                  << "concealed      " << session.concealed << "\n"
+                  << "CRC errors     " << session.crcErrors << "\n"
+                  << "decode errors  " << session.decodeErrors << "\n"
+                  << "audio          " << (session.file.empty() ? "-" : session.file + " #" + std::to_string(session.archiveSession))
+                  << std::endl;
+        return 0;
+    }
+
+    if (command != "sessions") {
+        printUsage(argv[0]);
+        return -1;
+    }
+    std::string deviceId;
+    uint64_t fromNs = 0, toNs = UINT64_MAX;
+    bool lossy = false;
+    size_t limit = SESSION_CATALOG_QUERY_LIMIT;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--device" && i + 1 < argc) {
+            deviceId = argv[++i];
+        } else if ((arg == "--from" || arg == "--to") && i + 1 < argc) {
+            if (!parseTime(argv[++i], arg == "--from" ? &fromNs : &toNs)) {
+                std::cerr << "❌ Bad time: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--lossy") {
+            lossy = true;
+        } else if (arg == "--limit" && i + 1 < argc) {
+            limit = (size_t)std::max(1, std::atoi(argv[++i]));
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    size_t shown = 0;
+    for (auto& session : catalog.sessions(deviceId, fromNs, toNs, limit)) {
+        if (lossy && session.lost + session.concealed + session.crcErrors + session.decodeErrors == 0)
+            continue;
+        printSession(session);
+        shown++;
+    }
+    std::cout << shown << " session(s)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,319 @@
+//
+//  lc3_conformance.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+//  Checks the LC3 path (lc3dec) against conformance vectors: each LC3
+//  bitstream (the .lc3/.bin format of the ETSI TS 103 634 test vectors and
+//  liblc3's tools) is decoded frame by frame through lc3dec_decode, exactly
+//  like a device's frames, and compared sample by sample with the reference
+//  decoder's WAV. A vector passes when no sample differs by more than
+//  --max-diff (default 0: bit exact). Exits 0 only if every vector passes.
+//
+//  Build (from the repo root; liblc3 is loaded at run time, LC3DEC_LIBRARY
+//  picks a specific build of it):
+//  g++ -std=c++17 -O2 -IVoiceMouseDecode -o lc3_conformance tools/lc3_conformance.cpp -x c VoiceMouseDecode/lc3dec.c -ldl -lpthread
+//
+//  ./lc3_conformance vectors/16k_10ms.lc3 vectors/16k_10ms.wav
+//  ./lc3_conformance --max-diff 1 vectors/*.lc3        # reference WAV next to each bitstream
+//  ./lc3_conformance --offset 120 --out decoded/ vectors/*.lc3
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "lc3dec.h"
+
+#define LC3_FILE_ID         0xcc1c
+#define LC3_HEADER_SIZE     18
+#define WAV_HEADER_SIZE     44
+
+struct Options {
+    int maxDiff = 0;            // largest sample difference that still passes
+    size_t offset = 0;          // decoded samples (per channel) dropped before comparing
+    std::string outDir;         // also write the decoded WAVs here
+};
+
+struct Bitstream {
+    int sampleRate = 0;
+    int frameUs = 0;
+    int channels = 0;
+    uint32_t samples = 0;       // per channel, 0 if the header doesn't say
+    std::vector<std::vector<uint8_t>> frames;
+};
+
+struct Wav {
+    int sampleRate = 0;
+    int channels = 0;
+    std::vector<int16_t> pcm;   // interleaved
+};
+
+static uint16_t getLe16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t getLe32(const uint8_t* p) { return getLe16(p) | (uint32_t)getLe16(p + 2) << 16; }
+static void putLe16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void putLe32(uint8_t* p, uint32_t v) { putLe16(p, (uint16_t)v); putLe16(p + 2, (uint16_t)(v >> 16)); }
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// ====== 读取 ======
+// header: uint16 fileId | uint16 headerSize | uint16 rate/100 | uint16 bitrate/100 |
+//         uint16 channels | uint16 frameUs/10 | uint16 epMode | uint16 samplesLow | uint16 samplesHigh
+// frame:  uint16 bytes (all channels) | bytes
+static bool readBitstream(const std::string& path, Bitstream& stream) {
+    std::vector<uint8_t> data;
+    if (!readFile(path, data)) {
+        std::cerr << "❌ Cannot read " << path << std::endl;
+        return false;
+    }
+    if (data.size() < LC3_HEADER_SIZE || getLe16(data.data()) != LC3_FILE_ID) {
+        std::cerr << "❌ " << path << " is not an LC3 bitstream" << std::endl;
+        return false;
+    }
+    size_t headerSize = getLe16(data.data() + 2);
+    stream.sampleRate = getLe16(data.data() + 4) * 100;
+    stream.channels = getLe16(data.data() + 8);
+    stream.frameUs = getLe16(data.data() + 10) * 10;
+    stream.samples = getLe16(data.data() + 14) | (uint32_t)getLe16(data.data() + 16) << 16;
+    if (getLe16(data.data() + 12) != 0) {
+        std::cerr << "❌ " << path << ": error protection mode is not supported" << std::endl;
+        return false;
+    }
+    if (headerSize < LC3_HEADER_SIZE || headerSize > data.size() || stream.channels < 1) {
+        std::cerr << "❌ " << path << ": bad header" << std::endl;
+        return false;
+    }
+
+    size_t offset = headerSize;
+    while (offset + 2 <= data.size()) {
+        size_t bytes = getLe16(data.data() + offset);
+        offset += 2;
+        if (offset + bytes > data.size()) {
+            std::cerr << "⚠️ " << path << ": truncated last frame ignored" << std::endl;
+            break;
+        }
+        stream.frames.emplace_back(data.begin() + offset, data.begin() + offset + bytes);
+        offset += bytes;
+    }
+    return true;
+}
+
+static bool readWav(const std::string& path, Wav& wav) {
+    std::vector<uint8_t> data;
+    if (!readFile(path, data) || data.size() < 12 || memcmp(data.data(), "RIFF", 4) || memcmp(data.data() + 8, "WAVE", 4)) {
+        std::cerr << "❌ " << path << " is not a WAV file" << std::endl;
+        return false;
+    }
+    bool haveFormat = false;
+    for (size_t offset = 12; offset + 8 <= data.size();) {
+        size_t size = getLe32(data.data() + offset + 4);
+        const uint8_t* body = data.data() + offset + 8;
+        size_t available = std::min(size, data.size() - offset - 8);
+        if (!memcmp(data.data() + offset, "fmt ", 4) && available >= 16) {
+            if (getLe16(body) != 1 || getLe16(body + 14) != 16) {
+                std::cerr << "❌ " << path << ": only 16-bit PCM is supported" << std::endl;
+                return false;
+            }
+            wav.channels = getLe16(body + 2);
+            wav.sampleRate = (int)getLe32(body + 4);
+            haveFormat = true;
+        } else if (!memcmp(data.data() + offset, "data", 4) && haveFormat) {
+            wav.pcm.resize(available / sizeof(int16_t));
+            for (size_t i = 0; i < wav.pcm.size(); i++)
+                wav.pcm[i] = (int16_t)getLe16(body + i * 2);
+            return true;
+        }
+        offset += 8 + size + (size & 1);
+    }
+    std::cerr << "❌ " << path << ": no PCM data" << std::endl;
+    return false;
+}
+
+static bool writeWav(const std::string& path, const std::vector<int16_t>& pcm, int sampleRate, int channels) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    uint32_t dataBytes = (uint32_t)(pcm.size() * sizeof(int16_t));
+    uint8_t header[WAV_HEADER_SIZE];
+    memcpy(header, "RIFF", 4);
+    putLe32(header + 4, 36 + dataBytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putLe32(header + 16, 16);
+    putLe16(header + 20, 1);                        // PCM
+    putLe16(header + 22, (uint16_t)channels);
+    putLe32(header + 24, (uint32_t)sampleRate);
+    putLe32(header + 28, (uint32_t)(sampleRate * channels * sizeof(int16_t)));
+    putLe16(header + 32, (uint16_t)(channels * sizeof(int16_t)));
+    putLe16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    putLe32(header + 40, dataBytes);
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)pcm.data(), dataBytes);
+    return (bool)file;
+}
+
+// ====== 解码 ======
+// One lc3dec per channel; a frame's bytes are split evenly between the
+// channels, the first ones taking the remainder (as liblc3's tools write them)
+static bool decodeBitstream(const std::string& path, const Bitstream& stream, std::vector<int16_t>& pcm) {
+    std::vector<lc3dec_t> decoders(stream.channels);
+    for (int ch = 0; ch < stream.channels; ch++) {
+        int err = lc3dec_init(&decoders[ch], stream.sampleRate, stream.frameUs);
+        if (err < 0) {
+            std::cerr << "❌ " << path << ": lc3dec_init(" << stream.sampleRate << " Hz, " << stream.frameUs
+                      << " us) failed: " << strerror(-err) << std::endl;
+            for (int i = 0; i < ch; i++) lc3dec_finish(&decoders[i]);
+            return false;
+        }
+    }
+
+    size_t frameSamples = decoders[0].frame_samples;
+    std::vector<int16_t> block(frameSamples);
+    pcm.assign(stream.frames.size() * frameSamples * stream.channels, 0);
+    size_t concealed = 0;
+    for (size_t f = 0; f < stream.frames.size(); f++) {
+        const std::vector<uint8_t>& frame = stream.frames[f];
+        size_t offset = 0;
+        for (int ch = 0; ch < stream.channels; ch++) {
+            size_t bytes = frame.size() / stream.channels + ((size_t)ch < frame.size() % stream.channels);
+            size_t written = 0;
+            ssize_t ret = frame.empty()
+                ? lc3dec_conceal(&decoders[ch], block.data(), block.size() * sizeof(int16_t), &written)
+                : lc3dec_decode(&decoders[ch], frame.data() + offset, bytes, block.data(), block.size() * sizeof(int16_t), &written);
+            if (ret == -EIO || frame.empty()) {
+                concealed++;
+            } else if (ret < 0) {
+                std::cerr << "❌ " << path << ": frame " << f << " (" << bytes << " bytes) not decodable: "
+                          << strerror((int)-ret) << std::endl;
+                for (auto& decoder : decoders) lc3dec_finish(&decoder);
+                return false;
+            }
+            for (size_t i = 0; i < written / sizeof(int16_t); i++)
+                pcm[(f * frameSamples + i) * stream.channels + ch] = block[i];
+            offset += bytes;
+        }
+    }
+    for (auto& decoder : decoders) lc3dec_finish(&decoder);
+    if (concealed)
+        std::cout << "  ⚠️ " << concealed << " frame(s) concealed" << std::endl;
+    return true;
+}
+
+// ====== 比较 ======
+static bool checkVector(const std::string& bitstreamPath, const std::string& referencePath, const Options& options) {
+    std::cout << "▶️ " << bitstreamPath << std::endl;
+    Bitstream stream;
+    Wav reference;
+    std::vector<int16_t> decoded;
+    if (!readBitstream(bitstreamPath, stream) || !readWav(referencePath, reference) ||
+        !decodeBitstream(bitstreamPath, stream, decoded))
+        return false;
+    if (reference.sampleRate != stream.sampleRate || reference.channels != stream.channels) {
+        std::cerr << "❌ " << referencePath << " is " << reference.sampleRate << " Hz x" << reference.channels
+                  << ", the bitstream " << stream.sampleRate << " Hz x" << stream.channels << std::endl;
+        return false;
+    }
+
+    size_t channels = (size_t)stream.channels;
+    size_t skip = std::min(options.offset * channels, decoded.size());
+    decoded.erase(decoded.begin(), decoded.begin() + skip);
+    if (stream.samples && decoded.size() > stream.samples * channels)
+        decoded.resize(stream.samples * channels);
+    if (!options.outDir.empty()) {
+        std::string name = bitstreamPath.substr(bitstreamPath.find_last_of('/') + 1);
+        std::string out = options.outDir + "/" + name.substr(0, name.find_last_of('.')) + ".decoded.wav";
+        if (!writeWav(out, decoded, stream.sampleRate, stream.channels))
+            std::cerr << "⚠️ Cannot write " << out << std::endl;
+    }
+
+    size_t compared = std::min(decoded.size(), reference.pcm.size());
+    int maxDiff = 0;
+    size_t maxAt = 0, differing = 0;
+    double signal = 0, noise = 0;
+    for (size_t i = 0; i < compared; i++) {
+        int diff = std::abs((int)decoded[i] - (int)reference.pcm[i]);
+        if (diff > maxDiff) { maxDiff = diff; maxAt = i; }
+        differing += diff != 0;
+        signal += (double)reference.pcm[i] * reference.pcm[i];
+        noise += (double)diff * diff;
+    }
+
+    bool lengthOk = decoded.size() == reference.pcm.size();
+    bool pass = compared > 0 && lengthOk && maxDiff <= options.maxDiff;
+    std::cout << "  " << stream.sampleRate << " Hz x" << stream.channels << ", " << stream.frameUs / 1000.0 << " ms, "
+              << stream.frames.size() << " frames, " << compared / channels << " samples compared" << std::endl;
+    if (!lengthOk)
+        std::cout << "  ⚠️ decoded " << decoded.size() / channels << " samples, reference has "
+                  << reference.pcm.size() / channels << " (see --offset)" << std::endl;
+    std::cout << "  max diff " << maxDiff;
+    if (maxDiff)
+        std::cout << " (sample " << maxAt / channels << ", channel " << maxAt % channels << "), " << differing
+                  << " sample(s) differ";
+    if (noise > 0 && signal > 0)
+        std::cout << ", SNR " << std::fixed << std::setprecision(1) << 10 * std::log10(signal / noise) << " dB";
+    std::cout << std::endl << (pass ? "  ✅ PASS" : "  ❌ FAIL") << std::endl;
+    return pass;
+}
+
+static void printUsage(const char* argv0) {
+    std::cout << "Usage: " << argv0 << " [--max-diff N] [--offset N] [--out DIR] <bitstream.lc3> <reference.wav>\n"
+              << "       " << argv0 << " [--max-diff N] [--offset N] [--out DIR] <bitstream.lc3>...\n"
+              << "  --max-diff  largest sample difference that passes (default 0, bit exact)\n"
+              << "  --offset    decoded samples dropped before comparing (decoder delay)\n"
+              << "  --out       also write the decoded WAVs to DIR\n"
+              << "  Without a reference argument each bitstream is compared with the WAV of the same name.\n";
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--max-diff" && i + 1 < argc) {
+            options.maxDiff = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--offset" && i + 1 < argc) {
+            options.offset = (size_t)std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--out" && i + 1 < argc) {
+            options.outDir = argv[++i];
+        } else if (!arg.empty() && arg[0] == '-') {
+            printUsage(argv[0]);
+            return -1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (inputs.empty()) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    std::cout << "LC3 decoder: " << lc3dec_get_implementation_info() << std::endl;
+
+    // <bitstream> <reference.wav>, or bitstreams with their WAVs next to them
+    std::vector<std::pair<std::string, std::string>> vectors;
+    auto isWav = [](const std::string& path) { return path.size() > 4 && path.compare(path.size() - 4, 4, ".wav") == 0; };
+    if (inputs.size() == 2 && isWav(inputs[1])) {
+        vectors.emplace_back(inputs[0], inputs[1]);
+    } else {
+        for (auto& input : inputs)
+            vectors.emplace_back(input, input.substr(0, input.find_last_of('.')) + ".wav");
+    }
+
+    size_t passed = 0;
+    for (auto& vector : vectors)
+        passed += checkVector(vector.first, vector.second, options);
+    std::cout << passed << "/" << vectors.size() << " vector(s) passed" << std::endl;
+    return passed == vectors.size() ? 0 : 1;
+}
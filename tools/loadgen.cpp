@@ -0,0 +1,442 @@
+//
+//  loadgen.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+//  Synthetic multi-device load generator: N simulated mice each send HID
+//  audio reports of one or more mSBC frames every 7.5 ms per frame (with
+//  jitter and loss) into the service's own audio path, AudioPipeline: H2
+//  tracking, codec detection, decode and DSP, VAD pre-roll and silence
+//  suppression, per-client resampling, resume history and the jitter buffer.
+//  Local TCP clients drain the server so serialization and socket writes
+//  are measured too.
+//
+//  Build (from the repo root; the codec/DSP sources are C):
+//  for f in VoiceMouseDecode/*.c; do gcc -O2 -msse2 -c $f -o build/$(basename ${f%.c}).o; done
+//  g++ -std=c++17 -O2 -msse2 -pthread -IVoiceMouseDecode -I<nlohmann include dir> -o loadgen
+//      tools/loadgen.cpp VoiceMouseDecode/AudioPipeline.cpp VoiceMouseDecode/AudioReportLayout.cpp VoiceMouseDecode/PCMServer.cpp
+//      VoiceMouseDecode/DecoderPool.cpp VoiceMouseDecode/LatencyStats.cpp VoiceMouseDecode/Metrics.cpp VoiceMouseDecode/JitterBuffer.cpp
+//      VoiceMouseDecode/AudioHistory.cpp VoiceMouseDecode/base64.cpp build/*.o -lsqlite3
+//
+//  ./loadgen --devices 32 --seconds 10 --clients 2
+//  ./loadgen --devices 8 --max              # no pacing: raw frames/s one core sustains
+//  ./loadgen --devices 16 --frames-per-report 2 --client-rate 48000 --suppress-silence --jitter-buffer 30
+//
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <queue>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "AudioPipeline.h"
+#include "AudioReportLayout.h"
+#include "DecoderPool.h"
+#include "JitterBuffer.h"
+#include "PCMServer.h"
+
+#define FRAME_INTERVAL_NS   7500000ull  // one mSBC frame (120 samples @ 16 kHz)
+#define MSBC_FRAME_LEN      57
+#define SIGNAL_FRAMES       400         // 3 s of audio per device, looped
+
+struct Options {
+    int devices = 8;
+    int threads = 1;
+    double seconds = 10.0;
+    double jitterMs = 2.0;      // extra delivery delay, uniform 0..jitterMs
+    double loss = 0.01;         // probability a report never arrives
+    int clients = 1;
+    int port = 3396;
+    bool maxSpeed = false;
+    int framesPerReport = 1;    // H2 frames packed into one report, 59 bytes apart
+    int clientRate = 0;         // SET_SAMPLE_RATE the clients send, 0 for the default 16 kHz
+    bool suppressSilence = false;
+    int jitterBufferMs = 0;     // 0: off
+};
+
+// H2 synchronization header of HFP mSBC: 0x01 then one of four sequence codes
+static const uint8_t h2Sequence[4] = {0x08, 0x38, 0xC8, 0xF8};
+
+static uint64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t threadCpuNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// ====== 类语音测试信号 ======
+// Voiced syllables (~4/s) over a wandering 90-220 Hz pitch, harmonics shaped
+// by two moving formants, short pauses between words and a faint noise floor.
+static std::vector<int16_t> makeSpeechLikeSignal(uint32_t seed, size_t samples) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    std::normal_distribution<double> noise(0.0, 1.0);
+
+    std::vector<int16_t> out(samples);
+    double basePitch = 90.0 + 130.0 * uni(rng);
+    double phase = 0.0;
+    double syllableRate = 3.0 + 2.0 * uni(rng);
+    double f1 = 500, f2 = 1500;
+
+    for (size_t n = 0; n < samples; ++n) {
+        double t = (double)n / SAMPLE_RATE;
+        double syllable = t * syllableRate;
+        if (n % 800 == 0) {
+            // new formant targets every 50 ms
+            f1 = 300 + 600 * uni(rng);
+            f2 = 900 + 1500 * uni(rng);
+        }
+        double envelope = std::pow(std::sin(M_PI * (syllable - std::floor(syllable))), 2.0);
+        if ((int)syllable % 5 == 4) envelope = 0.0;   // pause between words
+
+        double f0 = basePitch * (1.0 + 0.1 * std::sin(2 * M_PI * 0.7 * t));
+        phase += 2 * M_PI * f0 / SAMPLE_RATE;
+
+        double voiced = 0.0;
+        for (int k = 1; f0 * k < 3800; ++k) {
+            double f = f0 * k;
+            double gain = 1.0 / (1.0 + std::pow((f - f1) / 150.0, 2)) + 0.5 / (1.0 + std::pow((f - f2) / 250.0, 2));
+            voiced += gain * std::sin(k * phase) / k;
+        }
+        double sample = 6000.0 * envelope * voiced + 30.0 * noise(rng);
+        out[n] = (int16_t)std::max(-32768.0, std::min(32767.0, sample));
+    }
+    return out;
+}
+
+// Encodes the signal into HID reports exactly as the mouse sends them: each
+// frame is the H2 header, the 57-byte mSBC frame and one byte of padding,
+// framesPerReport of them per report
+static std::vector<std::vector<uint8_t>> encodeReports(const std::vector<int16_t>& pcm, int framesPerReport) {
+    sbc_t enc;
+    sbc_init_msbc(&enc, 0);
+    enc.endian = SBC_LE;
+
+    std::vector<std::vector<uint8_t>> reports;
+    size_t reportLen = framesPerReport * MSBC_H2_FRAME_LEN + 1;
+    size_t frameSamples = MSBC_FRAME_SAMPLES * framesPerReport;
+    for (size_t off = 0; off + frameSamples <= pcm.size(); off += frameSamples) {
+        std::vector<uint8_t> report(reportLen, 0);
+        for (int k = 0; k < framesPerReport; ++k) {
+            uint8_t* frame = report.data() + k * MSBC_H2_FRAME_LEN;
+            size_t seq = reports.size() * framesPerReport + k;
+            frame[0] = 0x01;
+            frame[1] = h2Sequence[seq % 4];
+            ssize_t written = 0;
+            sbc_encode(&enc, &pcm[off + k * MSBC_FRAME_SAMPLES], MSBC_FRAME_SAMPLES * sizeof(int16_t),
+                       frame + 2, MSBC_FRAME_LEN, &written);
+            if (written != MSBC_FRAME_LEN) {
+                std::cerr << "❌ sbc_encode produced " << written << " bytes" << std::endl;
+                sbc_finish(&enc);
+                return reports;
+            }
+        }
+        reports.push_back(std::move(report));
+    }
+    sbc_finish(&enc);
+    return reports;
+}
+
+// ====== 模拟设备 ======
+struct SimDevice {
+    int index;
+    const std::vector<std::vector<uint8_t>>* reports;
+    uint64_t seq = 0;           // reports generated so far, delivered or lost
+    uint64_t lastDue = 0;
+    std::mt19937 rng;
+};
+
+struct WorkerStats {
+    uint64_t frames = 0;
+    uint64_t lost = 0;          // frames of the reports that never arrived
+    uint64_t cpuNs = 0;
+    std::vector<uint32_t> latencyNs;    // due time -> sent, per frame
+    std::vector<uint32_t> serviceNs;    // whole pipeline, per report
+};
+
+static std::unique_ptr<PCMServer> pcmServer;
+static DecoderPool decoderPool;
+static std::unique_ptr<AudioPipeline> audioPipeline;
+static AudioReportLayout reportLayout;
+
+// One report through the service's audio path, as HandleInput hands it over.
+// nowNs is when the mouse sent it, which the H2 sequence tracking uses to
+// tell duplicates from three lost frames; arrivalNs starts its latency.
+static size_t processReport(SimDevice& dev, const std::vector<uint8_t>& report, uint64_t nowNs, uint64_t arrivalNs) {
+    DeviceDecoder& decoder = decoderPool.acquire(&dev);
+    const uint8_t* frames[AUDIO_REPORT_MAX_FRAMES];
+    size_t count = locateAudioFrames(reportLayout, report.data(), report.size(), frames, AUDIO_REPORT_MAX_FRAMES);
+    audioPipeline->handleFrames(decoder, nullptr, frames, count, report.data() + report.size(), nowNs, arrivalNs);
+    return count;
+}
+
+static void runWorker(std::vector<SimDevice>& devices, const Options& opt, uint64_t start, uint64_t end, WorkerStats& stats) {
+    using Event = std::pair<uint64_t, int>;     // due time, device
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> due;
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+
+    // A report leaves the mouse once its last frame is captured
+    auto sentNs = [&](uint64_t report) {
+        return start + (report * opt.framesPerReport + opt.framesPerReport - 1) * FRAME_INTERVAL_NS;
+    };
+    auto schedule = [&](SimDevice& dev) {
+        // frames are captured every 7.5 ms; the link adds 0..jitter of delay
+        // but never reorders a device's reports
+        for (;;) {
+            uint64_t t = sentNs(dev.seq) + (uint64_t)(uni(dev.rng) * opt.jitterMs * 1e6);
+            t = std::max(t, dev.lastDue);
+            dev.seq++;
+            if (uni(dev.rng) < opt.loss) {
+                stats.lost += opt.framesPerReport;
+                continue;
+            }
+            dev.lastDue = t;
+            due.push({t, dev.index});
+            return;
+        }
+    };
+    for (auto& dev : devices) {
+        schedule(dev);
+    }
+
+    uint64_t cpuStart = threadCpuNs();
+    uint64_t maxReports = (uint64_t)(opt.seconds * 1e9 / FRAME_INTERVAL_NS) / opt.framesPerReport;
+    while (!due.empty()) {
+        auto [t, idx] = due.top();
+        due.pop();
+        SimDevice& dev = devices[idx - devices.front().index];
+        if (opt.maxSpeed ? dev.seq > maxReports : t >= end)
+            continue;
+
+        if (!opt.maxSpeed) {
+            uint64_t now = monotonicNs();
+            if (t > now) {
+                struct timespec ts = {(time_t)(t / 1000000000ull), (long)(t % 1000000000ull)};
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+            }
+        }
+
+        uint64_t begin = monotonicNs();
+        const auto& report = (*dev.reports)[(dev.seq - 1) % dev.reports->size()];
+        stats.frames += processReport(dev, report, sentNs(dev.seq - 1), opt.maxSpeed ? begin : t);
+        uint64_t finished = monotonicNs();
+
+        stats.serviceNs.push_back((uint32_t)std::min<uint64_t>(finished - begin, UINT32_MAX));
+        if (!opt.maxSpeed)
+            stats.latencyNs.push_back((uint32_t)std::min<uint64_t>(finished - t, UINT32_MAX));
+        schedule(dev);
+    }
+    stats.cpuNs = threadCpuNs() - cpuStart;
+}
+
+// ====== 本地客户端: 接收并丢弃服务端数据 ======
+static std::atomic<bool> draining{true};
+static std::atomic<uint64_t> drainedBytes{0};
+
+static void drainClients(std::vector<int> fds) {
+    std::vector<pollfd> pfds;
+    for (int fd : fds) pfds.push_back({fd, POLLIN, 0});
+    char buf[65536];
+    while (draining) {
+        if (poll(pfds.data(), pfds.size(), 100) <= 0) continue;
+        for (auto& p : pfds) {
+            if (!(p.revents & POLLIN)) continue;
+            ssize_t n = recv(p.fd, buf, sizeof(buf), 0);
+            if (n > 0) drainedBytes += n;
+        }
+    }
+    for (int fd : fds) close(fd);
+}
+
+static int connectClient(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int attempt = 0; attempt < 50; ++attempt) {
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0)
+            return fd;
+        usleep(20000);
+    }
+    close(fd);
+    return -1;
+}
+
+static void sendCommand(int fd, const std::string& command) {
+    send(fd, command.data(), command.size(), 0);
+    usleep(20000);
+}
+
+static double percentileMs(std::vector<uint32_t>& v, double p) {
+    if (v.empty()) return 0.0;
+    size_t k = std::min(v.size() - 1, (size_t)(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k] / 1e6;
+}
+
+static void printUsage(const char* argv0) {
+    std::cout << "Usage: " << argv0 << " [--devices N] [--threads T] [--seconds S] [--jitter MS]\n"
+              << "       [--loss P] [--clients K] [--port P] [--max] [--frames-per-report N]\n"
+              << "       [--client-rate HZ] [--suppress-silence] [--jitter-buffer MS]\n"
+              << "  --frames-per-report  mSBC frames per HID report (default 1)\n"
+              << "  --client-rate        sample rate the clients ask for (SET_SAMPLE_RATE)\n"
+              << "  --suppress-silence   clients turn on VAD silence suppression\n"
+              << "  --jitter-buffer      re-time audio through a jitter buffer starting MS behind\n";
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() { return i + 1 < argc ? std::atof(argv[++i]) : 0.0; };
+        if (arg == "--devices") opt.devices = std::max(1, (int)value());
+        else if (arg == "--threads") opt.threads = std::max(1, (int)value());
+        else if (arg == "--seconds") opt.seconds = value();
+        else if (arg == "--jitter") opt.jitterMs = value();
+        else if (arg == "--loss") opt.loss = value();
+        else if (arg == "--clients") opt.clients = std::max(0, (int)value());
+        else if (arg == "--port") opt.port = (int)value();
+        else if (arg == "--max") opt.maxSpeed = true;
+        else if (arg == "--frames-per-report") opt.framesPerReport = std::min(AUDIO_REPORT_MAX_FRAMES, std::max(1, (int)value()));
+        else if (arg == "--client-rate") opt.clientRate = (int)value();
+        else if (arg == "--suppress-silence") opt.suppressSilence = true;
+        else if (arg == "--jitter-buffer") opt.jitterBufferMs = std::max(0, (int)value());
+        else {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : -1;
+        }
+    }
+    opt.threads = std::min(opt.threads, opt.devices);
+
+    // Distinct voices, shared by devices round-robin; encoding happens up front
+    // so it isn't part of the measurement
+    const int voices = std::min(opt.devices, 8);
+    std::vector<std::vector<std::vector<uint8_t>>> voiceReports;
+    for (int v = 0; v < voices; ++v) {
+        voiceReports.push_back(encodeReports(makeSpeechLikeSignal(1234 + v, SIGNAL_FRAMES * MSBC_FRAME_SAMPLES),
+                                             opt.framesPerReport));
+    }
+    std::cout << "Encoded " << voices << " voices x " << voiceReports[0].size() << " reports of "
+              << opt.framesPerReport << " mSBC frame(s)" << std::endl;
+    reportLayout.frameCount = opt.framesPerReport;
+
+    pcmServer = std::make_unique<PCMServer>(opt.port);
+    if (!pcmServer->start()) {
+        std::cerr << "Failed to start PCM TCP server.\n";
+        return -1;
+    }
+    audioPipeline = std::make_unique<AudioPipeline>(*pcmServer, decoderPool);
+    std::unique_ptr<JitterPlayout> jitterPlayout;
+    if (opt.jitterBufferMs > 0) {
+        JitterOptions jitterOptions;
+        jitterOptions.targetDelayMs = opt.jitterBufferMs;
+        jitterOptions.maxDelayMs = std::max(jitterOptions.maxDelayMs, opt.jitterBufferMs);
+        jitterPlayout = std::make_unique<JitterPlayout>(jitterOptions, [](const JitterBuffer::Frame& frame) {
+            audioPipeline->playout(frame);
+        });
+        jitterPlayout->start();
+        decoderPool.jitterPlayout = jitterPlayout.get();
+    }
+
+    std::vector<int> clientFds;
+    for (int c = 0; c < opt.clients; ++c) {
+        int fd = connectClient(opt.port);
+        if (fd < 0) continue;
+        clientFds.push_back(fd);
+        // The server reads one command per message
+        if (opt.clientRate > 0)
+            sendCommand(fd, "SET_SAMPLE_RATE " + std::to_string(opt.clientRate));
+        if (opt.suppressSilence)
+            sendCommand(fd, "VAD_SUPPRESS_SILENCE_ON");
+    }
+    std::thread drainer(drainClients, clientFds);
+    usleep(100000);     // let the server register the clients
+
+    // Devices are split evenly across worker threads, each one its own event loop
+    std::vector<std::vector<SimDevice>> groups(opt.threads);
+    for (int d = 0; d < opt.devices; ++d) {
+        SimDevice dev;
+        dev.index = d;
+        dev.reports = &voiceReports[d % voices];
+        dev.rng.seed(d);
+        groups[d * opt.threads / opt.devices].push_back(dev);
+    }
+    for (auto& group : groups) {
+        for (auto& dev : group)
+            decoderPool.setLabel(decoderPool.acquire(&dev), "sim-" + std::to_string(dev.index));
+    }
+
+    std::vector<WorkerStats> stats(opt.threads);
+    std::vector<std::thread> workers;
+    uint64_t start = monotonicNs() + (opt.maxSpeed ? 0 : 10000000ull);
+    uint64_t end = start + (uint64_t)(opt.seconds * 1e9);
+    for (int w = 0; w < opt.threads; ++w) {
+        workers.emplace_back(runWorker, std::ref(groups[w]), std::cref(opt), start, end, std::ref(stats[w]));
+    }
+    for (auto& w : workers) w.join();
+    double wall = (monotonicNs() - start) / 1e9;
+
+    if (jitterPlayout)
+        jitterPlayout->stop();
+    draining = false;
+    drainer.join();
+    pcmServer->stop();
+
+    WorkerStats total;
+    uint64_t errors = 0;
+    for (auto& group : groups) {
+        for (auto& dev : group) {
+            DeviceDecoder& decoder = decoderPool.acquire(&dev);
+            errors += decoder.crcErrors + decoder.decodeErrors;
+        }
+    }
+    for (auto& s : stats) {
+        total.frames += s.frames;
+        total.lost += s.lost;
+        total.cpuNs += s.cpuNs;
+        total.latencyNs.insert(total.latencyNs.end(), s.latencyNs.begin(), s.latencyNs.end());
+        total.serviceNs.insert(total.serviceNs.end(), s.serviceNs.begin(), s.serviceNs.end());
+    }
+
+    // CPU one real-time stream costs: busy time per second of audio decoded.
+    // With --jitter-buffer the sends run on the playout thread, outside it.
+    double audioSeconds = total.frames * (FRAME_INTERVAL_NS / 1e9);
+    double cpuPerStream = audioSeconds > 0 ? total.cpuNs / 1e9 / audioSeconds : 0.0;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "📊 " << opt.devices << " devices, " << opt.threads << " threads, "
+              << clientFds.size() << " clients, " << (opt.maxSpeed ? "max speed" : "paced 7.5 ms") << ", "
+              << wall << " s" << std::endl;
+    std::cout << "📊 Frames: " << total.frames << " received, " << total.lost << " lost, "
+              << errors << " decode errors" << std::endl;
+    std::cout << "📊 Throughput: " << std::setprecision(0) << total.frames / wall << " frames/s, "
+              << std::setprecision(2) << drainedBytes / wall / 1e6 << " MB/s to clients" << std::endl;
+    std::cout << "📊 CPU: " << cpuPerStream * 100 << "% of a core per stream (~"
+              << std::setprecision(0) << (cpuPerStream > 0 ? 1.0 / cpuPerStream : 0) << " streams/core)" << std::endl;
+    std::cout << std::setprecision(3);
+    std::cout << "📊 Service time ms: p50 " << percentileMs(total.serviceNs, 0.5) << ", p99 " << percentileMs(total.serviceNs, 0.99)
+              << ", p99.9 " << percentileMs(total.serviceNs, 0.999) << ", max " << percentileMs(total.serviceNs, 1.0) << std::endl;
+    if (!opt.maxSpeed) {
+        std::cout << "📊 Latency ms (arrival -> sent): p50 " << percentileMs(total.latencyNs, 0.5) << ", p99 " << percentileMs(total.latencyNs, 0.99)
+                  << ", p99.9 " << percentileMs(total.latencyNs, 0.999) << ", max " << percentileMs(total.latencyNs, 1.0) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,873 @@
+//
+//  transcode.cpp
+//  VoiceMouseDecode
+//
+//  Created by Qianqian Zu on 2026/10/19.
+//
+//  Offline bulk transcoder for recorded sessions: raw 16 kHz PCM, raw mSBC
+//  (bare 57-byte frames or H2-framed) and HID captures (--record) in, WAV
+//  out, through the same sbc_decode + denoise_buffer the live path uses.
+//  Inputs are mmapped and fanned out over a work-stealing pool; each worker
+//  streams its output through a fixed buffer and drops input pages behind
+//  it, so memory stays bounded whatever the total size.
+//
+//  Long mSBC files are also split across workers: a quick serial pass finds
+//  the frame boundaries, each segment's decoder is warmed up on the frames
+//  before it (SBC synthesis and denoise only remember a few frames) and
+//  writes its part of the WAV in place, bit-identical to a serial decode.
+//
+//  Build (from the repo root; the codec/DSP sources are C):
+//  for f in VoiceMouseDecode/*.c; do gcc -O2 -msse2 -c $f -o build/$(basename ${f%.c}).o; done
+//  g++ -std=c++17 -O2 -msse2 -pthread -IVoiceMouseDecode -o transcode tools/transcode.cpp build/*.o
+//
+//  ./transcode --out-dir wav/ captures/*.cap
+//  ./transcode --threads 16 --no-denoise --format msbc dumps/*.bin
+//  ./transcode --segment-frames 8000 --verify archive.msbc   # one file on all cores, checked against serial
+//  ./transcode --validate archives/*.msbc                     # integrity scan: header + CRC only, no output
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "sbc.h"
+#include "denoise.h"
+#include "msbc_scan.h"
+#include "HidCapture.h"
+#include "AudioReportLayout.h"
+
+#define MSBC_FRAME_SAMPLES      120
+#define WAV_HEADER_SIZE         44
+#define OUTPUT_BUFFER_BYTES     (256 * 1024)        // per open WAV
+#define INPUT_RELEASE_BYTES     (16 * 1024 * 1024)  // input pages dropped behind the reader every this much
+#define SCAN_MAX_FRAMES         64                  // H2 frames located per msbc_scan_frames call
+#define SEGMENT_FRAMES          65536               // about 8 minutes of mSBC per parallel segment
+#define VALIDATE_MAX_REPORTED   16                  // bad frames listed per file by --validate
+#define WARMUP_FRAMES           8                   // decoded and dropped before each segment
+
+enum InputFormat {
+    INPUT_AUTO,
+    INPUT_PCM,          // s16le, 16 kHz mono
+    INPUT_MSBC,         // mSBC frames back to back, with or without H2 headers
+    INPUT_CAPTURE,      // HidCaptureWriter file
+};
+
+struct Options {
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    std::string outDir = ".";
+    InputFormat format = INPUT_AUTO;
+    bool denoise = true;
+    size_t segmentFrames = SEGMENT_FRAMES;  // 0: never split a file
+    size_t warmupFrames = WARMUP_FRAMES;
+    bool verify = false;                    // decode split files serially too and compare
+    bool validate = false;                  // only check frames (sbc_validate), write nothing
+};
+
+static uint64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void putLe16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void putLe32(uint8_t* p, uint32_t v) { putLe16(p, (uint16_t)v); putLe16(p + 2, (uint16_t)(v >> 16)); }
+static uint16_t le16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t le32(const uint8_t* p) { return le16(p) | (uint32_t)le16(p + 2) << 16; }
+
+// ====== 输入 ======
+// Read-only mapping of a whole input file. release() hands the pages between
+// two offsets back to the kernel; they fault in again from the file if touched.
+// Readers of different parts of the file each track their own start.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+        if (data) munmap((void*)data, size);
+        if (fd >= 0) close(fd);
+    }
+
+    bool open(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) return false;
+        size = (size_t)st.st_size;
+        if (size == 0) return true;
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) return false;
+        data = (const uint8_t*)p;
+        madvise(p, size, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    // Returns the new start; nothing happens until INPUT_RELEASE_BYTES are due
+    size_t release(size_t from, size_t upTo) const {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        from = (from + page - 1) / page * page;
+        upTo = std::min(upTo, size) / page * page;
+        if (upTo < from + INPUT_RELEASE_BYTES) return from;
+        madvise((void*)(data + from), upTo - from, MADV_DONTNEED);
+        return upTo;
+    }
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+private:
+    int fd = -1;
+};
+
+// ====== 输出 ======
+// 16 kHz mono 16-bit WAV. The samples are written by PcmSinks at their own
+// offsets, so the parts of one file can be written by several threads;
+// finish() puts the header in front once the total is known.
+class WavFile {
+public:
+    ~WavFile() { if (fd >= 0) close(fd); }
+
+    bool open(const std::string& path) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        return fd >= 0;
+    }
+
+    bool finish(uint64_t samples) {
+        uint64_t dataBytes = samples * sizeof(int16_t);
+        uint8_t header[WAV_HEADER_SIZE];
+        memcpy(header, "RIFF", 4);
+        putLe32(header + 4, (uint32_t)(36 + dataBytes));
+        memcpy(header + 8, "WAVEfmt ", 8);
+        putLe32(header + 16, 16);
+        putLe16(header + 20, 1);                        // PCM
+        putLe16(header + 22, 1);                        // mono
+        putLe32(header + 24, SAMPLE_RATE);
+        putLe32(header + 28, SAMPLE_RATE * sizeof(int16_t));
+        putLe16(header + 32, sizeof(int16_t));
+        putLe16(header + 34, 16);
+        memcpy(header + 36, "data", 4);
+        putLe32(header + 40, (uint32_t)dataBytes);
+        bool ok = pwrite(fd, header, sizeof(header), 0) == (ssize_t)sizeof(header);
+        ok = ftruncate(fd, WAV_HEADER_SIZE + dataBytes) == 0 && ok;
+        ok = close(fd) == 0 && ok;
+        fd = -1;
+        return ok;
+    }
+
+    int fd = -1;
+};
+
+// Samples from one point of a WavFile on, through a fixed buffer
+class PcmSink {
+public:
+    PcmSink(int fd, uint64_t firstSample) : fd(fd), offset(WAV_HEADER_SIZE + firstSample * sizeof(int16_t)) {
+        buffer.reserve(OUTPUT_BUFFER_BYTES);
+    }
+    ~PcmSink() { flush(); }
+
+    void write(const int16_t* pcm, size_t samples) {
+        const uint8_t* bytes = (const uint8_t*)pcm;
+        size_t length = samples * sizeof(int16_t);
+        while (length > 0) {
+            size_t n = std::min(length, OUTPUT_BUFFER_BYTES - buffer.size());
+            buffer.insert(buffer.end(), bytes, bytes + n);
+            bytes += n;
+            length -= n;
+            if (buffer.size() == OUTPUT_BUFFER_BYTES) flush();
+        }
+        written += samples;
+    }
+
+    // Returns false if any write failed
+    bool flush() {
+        if (!buffer.empty() && pwrite(fd, buffer.data(), buffer.size(), offset) != (ssize_t)buffer.size())
+            failed = true;
+        offset += buffer.size();
+        buffer.clear();
+        return !failed;
+    }
+
+    uint64_t written = 0;       // samples
+
+private:
+    int fd;
+    uint64_t offset;
+    std::vector<uint8_t> buffer;
+    bool failed = false;
+};
+
+// ====== 解码 ======
+// Frames missing before one with H2 sequence byte h2, tracked in *lastSeq.
+// A corrupted sequence byte counts no gap and leaves *lastSeq alone.
+static int h2Gap(int* lastSeq, uint8_t h2) {
+    static const uint8_t h2Sequence[4] = {0x08, 0x38, 0xC8, 0xF8};
+    int seq = (int)(std::find(h2Sequence, h2Sequence + 4, h2) - h2Sequence);
+    if (seq == 4)
+        return 0;
+    int missing = *lastSeq >= 0 ? (seq - *lastSeq - 1) & 0x3 : 0;
+    *lastSeq = seq;
+    return missing;
+}
+
+// One audio stream: mSBC decoder, denoise state and where its PCM goes
+// (nowhere while warming up). Lost frames (H2 sequence gaps) and
+// undecodable ones become silence so the WAV keeps the stream's timing.
+struct StreamDecoder {
+    sbc_t sbc;
+    HighPassFilterState highPass;
+    std::unique_ptr<WavFile> wav;   // owned here unless the file is split into segments
+    std::unique_ptr<PcmSink> sink;
+    bool denoise = true;
+    int lastSeq = -1;
+    uint64_t frames = 0, errors = 0, lost = 0;
+
+    StreamDecoder() {
+        sbc_init_msbc(&sbc, 0);
+        sbc.endian = SBC_LE;
+        denoise_init(&highPass);
+    }
+    ~StreamDecoder() { sbc_finish(&sbc); }
+
+    void pcm(int16_t* samples, size_t count) {
+        if (denoise)
+            denoise_buffer(samples, count, &highPass);
+        if (sink)
+            sink->write(samples, count);
+    }
+
+    void silence(size_t frameCount) {
+        for (size_t i = 0; i < frameCount; ++i) {
+            int16_t zeros[MSBC_FRAME_SAMPLES] = {0};
+            pcm(zeros, MSBC_FRAME_SAMPLES);
+        }
+    }
+
+    // frame is MSBC_FRAME_LEN bytes starting at the syncword
+    void frame(const uint8_t* data) {
+        int16_t out[MSBC_FRAME_SAMPLES];
+        size_t written = 0;
+        ssize_t ret = sbc_decode(&sbc, data, MSBC_FRAME_LEN, out, sizeof(out), &written);
+        if (ret <= 0 || written != sizeof(out)) {
+            errors++;
+            silence(1);
+            return;
+        }
+        frames++;
+        pcm(out, MSBC_FRAME_SAMPLES);
+    }
+
+    // frame starts at its H2 header (0x01, sequence byte)
+    void h2Frame(const uint8_t* data) {
+        int missing = h2Gap(&lastSeq, data[1]);
+        lost += missing;
+        silence(missing);
+        frame(data + 2);
+    }
+
+    // Starts the stream's own WAV
+    bool open(const std::string& path) {
+        wav = std::make_unique<WavFile>();
+        if (!wav->open(path))
+            return false;
+        sink = std::make_unique<PcmSink>(wav->fd, 0);
+        return true;
+    }
+
+    bool close() {
+        bool ok = sink->flush();
+        return wav->finish(sink->written) && ok;
+    }
+};
+
+struct FileResult {
+    bool ok = false;
+    uint64_t inputBytes = 0;
+    uint64_t samples = 0;
+    uint64_t frames = 0, errors = 0, lost = 0;
+    uint64_t skipped = 0;       // --validate: bytes outside frames
+    size_t segments = 1;
+};
+
+static std::string outputPath(const Options& options, const std::string& input, const std::string& suffix) {
+    std::string name = input.substr(input.find_last_of('/') + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) name.resize(dot);
+    return options.outDir + "/" + name + suffix + ".wav";
+}
+
+static InputFormat detectFormat(const MappedFile& in) {
+    if (in.size >= HID_CAPTURE_HEADER_SIZE && memcmp(in.data, HID_CAPTURE_MAGIC, 8) == 0)
+        return INPUT_CAPTURE;
+    if (in.size >= MSBC_FRAME_LEN && (in.data[0] == MSBC_SYNCWORD || in.data[0] == 0x01)) {
+        size_t offset;
+        if (in.data[0] == MSBC_SYNCWORD ? in.data[1] == 0x00 && in.data[2] == 0x00
+                                        : msbc_scan_frames(in.data, std::min<size_t>(in.size, 4 * MSBC_H2_FRAME_LEN), &offset, 1) > 0)
+            return INPUT_MSBC;
+    }
+    return INPUT_PCM;
+}
+
+static void transcodePcm(const MappedFile& in, StreamDecoder& stream) {
+    int16_t block[MSBC_FRAME_SAMPLES];
+    size_t samples = in.size / sizeof(int16_t), released = 0;
+    for (size_t off = 0; off < samples; off += MSBC_FRAME_SAMPLES) {
+        size_t n = std::min<size_t>(MSBC_FRAME_SAMPLES, samples - off);
+        memcpy(block, in.data + off * sizeof(int16_t), n * sizeof(int16_t));   // denoise works in place; the mapping is read-only
+        stream.pcm(block, n);
+        released = in.release(released, off * sizeof(int16_t));
+    }
+}
+
+// Calls visit(offset) for every mSBC frame from offset pos on, in the order a
+// serial decode meets them, until visit returns false. Both walks are greedy
+// left to right, so a walk started at any frame a serial walk met continues
+// exactly like it. H2-framed frames are located with the vectorized scan, a
+// window at a time; bare frames follow each other, resyncing on the next
+// syncword after anything else.
+template <typename Visit>
+static void walkMsbcFrames(const MappedFile& in, size_t pos, Visit visit) {
+    const uint8_t* data = in.data;
+    size_t size = in.size;
+    if (size > 0 && data[0] == 0x01) {
+        size_t offsets[SCAN_MAX_FRAMES];
+        while (pos + MSBC_H2_FRAME_LEN <= size) {
+            size_t window = std::min(size - pos, (size_t)SCAN_MAX_FRAMES * MSBC_H2_FRAME_LEN);
+            size_t n = msbc_scan_frames(data + pos, window, offsets, SCAN_MAX_FRAMES);
+            for (size_t i = 0; i < n; ++i) {
+                if (!visit(pos + offsets[i])) return;
+            }
+            pos += n > 0 ? offsets[n - 1] + MSBC_H2_FRAME_LEN : window - MSBC_H2_FRAME_LEN + 1;
+        }
+        return;
+    }
+    while (pos + MSBC_FRAME_LEN <= size) {
+        if (data[pos] != MSBC_SYNCWORD) {
+            const void* next = memchr(data + pos, MSBC_SYNCWORD, size - pos);
+            if (!next) break;
+            pos = (const uint8_t*)next - data;
+            continue;
+        }
+        if (!visit(pos)) return;
+        pos += MSBC_FRAME_LEN;
+    }
+}
+
+static void decodeMsbcFrame(const MappedFile& in, size_t offset, StreamDecoder& stream) {
+    if (in.data[0] == 0x01)
+        stream.h2Frame(in.data + offset);
+    else
+        stream.frame(in.data + offset);
+}
+
+static void transcodeMsbc(const MappedFile& in, StreamDecoder& stream) {
+    size_t released = 0;
+    walkMsbcFrames(in, 0, [&](size_t offset) {
+        decodeMsbcFrame(in, offset, stream);
+        released = in.release(released, offset);
+        return true;
+    });
+}
+
+// Every device of the capture gets its own stream and WAV (<name>.dev<N>.wav)
+static bool transcodeCapture(const MappedFile& in, const Options& options, const std::string& path,
+                             std::map<uint32_t, std::unique_ptr<StreamDecoder>>& streams) {
+    const uint8_t* data = in.data;
+    size_t pos = HID_CAPTURE_HEADER_SIZE, released = 0;
+    size_t offsets[AUDIO_REPORT_MAX_FRAMES];
+    while (pos + HID_CAPTURE_RECORD_SIZE <= in.size) {
+        const uint8_t* rec = data + pos;
+        uint32_t deviceId = le32(rec + 8);
+        uint8_t type = rec[12];
+        size_t length = le16(rec + 14);
+        if (pos + HID_CAPTURE_RECORD_SIZE + length > in.size) break;       // truncated
+        const uint8_t* payload = rec + HID_CAPTURE_RECORD_SIZE;
+        pos += HID_CAPTURE_RECORD_SIZE + length;
+
+        if (type != HID_CAPTURE_INPUT || length < MSBC_H2_FRAME_LEN) continue;
+        size_t n = msbc_scan_frames(payload, length, offsets, AUDIO_REPORT_MAX_FRAMES);
+        if (n == 0) continue;
+        auto& stream = streams[deviceId];
+        if (!stream) {
+            stream = std::make_unique<StreamDecoder>();
+            stream->denoise = options.denoise;
+            std::string out = outputPath(options, path, ".dev" + std::to_string(deviceId));
+            if (!stream->open(out)) {
+                std::cerr << "❌ Cannot write " << out << std::endl;
+                return false;
+            }
+        }
+        for (size_t i = 0; i < n; ++i) stream->h2Frame(payload + offsets[i]);
+        released = in.release(released, pos);
+    }
+    return true;
+}
+
+// ====== 文件内并行 ======
+// A run of frames decoded by one worker. Its decoder first decodes the
+// warmup frames before it and drops their output: SBC synthesis keeps 10
+// blocks of history (less than one 15-block frame) and the denoise high-pass
+// decays well below one LSB within a few frames, so after the warm-up both
+// hold exactly what a serial decode would.
+struct Segment {
+    size_t start;           // offset of the first frame decoded (warm-up included)
+    size_t warmup;          // frames decoded and dropped first
+    size_t frames;          // frames written
+    uint64_t firstSample;   // where the segment's output starts in the WAV
+};
+
+// The serial pass: walks the frames without decoding them and cuts them
+// into segments, counting the silence H2 gaps will add so each segment
+// knows where its output goes. Returns the total samples in *samples.
+static std::vector<Segment> planSegments(const MappedFile& in, const Options& options, uint64_t* samples) {
+    bool h2 = in.size > 0 && in.data[0] == 0x01;
+    size_t warmup = std::max<size_t>(options.warmupFrames, 1);     // the first one seeds the H2 sequence
+    std::vector<size_t> recent(warmup);                            // offsets of the last warmup frames
+    std::vector<Segment> segments;
+    size_t index = 0, segmentIndex = 0, released = 0;
+    uint64_t outFrames = 0;
+    int lastSeq = -1;
+    walkMsbcFrames(in, 0, [&](size_t offset) {
+        if (index % options.segmentFrames == 0) {
+            if (!segments.empty()) segments.back().frames = index - segmentIndex;
+            size_t back = std::min(index, warmup);
+            segments.push_back({back ? recent[(index - back) % warmup] : offset, back, 0,
+                                outFrames * MSBC_FRAME_SAMPLES});
+            segmentIndex = index;
+        }
+        int missing = h2 ? h2Gap(&lastSeq, in.data[offset + 1]) : 0;
+        outFrames += missing + 1;
+        recent[index % warmup] = offset;
+        index++;
+        released = in.release(released, offset);
+        return true;
+    });
+    if (!segments.empty()) segments.back().frames = index - segmentIndex;
+    *samples = outFrames * MSBC_FRAME_SAMPLES;
+    return segments;
+}
+
+static bool decodeSegment(const MappedFile& in, const Segment& segment, int fd, bool denoise, FileResult* result) {
+    StreamDecoder stream;
+    stream.denoise = denoise;
+    size_t seen = 0, released = segment.start;
+    walkMsbcFrames(in, segment.start, [&](size_t offset) {
+        if (seen == segment.warmup) {
+            stream.sink = std::make_unique<PcmSink>(fd, segment.firstSample);
+            stream.frames = stream.errors = stream.lost = 0;
+        }
+        decodeMsbcFrame(in, offset, stream);
+        released = in.release(released, offset);
+        return ++seen < segment.warmup + segment.frames;
+    });
+    result->frames = stream.frames;
+    result->errors = stream.errors;
+    result->lost = stream.lost;
+    return stream.sink && stream.sink->flush();
+}
+
+// Compares two files a chunk at a time; returns the first differing byte,
+// or -1 if they are the same
+static int64_t firstDifference(const std::string& a, const std::string& b) {
+    FILE* fa = fopen(a.c_str(), "rb");
+    FILE* fb = fopen(b.c_str(), "rb");
+    int64_t diff = fa && fb ? -1 : 0;
+    std::vector<uint8_t> ba(OUTPUT_BUFFER_BYTES), bb(OUTPUT_BUFFER_BYTES);
+    for (int64_t pos = 0; fa && fb && diff < 0;) {
+        size_t na = fread(ba.data(), 1, ba.size(), fa);
+        size_t nb = fread(bb.data(), 1, bb.size(), fb);
+        for (size_t i = 0; i < std::min(na, nb) && diff < 0; ++i) {
+            if (ba[i] != bb[i]) diff = pos + i;
+        }
+        if (diff < 0 && na != nb) diff = pos + std::min(na, nb);
+        if (na == 0) break;
+        pos += na;
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return diff;
+}
+
+// ====== 线程池 ======
+// One deque of jobs per worker: a worker takes from the back of its own and,
+// once that is empty, steals from the front of the others, so a few huge
+// files don't leave the rest of the pool idle. Jobs may push more jobs (the
+// segments of a file they split); workers stop once nothing is queued or
+// running.
+class WorkStealingPool {
+public:
+    using Job = std::function<void(size_t worker)>;
+
+    explicit WorkStealingPool(int workers) : queues(workers) {}
+
+    void push(size_t worker, Job job) {
+        pending++;
+        Queue& queue = queues[worker % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+
+    void run() {
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < queues.size(); ++w) {
+            threads.emplace_back([this, w] {
+                Job job;
+                while (take(w, &job)) {
+                    job(w);
+                    job = nullptr;
+                    pending--;
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+    }
+
+    uint64_t steals() const { return stolen.load(); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    bool take(size_t worker, Job* job) {
+        while (true) {
+            {
+                Queue& own = queues[worker];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.jobs.empty()) {
+                    *job = std::move(own.jobs.back());
+                    own.jobs.pop_back();
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < queues.size(); ++i) {
+                Queue& victim = queues[(worker + i) % queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.jobs.empty()) {
+                    *job = std::move(victim.jobs.front());
+                    victim.jobs.pop_front();
+                    stolen++;
+                    return true;
+                }
+            }
+            if (pending == 0)
+                return false;
+            // a running job may still split its file
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    std::vector<Queue> queues;
+    std::atomic<size_t> pending{0};     // queued or running
+    std::atomic<uint64_t> stolen{0};
+};
+
+// A file whose segments are being decoded; the worker finishing the last
+// one writes the header and the file's result
+struct SplitFile {
+    std::unique_ptr<MappedFile> in;
+    WavFile wav;
+    std::string path, out;
+    std::vector<Segment> segments;
+    uint64_t samples = 0;
+    std::atomic<size_t> remaining{0};
+    std::mutex mutex;
+    FileResult result;
+};
+
+static void finishSplitFile(SplitFile& file, const Options& options, FileResult* result) {
+    file.result.samples = file.samples;
+    file.result.segments = file.segments.size();
+    if (!file.wav.finish(file.samples)) {
+        std::cerr << "❌ Write failed for " << file.path << std::endl;
+        file.result.ok = false;
+    }
+    if (options.verify && file.result.ok) {
+        StreamDecoder serial;
+        serial.denoise = options.denoise;
+        std::string check = file.out + ".serial";
+        if (serial.open(check)) {
+            transcodeMsbc(*file.in, serial);
+            serial.close();
+            int64_t diff = firstDifference(file.out, check);
+            if (diff < 0) {
+                std::cout << "✅ " << file.out << ": " << file.segments.size() << " segments match the serial decode" << std::endl;
+            } else {
+                std::cerr << "❌ " << file.out << ": differs from the serial decode at byte " << diff << std::endl;
+                file.result.ok = false;
+            }
+            unlink(check.c_str());
+        }
+    }
+    *result = file.result;
+}
+
+// Splits a long mSBC file into segment jobs on worker's own queue, where
+// idle workers steal them. Returns false if the file is short enough to
+// decode in one go.
+static bool splitMsbcFile(std::unique_ptr<MappedFile>& in, const std::string& path, const Options& options,
+                          WorkStealingPool& pool, size_t worker, FileResult* result) {
+    if (options.segmentFrames == 0 || in->size / MSBC_H2_FRAME_LEN < 2 * options.segmentFrames)
+        return false;
+    uint64_t samples = 0;
+    std::vector<Segment> segments = planSegments(*in, options, &samples);
+    if (segments.size() < 2)
+        return false;
+
+    auto file = std::make_shared<SplitFile>();
+    file->in = std::move(in);
+    file->path = path;
+    file->out = outputPath(options, path, "");
+    file->segments = std::move(segments);
+    file->samples = samples;
+    file->remaining = file->segments.size();
+    file->result.ok = true;
+    file->result.inputBytes = file->in->size;
+    if (!file->wav.open(file->out)) {
+        std::cerr << "❌ Cannot write " << file->out << std::endl;
+        return true;
+    }
+    for (size_t s = 0; s < file->segments.size(); ++s) {
+        pool.push(worker, [file, s, &options, result](size_t) {
+            FileResult part;
+            bool ok = decodeSegment(*file->in, file->segments[s], file->wav.fd, options.denoise, &part);
+            {
+                std::lock_guard<std::mutex> lock(file->mutex);
+                file->result.ok = file->result.ok && ok;
+                file->result.frames += part.frames;
+                file->result.errors += part.errors;
+                file->result.lost += part.lost;
+            }
+            if (--file->remaining == 0)
+                finishSplitFile(*file, options, result);
+        });
+    }
+    return true;
+}
+
+// --validate: every frame of a raw mSBC or SBC stream through sbc_validate's
+// header/scale factor/CRC check; nothing is decoded or written
+static void validateFile(const MappedFile& in, const std::string& path, FileResult* result) {
+    sbc_t sbc;
+    bool a2dp = in.size > 0 && in.data[0] == 0x9C;
+    if ((a2dp ? sbc_init(&sbc, 0) : sbc_init_msbc(&sbc, 0)) != 0)
+        return;
+    sbc_frame_error errors[VALIDATE_MAX_REPORTED];
+    sbc_validate_result counts;
+    ssize_t reported = sbc_validate(&sbc, in.data, in.size, errors, VALIDATE_MAX_REPORTED, &counts);
+    sbc_finish(&sbc);
+    if (reported < 0)
+        return;
+
+    result->frames = counts.frames;
+    result->errors = counts.bad_frames;
+    result->skipped = counts.skipped;
+    if (!a2dp)
+        result->samples = counts.frames * MSBC_FRAME_SAMPLES;
+    result->ok = counts.bad_frames == 0;
+
+    // one write per file so reports of parallel workers don't interleave
+    std::ostringstream report;
+    report << (result->ok ? "✅ " : "❌ ") << path << ": " << counts.frames << " good, " << counts.bad_frames
+           << " bad " << (a2dp ? "SBC" : "mSBC") << " frame(s), " << counts.skipped << " byte(s) between frames\n";
+    static const char* reasons[] = {"", "truncated", "bad sync", "CRC mismatch", "bitpool out of range"};
+    for (ssize_t i = 0; i < reported; ++i) {
+        int code = -errors[i].error;
+        report << "   @" << errors[i].offset << ": " << (code >= 1 && code <= 4 ? reasons[code] : "error")
+               << " (" << errors[i].error << ")\n";
+    }
+    if (counts.bad_frames > (size_t)reported)
+        report << "   ... and " << counts.bad_frames - reported << " more\n";
+    std::cout << report.str() << std::flush;
+}
+
+static void transcodeFile(const std::string& path, const Options& options, WorkStealingPool& pool, size_t worker,
+                          FileResult* result) {
+    auto in = std::make_unique<MappedFile>();
+    if (!in->open(path)) {
+        std::cerr << "❌ Cannot read " << path << std::endl;
+        return;
+    }
+    result->inputBytes = in->size;
+
+    InputFormat format = options.format == INPUT_AUTO ? detectFormat(*in) : options.format;
+    if (options.validate) {
+        if (format == INPUT_CAPTURE)
+            std::cerr << "⚠️ --validate takes raw mSBC/SBC streams, skipping capture " << path << std::endl;
+        else
+            validateFile(*in, path, result);
+        return;
+    }
+    if (format == INPUT_MSBC && splitMsbcFile(in, path, options, pool, worker, result))
+        return;
+
+    std::map<uint32_t, std::unique_ptr<StreamDecoder>> streams;
+    bool ok = true;
+    if (format == INPUT_CAPTURE) {
+        if (in->size < HID_CAPTURE_HEADER_SIZE || memcmp(in->data, HID_CAPTURE_MAGIC, 8) != 0) {
+            std::cerr << "❌ Not a HID capture: " << path << std::endl;
+            return;
+        }
+        ok = transcodeCapture(*in, options, path, streams);
+    } else {
+        auto& stream = streams[0];
+        stream = std::make_unique<StreamDecoder>();
+        stream->denoise = options.denoise;
+        std::string out = outputPath(options, path, "");
+        if (!stream->open(out)) {
+            std::cerr << "❌ Cannot write " << out << std::endl;
+            return;
+        }
+        if (format == INPUT_PCM)
+            transcodePcm(*in, *stream);
+        else
+            transcodeMsbc(*in, *stream);
+    }
+
+    for (auto& entry : streams) {
+        StreamDecoder& stream = *entry.second;
+        result->samples += stream.sink->written;
+        result->frames += stream.frames;
+        result->errors += stream.errors;
+        result->lost += stream.lost;
+        if (!stream.close()) {
+            std::cerr << "❌ Write failed for " << path << std::endl;
+            ok = false;
+        }
+    }
+    result->ok = ok;
+}
+
+static void printUsage(const char* argv0) {
+    std::cout << "Usage: " << argv0 << " [--threads N] [--out-dir DIR] [--format auto|pcm|msbc|cap] [--no-denoise]\n"
+              << "       [--segment-frames N] [--warmup K] [--verify] [--validate] input...\n"
+              << "  --threads         worker threads (default: one per core)\n"
+              << "  --out-dir         where the WAV files go (default .); <name>.wav, <name>.dev<N>.wav for captures\n"
+              << "  --format          input format, detected per file by default\n"
+              << "  --no-denoise      write the decoded audio as is\n"
+              << "  --segment-frames  split mSBC files into segments of N frames decoded in parallel\n"
+              << "                    (default " << SEGMENT_FRAMES << ", 0 = one worker per file)\n"
+              << "  --warmup          frames each segment decodes and drops first (default " << WARMUP_FRAMES << ")\n"
+              << "  --verify          decode split files serially as well and check they are identical\n"
+              << "  --validate        only check every frame's header, scale factors and CRC; list bad frames\n";
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            options.threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--out-dir" && i + 1 < argc) {
+            options.outDir = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format == "auto") options.format = INPUT_AUTO;
+            else if (format == "pcm") options.format = INPUT_PCM;
+            else if (format == "msbc") options.format = INPUT_MSBC;
+            else if (format == "cap") options.format = INPUT_CAPTURE;
+            else {
+                printUsage(argv[0]);
+                return -1;
+            }
+        } else if (arg == "--no-denoise") {
+            options.denoise = false;
+        } else if (arg == "--segment-frames" && i + 1 < argc) {
+            options.segmentFrames = (size_t)std::max(0L, std::atol(argv[++i]));
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            options.warmupFrames = (size_t)std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--validate") {
+            options.validate = true;
+        } else if (arg == "--verify") {
+            options.verify = true;
+        } else if (!arg.empty() && arg[0] != '-') {
+            inputs.push_back(arg);
+        } else {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : -1;
+        }
+    }
+    if (inputs.empty()) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    // Largest files first, dealt round-robin, so the long jobs start early
+    std::vector<std::pair<uint64_t, size_t>> bySize;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        struct stat st;
+        bySize.push_back({stat(inputs[i].c_str(), &st) == 0 ? (uint64_t)st.st_size : 0, i});
+    }
+    std::sort(bySize.begin(), bySize.end(), std::greater<std::pair<uint64_t, size_t>>());
+    std::vector<FileResult> results(inputs.size());
+    WorkStealingPool pool(options.threads);
+    for (size_t i = 0; i < bySize.size(); ++i) {
+        size_t job = bySize[i].second;
+        pool.push(i % options.threads, [&, job](size_t worker) {
+            transcodeFile(inputs[job], options, pool, worker, &results[job]);
+        });
+    }
+
+    if (options.validate)
+        std::cout << "🔍 Validating " << inputs.size() << " file(s) on " << options.threads << " thread(s)" << std::endl;
+    else
+        std::cout << "🎛️ Transcoding " << inputs.size() << " file(s) on " << options.threads << " thread(s) (sbc "
+                  << "decode, denoise " << (options.denoise ? denoise_get_implementation_info() : "off") << ")" << std::endl;
+
+    uint64_t start = monotonicNs();
+    pool.run();
+    double seconds = (monotonicNs() - start) / 1e9;
+
+    FileResult total;
+    size_t failed = 0, segments = 0;
+    for (auto& r : results) {
+        total.inputBytes += r.inputBytes;
+        total.samples += r.samples;
+        total.frames += r.frames;
+        total.errors += r.errors;
+        total.lost += r.lost;
+        total.skipped += r.skipped;
+        if (r.segments > 1) segments += r.segments;
+        if (!r.ok) failed++;
+    }
+    double audioSeconds = (double)total.samples / SAMPLE_RATE;
+    if (options.validate) {
+        std::cout << std::fixed << std::setprecision(2)
+                  << "📊 " << inputs.size() - failed << "/" << inputs.size() << " file(s) clean, "
+                  << total.inputBytes / 1e6 << " MB in " << seconds << " s ("
+                  << total.inputBytes / 1e6 / std::max(seconds, 1e-9) << " MB/s, "
+                  << total.frames / std::max(seconds, 1e-9) << " frames/s)\n"
+                  << "📊 Frames: " << total.frames << " good, " << total.errors << " bad; "
+                  << total.skipped << " byte(s) between frames" << std::endl;
+        return failed ? 1 : 0;
+    }
+    std::cout << std::fixed << std::setprecision(2)
+              << "📊 " << inputs.size() - failed << "/" << inputs.size() << " file(s), "
+              << total.inputBytes / 1e6 << " MB in, " << audioSeconds << " s of audio in " << seconds << " s\n"
+              << "📊 Throughput: " << total.inputBytes / 1e6 / std::max(seconds, 1e-9) << " MB/s, "
+              << total.frames / std::max(seconds, 1e-9) << " frames/s, "
+              << audioSeconds / std::max(seconds, 1e-9) << "x real time\n"
+              << "📊 Frames: " << total.frames << " decoded, " << total.errors << " undecodable, "
+              << total.lost << " lost (written as silence); " << segments << " parallel segment(s), "
+              << pool.steals() << " job(s) stolen" << std::endl;
+    return failed ? 1 : 0;
+}